@@ -22,6 +22,7 @@ ME_COM_OSDEP          ?= 1
 ME_COM_SSL            ?= 1
 ME_COM_VXWORKS        ?= 0
 ME_COM_WINSDK         ?= 1
+ME_COM_ZLIB           ?= 0
 
 ME_COM_OPENSSL_PATH   ?= "/usr"
 
@@ -36,11 +37,14 @@ ifeq ($(ME_COM_OPENSSL),1)
 endif
 
 CFLAGS                += -fPIC -w
-DFLAGS                += -D_REENTRANT -DPIC $(patsubst %,-D%,$(filter ME_%,$(MAKEFLAGS))) -DME_COM_COMPILER=$(ME_COM_COMPILER) -DME_COM_EST=$(ME_COM_EST) -DME_COM_LIB=$(ME_COM_LIB) -DME_COM_OPENSSL=$(ME_COM_OPENSSL) -DME_COM_OSDEP=$(ME_COM_OSDEP) -DME_COM_SSL=$(ME_COM_SSL) -DME_COM_VXWORKS=$(ME_COM_VXWORKS) -DME_COM_WINSDK=$(ME_COM_WINSDK) 
+DFLAGS                += -D_REENTRANT -DPIC $(patsubst %,-D%,$(filter ME_%,$(MAKEFLAGS))) -DME_COM_COMPILER=$(ME_COM_COMPILER) -DME_COM_EST=$(ME_COM_EST) -DME_COM_LIB=$(ME_COM_LIB) -DME_COM_OPENSSL=$(ME_COM_OPENSSL) -DME_COM_OSDEP=$(ME_COM_OSDEP) -DME_COM_SSL=$(ME_COM_SSL) -DME_COM_VXWORKS=$(ME_COM_VXWORKS) -DME_COM_WINSDK=$(ME_COM_WINSDK) -DME_COM_ZLIB=$(ME_COM_ZLIB) 
 IFLAGS                += "-I$(BUILD)/inc"
 LDFLAGS               += 
 LIBPATHS              += -L$(BUILD)/bin
 LIBS                  += -ldl -lpthread -lm
+ifeq ($(ME_COM_ZLIB),1)
+    LIBS              += -lz
+endif
 
 DEBUG                 ?= debug
 CFLAGS-debug          ?= -g
@@ -73,6 +77,7 @@ ME_SRC_PREFIX         ?= $(ME_ROOT_PREFIX)$(NAME)-$(VERSION)
 
 
 TARGETS               += $(BUILD)/bin/ca.crt
+TARGETS               += test/fcgi-bin/fcgitest
 TARGETS               += $(BUILD)/bin/goahead
 TARGETS               += $(BUILD)/bin/goahead-test
 TARGETS               += $(BUILD)/bin/gopass
@@ -113,6 +118,7 @@ clean:
 	rm -f "$(BUILD)/obj/cgitest.o"
 	rm -f "$(BUILD)/obj/crypt.o"
 	rm -f "$(BUILD)/obj/est.o"
+	rm -f "$(BUILD)/obj/fcgitest.o"
 	rm -f "$(BUILD)/obj/file.o"
 	rm -f "$(BUILD)/obj/fs.o"
 	rm -f "$(BUILD)/obj/goahead.o"
@@ -132,6 +138,7 @@ clean:
 	rm -f "$(BUILD)/obj/test.o"
 	rm -f "$(BUILD)/obj/upload.o"
 	rm -f "$(BUILD)/bin/ca.crt"
+	rm -f "test/fcgi-bin/fcgitest"
 	rm -f "$(BUILD)/bin/goahead"
 	rm -f "$(BUILD)/bin/goahead-test"
 	rm -f "$(BUILD)/bin/gopass"
@@ -256,339 +263,358 @@ $(BUILD)/obj/est.o: \
 	@echo '   [Compile] $(BUILD)/obj/est.o'
 	$(CC) -c -o $(BUILD)/obj/est.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/ssl/est.c
 
+#
+#   fcgitest.o
+#
+
+$(BUILD)/obj/fcgitest.o: \
+    test/fcgitest.c $(DEPS_13)
+	@echo '   [Compile] $(BUILD)/obj/fcgitest.o'
+	$(CC) -c -o $(BUILD)/obj/fcgitest.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) $(IFLAGS) test/fcgitest.c
+
 #
 #   file.o
 #
-DEPS_13 += $(BUILD)/inc/goahead.h
+DEPS_14 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/file.o: \
-    src/file.c $(DEPS_13)
+    src/file.c $(DEPS_14)
 	@echo '   [Compile] $(BUILD)/obj/file.o'
 	$(CC) -c -o $(BUILD)/obj/file.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/file.c
 
 #
 #   fs.o
 #
-DEPS_14 += $(BUILD)/inc/goahead.h
+DEPS_15 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/fs.o: \
-    src/fs.c $(DEPS_14)
+    src/fs.c $(DEPS_15)
 	@echo '   [Compile] $(BUILD)/obj/fs.o'
 	$(CC) -c -o $(BUILD)/obj/fs.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/fs.c
 
 #
 #   goahead.o
 #
-DEPS_15 += $(BUILD)/inc/goahead.h
+DEPS_16 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/goahead.o: \
-    src/goahead.c $(DEPS_15)
+    src/goahead.c $(DEPS_16)
 	@echo '   [Compile] $(BUILD)/obj/goahead.o'
 	$(CC) -c -o $(BUILD)/obj/goahead.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/goahead.c
 
 #
 #   gopass.o
 #
-DEPS_16 += $(BUILD)/inc/goahead.h
+DEPS_17 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/gopass.o: \
-    src/utils/gopass.c $(DEPS_16)
+    src/utils/gopass.c $(DEPS_17)
 	@echo '   [Compile] $(BUILD)/obj/gopass.o'
 	$(CC) -c -o $(BUILD)/obj/gopass.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/utils/gopass.c
 
 #
 #   http.o
 #
-DEPS_17 += $(BUILD)/inc/goahead.h
+DEPS_18 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/http.o: \
-    src/http.c $(DEPS_17)
+    src/http.c $(DEPS_18)
 	@echo '   [Compile] $(BUILD)/obj/http.o'
 	$(CC) -c -o $(BUILD)/obj/http.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/http.c
 
 #
 #   js.o
 #
-DEPS_18 += $(BUILD)/inc/js.h
+DEPS_19 += $(BUILD)/inc/js.h
 
 $(BUILD)/obj/js.o: \
-    src/js.c $(DEPS_18)
+    src/js.c $(DEPS_19)
 	@echo '   [Compile] $(BUILD)/obj/js.o'
 	$(CC) -c -o $(BUILD)/obj/js.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/js.c
 
 #
 #   jst.o
 #
-DEPS_19 += $(BUILD)/inc/goahead.h
-DEPS_19 += $(BUILD)/inc/js.h
+DEPS_20 += $(BUILD)/inc/goahead.h
+DEPS_20 += $(BUILD)/inc/js.h
 
 $(BUILD)/obj/jst.o: \
-    src/jst.c $(DEPS_19)
+    src/jst.c $(DEPS_20)
 	@echo '   [Compile] $(BUILD)/obj/jst.o'
 	$(CC) -c -o $(BUILD)/obj/jst.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/jst.c
 
 #
 #   matrixssl.o
 #
-DEPS_20 += $(BUILD)/inc/me.h
-DEPS_20 += $(BUILD)/inc/goahead.h
+DEPS_21 += $(BUILD)/inc/me.h
+DEPS_21 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/matrixssl.o: \
-    src/ssl/matrixssl.c $(DEPS_20)
+    src/ssl/matrixssl.c $(DEPS_21)
 	@echo '   [Compile] $(BUILD)/obj/matrixssl.o'
 	$(CC) -c -o $(BUILD)/obj/matrixssl.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/ssl/matrixssl.c
 
 #
 #   nanossl.o
 #
-DEPS_21 += $(BUILD)/inc/me.h
+DEPS_22 += $(BUILD)/inc/me.h
 
 $(BUILD)/obj/nanossl.o: \
-    src/ssl/nanossl.c $(DEPS_21)
+    src/ssl/nanossl.c $(DEPS_22)
 	@echo '   [Compile] $(BUILD)/obj/nanossl.o'
 	$(CC) -c -o $(BUILD)/obj/nanossl.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/ssl/nanossl.c
 
 #
 #   openssl.o
 #
-DEPS_22 += $(BUILD)/inc/me.h
-DEPS_22 += $(BUILD)/inc/osdep.h
-DEPS_22 += $(BUILD)/inc/goahead.h
+DEPS_23 += $(BUILD)/inc/me.h
+DEPS_23 += $(BUILD)/inc/osdep.h
+DEPS_23 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/openssl.o: \
-    src/ssl/openssl.c $(DEPS_22)
+    src/ssl/openssl.c $(DEPS_23)
 	@echo '   [Compile] $(BUILD)/obj/openssl.o'
 	$(CC) -c -o $(BUILD)/obj/openssl.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/ssl/openssl.c
 
 #
 #   options.o
 #
-DEPS_23 += $(BUILD)/inc/goahead.h
+DEPS_24 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/options.o: \
-    src/options.c $(DEPS_23)
+    src/options.c $(DEPS_24)
 	@echo '   [Compile] $(BUILD)/obj/options.o'
 	$(CC) -c -o $(BUILD)/obj/options.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/options.c
 
 #
 #   osdep.o
 #
-DEPS_24 += $(BUILD)/inc/goahead.h
+DEPS_25 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/osdep.o: \
-    src/osdep.c $(DEPS_24)
+    src/osdep.c $(DEPS_25)
 	@echo '   [Compile] $(BUILD)/obj/osdep.o'
 	$(CC) -c -o $(BUILD)/obj/osdep.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/osdep.c
 
 #
 #   rom-documents.o
 #
-DEPS_25 += $(BUILD)/inc/goahead.h
+DEPS_26 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/rom-documents.o: \
-    src/rom-documents.c $(DEPS_25)
+    src/rom-documents.c $(DEPS_26)
 	@echo '   [Compile] $(BUILD)/obj/rom-documents.o'
 	$(CC) -c -o $(BUILD)/obj/rom-documents.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/rom-documents.c
 
 #
 #   route.o
 #
-DEPS_26 += $(BUILD)/inc/goahead.h
+DEPS_27 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/route.o: \
-    src/route.c $(DEPS_26)
+    src/route.c $(DEPS_27)
 	@echo '   [Compile] $(BUILD)/obj/route.o'
 	$(CC) -c -o $(BUILD)/obj/route.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/route.c
 
 #
 #   runtime.o
 #
-DEPS_27 += $(BUILD)/inc/goahead.h
+DEPS_28 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/runtime.o: \
-    src/runtime.c $(DEPS_27)
+    src/runtime.c $(DEPS_28)
 	@echo '   [Compile] $(BUILD)/obj/runtime.o'
 	$(CC) -c -o $(BUILD)/obj/runtime.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/runtime.c
 
 #
 #   socket.o
 #
-DEPS_28 += $(BUILD)/inc/goahead.h
+DEPS_29 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/socket.o: \
-    src/socket.c $(DEPS_28)
+    src/socket.c $(DEPS_29)
 	@echo '   [Compile] $(BUILD)/obj/socket.o'
 	$(CC) -c -o $(BUILD)/obj/socket.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/socket.c
 
 #
 #   test.o
 #
-DEPS_29 += $(BUILD)/inc/goahead.h
-DEPS_29 += $(BUILD)/inc/js.h
+DEPS_30 += $(BUILD)/inc/goahead.h
+DEPS_30 += $(BUILD)/inc/js.h
 
 $(BUILD)/obj/test.o: \
-    test/test.c $(DEPS_29)
+    test/test.c $(DEPS_30)
 	@echo '   [Compile] $(BUILD)/obj/test.o'
 	$(CC) -c -o $(BUILD)/obj/test.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" test/test.c
 
 #
 #   upload.o
 #
-DEPS_30 += $(BUILD)/inc/goahead.h
+DEPS_31 += $(BUILD)/inc/goahead.h
 
 $(BUILD)/obj/upload.o: \
-    src/upload.c $(DEPS_30)
+    src/upload.c $(DEPS_31)
 	@echo '   [Compile] $(BUILD)/obj/upload.o'
 	$(CC) -c -o $(BUILD)/obj/upload.o $(LDFLAGS) $(CFLAGS) $(DFLAGS) -DME_COM_OPENSSL_PATH="$(ME_COM_OPENSSL_PATH)" $(IFLAGS) "-I$(ME_COM_OPENSSL_PATH)/include" src/upload.c
 
 #
 #   ca-crt
 #
-DEPS_31 += src/est/ca.crt
+DEPS_32 += src/est/ca.crt
 
-$(BUILD)/bin/ca.crt: $(DEPS_31)
+$(BUILD)/bin/ca.crt: $(DEPS_32)
 	@echo '      [Copy] $(BUILD)/bin/ca.crt'
 	mkdir -p "$(BUILD)/bin"
 	cp src/est/ca.crt $(BUILD)/bin/ca.crt
 
+#
+#   fcgitest
+#
+DEPS_33 += $(BUILD)/obj/fcgitest.o
+
+test/fcgi-bin/fcgitest: $(DEPS_33)
+	@echo '      [Link] test/fcgi-bin/fcgitest'
+	mkdir -p "test/fcgi-bin"
+	$(CC) -o test/fcgi-bin/fcgitest $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/fcgitest.o" $(LIBS) $(LIBS) 
+
 #
 #   libgo
 #
-DEPS_32 += $(BUILD)/inc/osdep.h
-DEPS_32 += $(BUILD)/inc/goahead.h
-DEPS_32 += $(BUILD)/inc/js.h
-DEPS_32 += $(BUILD)/obj/action.o
-DEPS_32 += $(BUILD)/obj/alloc.o
-DEPS_32 += $(BUILD)/obj/auth.o
-DEPS_32 += $(BUILD)/obj/cgi.o
-DEPS_32 += $(BUILD)/obj/crypt.o
-DEPS_32 += $(BUILD)/obj/file.o
-DEPS_32 += $(BUILD)/obj/fs.o
-DEPS_32 += $(BUILD)/obj/http.o
-DEPS_32 += $(BUILD)/obj/js.o
-DEPS_32 += $(BUILD)/obj/jst.o
-DEPS_32 += $(BUILD)/obj/options.o
-DEPS_32 += $(BUILD)/obj/osdep.o
-DEPS_32 += $(BUILD)/obj/rom-documents.o
-DEPS_32 += $(BUILD)/obj/route.o
-DEPS_32 += $(BUILD)/obj/runtime.o
-DEPS_32 += $(BUILD)/obj/socket.o
-DEPS_32 += $(BUILD)/obj/upload.o
-DEPS_32 += $(BUILD)/obj/est.o
-DEPS_32 += $(BUILD)/obj/matrixssl.o
-DEPS_32 += $(BUILD)/obj/nanossl.o
-DEPS_32 += $(BUILD)/obj/openssl.o
+DEPS_34 += $(BUILD)/inc/osdep.h
+DEPS_34 += $(BUILD)/inc/goahead.h
+DEPS_34 += $(BUILD)/inc/js.h
+DEPS_34 += $(BUILD)/obj/action.o
+DEPS_34 += $(BUILD)/obj/alloc.o
+DEPS_34 += $(BUILD)/obj/auth.o
+DEPS_34 += $(BUILD)/obj/cgi.o
+DEPS_34 += $(BUILD)/obj/crypt.o
+DEPS_34 += $(BUILD)/obj/file.o
+DEPS_34 += $(BUILD)/obj/fs.o
+DEPS_34 += $(BUILD)/obj/http.o
+DEPS_34 += $(BUILD)/obj/js.o
+DEPS_34 += $(BUILD)/obj/jst.o
+DEPS_34 += $(BUILD)/obj/options.o
+DEPS_34 += $(BUILD)/obj/osdep.o
+DEPS_34 += $(BUILD)/obj/rom-documents.o
+DEPS_34 += $(BUILD)/obj/route.o
+DEPS_34 += $(BUILD)/obj/runtime.o
+DEPS_34 += $(BUILD)/obj/socket.o
+DEPS_34 += $(BUILD)/obj/upload.o
+DEPS_34 += $(BUILD)/obj/est.o
+DEPS_34 += $(BUILD)/obj/matrixssl.o
+DEPS_34 += $(BUILD)/obj/nanossl.o
+DEPS_34 += $(BUILD)/obj/openssl.o
 
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_32 += -lssl
-    LIBPATHS_32 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_32 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_34 += -lssl
+    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_32 += -lcrypto
-    LIBPATHS_32 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_32 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_34 += -lcrypto
+    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_EST),1)
-    LIBS_32 += -lest
+    LIBS_34 += -lest
 endif
 
-$(BUILD)/bin/libgo.so: $(DEPS_32)
+$(BUILD)/bin/libgo.so: $(DEPS_34)
 	@echo '      [Link] $(BUILD)/bin/libgo.so'
-	$(CC) -shared -o $(BUILD)/bin/libgo.so $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/action.o" "$(BUILD)/obj/alloc.o" "$(BUILD)/obj/auth.o" "$(BUILD)/obj/cgi.o" "$(BUILD)/obj/crypt.o" "$(BUILD)/obj/file.o" "$(BUILD)/obj/fs.o" "$(BUILD)/obj/http.o" "$(BUILD)/obj/js.o" "$(BUILD)/obj/jst.o" "$(BUILD)/obj/options.o" "$(BUILD)/obj/osdep.o" "$(BUILD)/obj/rom-documents.o" "$(BUILD)/obj/route.o" "$(BUILD)/obj/runtime.o" "$(BUILD)/obj/socket.o" "$(BUILD)/obj/upload.o" "$(BUILD)/obj/est.o" "$(BUILD)/obj/matrixssl.o" "$(BUILD)/obj/nanossl.o" "$(BUILD)/obj/openssl.o" $(LIBPATHS_32) $(LIBS_32) $(LIBS_32) $(LIBS) 
+	$(CC) -shared -o $(BUILD)/bin/libgo.so $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/action.o" "$(BUILD)/obj/alloc.o" "$(BUILD)/obj/auth.o" "$(BUILD)/obj/cgi.o" "$(BUILD)/obj/crypt.o" "$(BUILD)/obj/file.o" "$(BUILD)/obj/fs.o" "$(BUILD)/obj/http.o" "$(BUILD)/obj/js.o" "$(BUILD)/obj/jst.o" "$(BUILD)/obj/options.o" "$(BUILD)/obj/osdep.o" "$(BUILD)/obj/rom-documents.o" "$(BUILD)/obj/route.o" "$(BUILD)/obj/runtime.o" "$(BUILD)/obj/socket.o" "$(BUILD)/obj/upload.o" "$(BUILD)/obj/est.o" "$(BUILD)/obj/matrixssl.o" "$(BUILD)/obj/nanossl.o" "$(BUILD)/obj/openssl.o" $(LIBPATHS_34) $(LIBS_34) $(LIBS_34) $(LIBS) 
 
 #
 #   goahead
 #
-DEPS_33 += $(BUILD)/bin/libgo.so
-DEPS_33 += $(BUILD)/inc/goahead.h
-DEPS_33 += $(BUILD)/inc/js.h
-DEPS_33 += $(BUILD)/obj/goahead.o
+DEPS_35 += $(BUILD)/bin/libgo.so
+DEPS_35 += $(BUILD)/inc/goahead.h
+DEPS_35 += $(BUILD)/inc/js.h
+DEPS_35 += $(BUILD)/obj/goahead.o
 
-LIBS_33 += -lgo
+LIBS_35 += -lgo
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_33 += -lssl
-    LIBPATHS_33 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_33 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_35 += -lssl
+    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_33 += -lcrypto
-    LIBPATHS_33 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_33 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_35 += -lcrypto
+    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_EST),1)
-    LIBS_33 += -lest
+    LIBS_35 += -lest
 endif
 
-$(BUILD)/bin/goahead: $(DEPS_33)
+$(BUILD)/bin/goahead: $(DEPS_35)
 	@echo '      [Link] $(BUILD)/bin/goahead'
-	$(CC) -o $(BUILD)/bin/goahead $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/goahead.o" $(LIBPATHS_33) $(LIBS_33) $(LIBS_33) $(LIBS) $(LIBS) 
+	$(CC) -o $(BUILD)/bin/goahead $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/goahead.o" $(LIBPATHS_35) $(LIBS_35) $(LIBS_35) $(LIBS) $(LIBS) 
 
 #
 #   goahead-test
 #
-DEPS_34 += $(BUILD)/bin/libgo.so
-DEPS_34 += $(BUILD)/inc/goahead.h
-DEPS_34 += $(BUILD)/inc/js.h
-DEPS_34 += $(BUILD)/obj/test.o
+DEPS_36 += $(BUILD)/bin/libgo.so
+DEPS_36 += $(BUILD)/inc/goahead.h
+DEPS_36 += $(BUILD)/inc/js.h
+DEPS_36 += $(BUILD)/obj/test.o
 
-LIBS_34 += -lgo
+LIBS_36 += -lgo
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_34 += -lssl
-    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_36 += -lssl
+    LIBPATHS_36 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_36 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_34 += -lcrypto
-    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_34 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_36 += -lcrypto
+    LIBPATHS_36 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_36 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_EST),1)
-    LIBS_34 += -lest
+    LIBS_36 += -lest
 endif
 
-$(BUILD)/bin/goahead-test: $(DEPS_34)
+$(BUILD)/bin/goahead-test: $(DEPS_36)
 	@echo '      [Link] $(BUILD)/bin/goahead-test'
-	$(CC) -o $(BUILD)/bin/goahead-test $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/test.o" $(LIBPATHS_34) $(LIBS_34) $(LIBS_34) $(LIBS) $(LIBS) 
+	$(CC) -o $(BUILD)/bin/goahead-test $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/test.o" $(LIBPATHS_36) $(LIBS_36) $(LIBS_36) $(LIBS) $(LIBS) 
 
 #
 #   gopass
 #
-DEPS_35 += $(BUILD)/bin/libgo.so
-DEPS_35 += $(BUILD)/inc/goahead.h
-DEPS_35 += $(BUILD)/inc/js.h
-DEPS_35 += $(BUILD)/obj/gopass.o
+DEPS_37 += $(BUILD)/bin/libgo.so
+DEPS_37 += $(BUILD)/inc/goahead.h
+DEPS_37 += $(BUILD)/inc/js.h
+DEPS_37 += $(BUILD)/obj/gopass.o
 
-LIBS_35 += -lgo
+LIBS_37 += -lgo
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_35 += -lssl
-    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_37 += -lssl
+    LIBPATHS_37 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_37 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_OPENSSL),1)
-    LIBS_35 += -lcrypto
-    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)/lib"
-    LIBPATHS_35 += -L"$(ME_COM_OPENSSL_PATH)"
+    LIBS_37 += -lcrypto
+    LIBPATHS_37 += -L"$(ME_COM_OPENSSL_PATH)/lib"
+    LIBPATHS_37 += -L"$(ME_COM_OPENSSL_PATH)"
 endif
 ifeq ($(ME_COM_EST),1)
-    LIBS_35 += -lest
+    LIBS_37 += -lest
 endif
 
-$(BUILD)/bin/gopass: $(DEPS_35)
+$(BUILD)/bin/gopass: $(DEPS_37)
 	@echo '      [Link] $(BUILD)/bin/gopass'
-	$(CC) -o $(BUILD)/bin/gopass $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/gopass.o" $(LIBPATHS_35) $(LIBS_35) $(LIBS_35) $(LIBS) $(LIBS) 
+	$(CC) -o $(BUILD)/bin/gopass $(LDFLAGS) $(LIBPATHS)   "$(BUILD)/obj/gopass.o" $(LIBPATHS_37) $(LIBS_37) $(LIBS_37) $(LIBS) $(LIBS) 
 
 #
 #   stop
 #
 
-stop: $(DEPS_36)
+stop: $(DEPS_38)
 
 #
 #   installBinary
 #
 
-installBinary: $(DEPS_37)
+installBinary: $(DEPS_39)
 	mkdir -p "$(ME_APP_PREFIX)" ; \
 	rm -f "$(ME_APP_PREFIX)/latest" ; \
 	ln -s "3.4.4" "$(ME_APP_PREFIX)/latest" ; \
@@ -631,22 +657,22 @@ installBinary: $(DEPS_37)
 #   start
 #
 
-start: $(DEPS_38)
+start: $(DEPS_40)
 
 #
 #   install
 #
-DEPS_39 += stop
-DEPS_39 += installBinary
-DEPS_39 += start
+DEPS_41 += stop
+DEPS_41 += installBinary
+DEPS_41 += start
 
-install: $(DEPS_39)
+install: $(DEPS_41)
 
 #
 #   installPrep
 #
 
-installPrep: $(DEPS_40)
+installPrep: $(DEPS_42)
 	if [ "`id -u`" != 0 ] ; \
 	then echo "Must run as root. Rerun with "sudo"" ; \
 	exit 255 ; \
@@ -655,9 +681,9 @@ installPrep: $(DEPS_40)
 #
 #   uninstall
 #
-DEPS_41 += stop
+DEPS_43 += stop
 
-uninstall: $(DEPS_41)
+uninstall: $(DEPS_43)
 	rm -fr "$(ME_WEB_PREFIX)" ; \
 	rm -fr "$(ME_VAPP_PREFIX)" ; \
 	rmdir -p "$(ME_ETC_PREFIX)" 2>/dev/null ; true ; \
@@ -669,6 +695,6 @@ uninstall: $(DEPS_41)
 #   version
 #
 
-version: $(DEPS_42)
+version: $(DEPS_44)
 	echo 3.4.4
 
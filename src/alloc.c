@@ -1,14 +1,19 @@
 /*
     alloc.c -- Optional WebServer memory allocator
 
-    This file implements a fast block allocation scheme suitable for operating systems whoes malloc suffers from
-    fragmentation.  This allocator maintains block class queues for rapid allocation and minimal fragmentation. This
-    allocator does not coalesce blocks. The storage space may be populated statically or via the traditional malloc
-    mechanisms. Large blocks greater than the maximum class size may be allocated from the O/S or run-time system via
-    malloc. To permit the use of malloc, call wopen with flags set to WEBS_USE_MALLOC (this is the default).  It is
-    recommended that wopen be called first thing in the application.  If it is not, it will be called with default
-    values on the first call to walloc(). Note that this code is not designed for multi-threading purposes and it
-    depends on newly declared variables being initialized to zero.
+    This file implements a slab allocator suitable for operating systems whose malloc suffers from fragmentation.
+    Allocations are rounded up to one of the size classes. Each class allocates blocks from slabs of SLAB_SIZE bytes
+    that hold blocks of a single class. When all the blocks of a slab are freed, the slab is returned to the O/S
+    (or to the primary memory region for reuse by any class). One empty slab per class is retained to avoid
+    thrashing. Blocks greater than the maximum class size are allocated from the O/S or run-time system via malloc.
+
+    The storage space may be populated statically or via the traditional malloc mechanisms. To permit the use of
+    malloc, call wopenAlloc with flags set to WEBS_USE_MALLOC (this is the default). It is recommended that wopenAlloc
+    be called first thing in the application. If it is not, it will be called with default values on the first call
+    to walloc().
+
+    On Unix and Windows systems, the allocator is thread-safe. On Unix, each thread keeps a small cache of free blocks
+    per class so most allocations do not need to take the allocator lock.
 
     Copyright (c) All Rights Reserved. See details at the end of the file.
  */
@@ -18,214 +23,323 @@
 
 #if ME_GOAHEAD_REPLACE_MALLOC
 /********************************* Defines ************************************/
+
+#define SLAB_SIZE       (64 * 1024)         /* Size of a slab of blocks */
+#define SLAB_ALIGN      16                  /* Alignment of slabs and blocks */
+#define CACHE_SIZE      16                  /* Per-thread cached blocks per class */
+#define CLASS_MASK      0xFF                /* Block flags mask for the size class */
+#define CLASS_LARGE     0xFF                /* Size class for blocks allocated individually via malloc */
+
+#define ALIGN(size)     (((size) + SLAB_ALIGN - 1) & ~(SLAB_ALIGN - 1))
+#define BLOCK_HDR       ALIGN(sizeof(WebsAlloc))
+#define SLAB_HDR        ALIGN(sizeof(WebsSlab))
+
 /*
-    ROUNDUP4(size) returns the next higher integer value of size that is divisible by 4, or the value of size if size is
-    divisible by 4. ROUNDUP4() is used in aligning memory allocations on 4-byte boundaries.
-    Note:  ROUNDUP4() is only required on some operating systems.
+    A slab holds blocks of a single size class. Never used blocks are carved from the slab on demand.
  */
-#define ROUNDUP4(size) ((size) % 4) ? (size) + (4 - ((size) % 4)) : (size)
+typedef struct WebsSlab {
+    struct WebsSlab *next;                  /* Next slab in the class list */
+    struct WebsSlab *prev;                  /* Previous slab in the class list */
+    WebsAlloc       *freeList;              /* Freed blocks */
+    char            *carve;                 /* Next never used block */
+    char            *end;                   /* End of the slab */
+    int             cls;                    /* Size class */
+    int             inuse;                  /* Number of allocated blocks */
+    int             region;                 /* Slab is from the primary memory region */
+} WebsSlab;
 
 /*
-    qhead blocks are created as the original memory allocation is freed up. See wfree.
+    Size class state. Slabs with free blocks are kept at the front of the list, full slabs at the end.
  */
-static WebsAlloc    *qhead[WEBS_MAX_CLASS];             /* Per class block q head */
-static char         *freeBuf;                           /* Pointer to free memory */
-static char         *freeNext;                          /* Pointer to next free mem */
-static int          freeSize;                           /* Size of free memory */
-static int          freeLeft;                           /* Size of free left for use */
+typedef struct AllocClass {
+    WebsSlab        *slabs;                 /* List of slabs for this class */
+    ssize           blocks;                 /* Blocks allocated (including blocks in thread caches) */
+    int             slabCount;              /* Number of slabs */
+    int             emptyCount;             /* Number of slabs without allocated blocks */
+} AllocClass;
+
+static int classSize[WEBS_MAX_CLASS] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384
+};
+
+static AllocClass   classes[WEBS_MAX_CLASS];
+static uchar        sizeIndex[(1024 / 16) + 1];         /* Map of (size + 15) / 16 to a class for small sizes */
+static WebsSlab     *regionSlabs;                       /* Free slabs from the primary region */
+static char         *freeBuf;                           /* Pointer to the primary memory region */
+static char         *freeNext;                          /* Pointer to next free memory in the region */
+static ssize        freeLeft;                           /* Size of free memory left in the region */
+static ssize        largeBlocks;                        /* Number of large blocks */
+static ssize        largeBytes;                         /* Memory allocated for large blocks */
 static int          controlFlags = WEBS_USE_MALLOC;     /* Default to auto-malloc */
 static int          wopenCount = 0;                     /* Num tasks using walloc */
 
+#if ME_UNIX_LIKE
+static pthread_mutex_t allocLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK() pthread_mutex_lock(&allocLock)
+#define UNLOCK() pthread_mutex_unlock(&allocLock)
+#if __GNUC__ || __clang__
+    #define WEBS_ALLOC_CACHE 1
+#endif
+#elif ME_WIN_LIKE
+static SRWLOCK allocLock = SRWLOCK_INIT;
+#define LOCK() AcquireSRWLockExclusive(&allocLock)
+#define UNLOCK() ReleaseSRWLockExclusive(&allocLock)
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+#if WEBS_ALLOC_CACHE
+/*
+    Per-thread block cache. Blocks in the cache are counted as allocated by their slab. A cache from before the 
+    allocator was last closed refers to released slabs and is discarded.
+ */
+typedef struct AllocCache {
+    WebsAlloc       *blocks[WEBS_MAX_CLASS][CACHE_SIZE];
+    int             count[WEBS_MAX_CLASS];
+    uint            generation;         /* Allocator generation when the cache was filled */
+} AllocCache;
+
+static __thread AllocCache cache;
+static uint         cacheGeneration;    /* Incremented when the allocator is closed */
+static __thread int cacheRegistered;
+static pthread_key_t cacheKey;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+#endif
+
 /*************************** Forward Declarations *****************************/
 
-static int wallocGetSize(ssize size, int *q);
+static WebsAlloc *allocBlock(int cls);
+static void freeBlock(WebsAlloc *bp);
+static int getClass(ssize size);
+static void initClasses();
+#if WEBS_ALLOC_CACHE
+static void registerCache();
+static void resetCache();
+#endif
 
 /********************************** Code **************************************/
 /*
     Initialize the walloc module. wopenAlloc should be called the very first thing after the application starts and 
     wcloseAlloc should be called the last thing before exiting. If wopenAlloc is not called, it will be called on the first
     allocation with default values. "buf" points to memory to use of size "bufsize". If buf is NULL, memory is allocated
-    using malloc. flags may be set to WEBS_USE_MALLOC if using malloc is okay. This routine will allocate *  an initial
-    buffer of size bufsize for use by the application.
+    using malloc. flags may be set to WEBS_USE_MALLOC if using malloc is okay. This routine will allocate an initial
+    buffer of size bufsize for use by the application. The buffer is divided into slabs.
  */
 PUBLIC int wopenAlloc(void *buf, int bufsize, int flags)
 {
-    controlFlags = flags;
-
+    LOCK();
     /*
         If wopen already called by a shared process, just increment the count and return
      */
     if (++wopenCount > 1) {
+        UNLOCK();
         return 0;
     }
+    controlFlags = flags;
     if (buf == NULL) {
         if (bufsize == 0) {
             bufsize = WEBS_DEFAULT_MEM;
         }
-        bufsize = ROUNDUP4(bufsize);
         if ((buf = malloc(bufsize)) == NULL) {
             /* 
                 Resetting wopenCount so client code can decide to call wopenAlloc() again with a smaller memory request.
             */
-             --wopenCount;
+            --wopenCount;
+            UNLOCK();
             return -1;
         }
     } else {
         controlFlags |= WEBS_USER_BUF;
     }
-    freeSize = freeLeft = bufsize;
-    freeBuf = freeNext = buf;
-    memset(qhead, 0, sizeof(qhead));
+    freeBuf = buf;
+    freeNext = (char*) ALIGN((size_t) freeBuf);
+    freeLeft = bufsize - (freeNext - freeBuf);
+    regionSlabs = 0;
+    initClasses();
+    UNLOCK();
     return 0;
 }
 
 
 PUBLIC void wcloseAlloc()
 {
-    if (--wopenCount <= 0 && !(controlFlags & WEBS_USER_BUF)) {
-        free(freeBuf);
+    WebsSlab    *sp, *next;
+    int         cls;
+
+    LOCK();
+    if (--wopenCount <= 0) {
+        /*
+            Release slabs allocated from the O/S. Blocks still allocated from these slabs are no longer valid.
+         */
+        for (cls = 0; cls < WEBS_MAX_CLASS; cls++) {
+            for (sp = classes[cls].slabs; sp; sp = next) {
+                next = sp->next;
+                if (!sp->region) {
+                    free(sp);
+                }
+            }
+            classes[cls].slabs = 0;
+        }
+        if (!(controlFlags & WEBS_USER_BUF)) {
+            free(freeBuf);
+        }
+        freeBuf = freeNext = 0;
+        freeLeft = 0;
+        regionSlabs = 0;
         wopenCount = 0;
+#if WEBS_ALLOC_CACHE
+        /*
+            Thread caches hold blocks from the released slabs. Discard this thread's cache now and other threads' 
+            caches on their next use.
+         */
+        cacheGeneration++;
+        resetCache();
+#endif
     }
+    UNLOCK();
 }
 
 
 /*
-    Allocate a block of the requested size. First check the block queues for a suitable one.
+    Allocate a block of the requested size. First check the thread cache, then the class slabs.
  */
 PUBLIC void *walloc(ssize size)
 {
     WebsAlloc   *bp;
-    int     q, memSize;
+    int         cls;
 
+    if (size < 0) {
+        return NULL;
+    }
     /*
         Call wopen with default values if the application has not yet done so
      */
-    if (freeBuf == NULL) {
-        if (wopenAlloc(NULL, WEBS_DEFAULT_MEM, 0) < 0) {
+    if (wopenCount == 0) {
+        if (wopenAlloc(NULL, WEBS_DEFAULT_MEM, WEBS_USE_MALLOC) < 0) {
             return NULL;
         }
     }
-    if (size < 0) {
-        return NULL;
-    }
-    memSize = wallocGetSize(size, &q);
-
-    if (q >= WEBS_MAX_CLASS) {
+    if ((cls = getClass(size)) == CLASS_LARGE) {
         /*
-            Size if bigger than the maximum class. Malloc if use has been okayed
+            Size is bigger than the maximum class. Malloc if use has been okayed
          */
-        if (controlFlags & WEBS_USE_MALLOC) {
-            memSize = ROUNDUP4(memSize);
-            bp = (WebsAlloc*) malloc(memSize);
-            if (bp == NULL) {
-                printf("B: malloc failed\n");
-                return NULL;
-            }
-        } else {
-            printf("B: malloc failed\n");
-            return NULL;
-        }
-        /*
-            the u.size is the actual size allocated for data
-         */
-        bp->u.size = memSize - sizeof(WebsAlloc);
-        bp->flags = WEBS_MALLOCED;
-
-    } else if ((bp = qhead[q]) != NULL) {
-        /*
-            Take first block off the relevant q if non-empty
-         */
-        qhead[q] = bp->u.next;
-        bp->u.size = memSize - sizeof(WebsAlloc);
-        bp->flags = 0;
-
-    } else {
-        if (freeLeft > memSize) {
-            /*
-                The q was empty, and the free list has spare memory so create a new block out of the primary free block
-             */
-            bp = (WebsAlloc*) freeNext;
-            freeNext += memSize;
-            freeLeft -= memSize;
-            bp->u.size = memSize - sizeof(WebsAlloc);
-            bp->flags = 0;
-
-        } else if (controlFlags & WEBS_USE_MALLOC) {
-            /*
-                Nothing left on the primary free list, so malloc a new block
-             */
-            memSize = ROUNDUP4(memSize);
-            if ((bp = (WebsAlloc*) malloc(memSize)) == NULL) {
-                printf("B: malloc failed\n");
-                return NULL;
-            }
-            bp->u.size = memSize - sizeof(WebsAlloc);
-            bp->flags = WEBS_MALLOCED;
-
-        } else {
+        if (!(controlFlags & WEBS_USE_MALLOC) || (bp = (WebsAlloc*) malloc(BLOCK_HDR + size)) == NULL) {
             printf("B: malloc failed\n");
             return NULL;
         }
+        bp->u.size = size;
+        bp->flags = WEBS_INTEGRITY | WEBS_MALLOCED | CLASS_LARGE;
+        LOCK();
+        largeBlocks++;
+        largeBytes += size;
+        UNLOCK();
+        return (void*) ((char*) bp + BLOCK_HDR);
+    }
+#if WEBS_ALLOC_CACHE
+    if (cache.generation != cacheGeneration) {
+        resetCache();
     }
-    bp->flags |= WEBS_INTEGRITY;
-    return (void*) ((char*) bp + sizeof(WebsAlloc));
+    if (cache.count[cls] > 0) {
+        bp = cache.blocks[cls][--cache.count[cls]];
+        bp->flags = WEBS_INTEGRITY | cls;
+        return (void*) ((char*) bp + BLOCK_HDR);
+    }
+#endif
+    LOCK();
+    bp = allocBlock(cls);
+    UNLOCK();
+    if (bp == NULL) {
+        printf("B: malloc failed\n");
+        return NULL;
+    }
+    return (void*) ((char*) bp + BLOCK_HDR);
 }
 
 
 /*
-    Free a block back to the relevant free q. We don't free back to the O/S or run time system unless the block is
-    greater than the maximum class size. We also do not coalesce blocks.  
+    Free a block back to its slab. Large blocks are returned to the O/S or run time system. 
  */
 PUBLIC void wfree(void *mp)
 {
     WebsAlloc   *bp;
-    int     q;
+    int         cls;
 
     if (mp == 0) {
         return;
     }
-    bp = (WebsAlloc*) ((char*) mp - sizeof(WebsAlloc));
+    bp = (WebsAlloc*) ((char*) mp - BLOCK_HDR);
     assert((bp->flags & WEBS_INTEGRITY_MASK) == WEBS_INTEGRITY);
     if ((bp->flags & WEBS_INTEGRITY_MASK) != WEBS_INTEGRITY) {
         return;
     }
-    wallocGetSize(bp->u.size, &q);
-    if (bp->flags & WEBS_MALLOCED) {
+    cls = bp->flags & CLASS_MASK;
+    if (cls == CLASS_LARGE) {
+        LOCK();
+        largeBlocks--;
+        largeBytes -= bp->u.size;
+        UNLOCK();
+        bp->flags = WEBS_FILL_WORD;
         free(bp);
         return;
     }
-    /*
-        Simply link onto the head of the relevant q
-     */
-    bp->u.next = qhead[q];
-    qhead[q] = bp;
-    bp->flags = WEBS_FILL_WORD;
+#if WEBS_ALLOC_CACHE
+    if (cache.generation != cacheGeneration) {
+        resetCache();
+    }
+    if (cache.count[cls] < CACHE_SIZE) {
+        if (!cacheRegistered) {
+            registerCache();
+        }
+        bp->flags = WEBS_FILL_WORD;
+        cache.blocks[cls][cache.count[cls]++] = bp;
+        return;
+    }
+#endif
+    LOCK();
+    freeBlock(bp);
+    UNLOCK();
 }
 
 
 /*
     Reallocate a block. Allow NULL pointers and just do a malloc. Note: if the realloc fails, we return NULL and the
-    previous buffer is preserved.
+    previous buffer is preserved. Blocks are grown in place if the size class has room or if a large block can be
+    extended by the run time system.
  */
 PUBLIC void *wrealloc(void *mp, ssize newsize)
 {
-    WebsAlloc   *bp;
-    void    *newbuf;
+    WebsAlloc   *bp, *np;
+    void        *newbuf;
+    ssize       size;
+    int         cls;
 
     if (mp == NULL) {
         return walloc(newsize);
     }
-    bp = (WebsAlloc*) ((char*) mp - sizeof(WebsAlloc));
+    bp = (WebsAlloc*) ((char*) mp - BLOCK_HDR);
     assert((bp->flags & WEBS_INTEGRITY_MASK) == WEBS_INTEGRITY);
 
+    cls = bp->flags & CLASS_MASK;
+    size = (cls == CLASS_LARGE) ? bp->u.size : classSize[cls];
     /*
         If the allocated memory already has enough room just return the previously allocated address.
      */
-    if (bp->u.size >= newsize) {
+    if (size >= newsize) {
         return mp;
     }
+    if (cls == CLASS_LARGE) {
+        if ((np = realloc(bp, BLOCK_HDR + newsize)) == NULL) {
+            return NULL;
+        }
+        LOCK();
+        largeBytes += newsize - np->u.size;
+        UNLOCK();
+        np->u.size = newsize;
+        return (void*) ((char*) np + BLOCK_HDR);
+    }
     if ((newbuf = walloc(newsize)) != NULL) {
-        memcpy(newbuf, mp, bp->u.size);
+        memcpy(newbuf, mp, size);
         wfree(mp);
     }
     return newbuf;
@@ -233,20 +347,290 @@ PUBLIC void *wrealloc(void *mp, ssize newsize)
 
 
 /*
-    Find the size of the block to be walloc'ed.  It takes in a size, finds the smallest binary block it fits into, adds
-    an overhead amount and returns.  q is the binary size used to keep track of block sizes in use.  Called from both
-    walloc and wfree.
+    Return allocator statistics
+ */
+PUBLIC void wallocStats(WebsAllocStats *stats)
+{
+    AllocClass  *cp;
+    int         cls;
+
+    assert(stats);
+
+    memset(stats, 0, sizeof(WebsAllocStats));
+    LOCK();
+    for (cls = 0; cls < WEBS_MAX_CLASS; cls++) {
+        cp = &classes[cls];
+        stats->classes[cls].size = classSize[cls];
+        stats->classes[cls].blocks = cp->blocks;
+        stats->classes[cls].bytes = cp->blocks * classSize[cls];
+        stats->classes[cls].slabs = cp->slabCount;
+        stats->blocks += cp->blocks;
+        stats->bytes += cp->blocks * classSize[cls];
+        stats->slabs += cp->slabCount;
+    }
+    stats->largeBlocks = largeBlocks;
+    stats->largeBytes = largeBytes;
+    stats->blocks += largeBlocks;
+    stats->bytes += largeBytes;
+    stats->regionFree = freeLeft;
+    UNLOCK();
+}
+
+
+static void initClasses()
+{
+    int     cls, i;
+
+    memset(classes, 0, sizeof(classes));
+    for (i = 0, cls = 0; i < (int) sizeof(sizeIndex); i++) {
+        while (classSize[cls] < i * 16) {
+            cls++;
+        }
+        sizeIndex[i] = cls;
+    }
+}
+
+
+/*
+    Find the size class for a block. Returns CLASS_LARGE if bigger than the maximum class.
  */
-static int wallocGetSize(ssize size, int *q)
+static int getClass(ssize size)
 {
-    int mask;
+    int     cls;
 
-    mask = (size == 0) ? 0 : (size-1) >> WEBS_SHIFT;
-    for (*q = 0; mask; mask >>= 1) {
-        *q = *q + 1;
+    if (size <= 1024) {
+        return sizeIndex[(size + 15) >> 4];
+    }
+    for (cls = sizeIndex[1024 >> 4] + 1; cls < WEBS_MAX_CLASS; cls++) {
+        if (size <= classSize[cls]) {
+            return cls;
+        }
+    }
+    return CLASS_LARGE;
+}
+
+
+/*
+    Get a new slab from the primary region or from the O/S. Must be called locked.
+ */
+static WebsSlab *getSlab(int cls)
+{
+    AllocClass  *cp;
+    WebsSlab    *sp;
+    int         region;
+
+    region = 1;
+    if ((sp = regionSlabs) != 0) {
+        regionSlabs = sp->next;
+    } else if (freeLeft >= SLAB_SIZE) {
+        sp = (WebsSlab*) freeNext;
+        freeNext += SLAB_SIZE;
+        freeLeft -= SLAB_SIZE;
+    } else if (controlFlags & WEBS_USE_MALLOC) {
+        if ((sp = malloc(SLAB_SIZE)) == NULL) {
+            return NULL;
+        }
+        region = 0;
+    } else {
+        return NULL;
+    }
+    memset(sp, 0, sizeof(WebsSlab));
+    sp->cls = cls;
+    sp->region = region;
+    sp->carve = (char*) sp + SLAB_HDR;
+    sp->end = (char*) sp + SLAB_SIZE;
+
+    cp = &classes[cls];
+    if ((sp->next = cp->slabs) != 0) {
+        cp->slabs->prev = sp;
     }
-    return ((1 << (WEBS_SHIFT + *q)) + sizeof(WebsAlloc));
+    cp->slabs = sp;
+    cp->slabCount++;
+    cp->emptyCount++;
+    return sp;
+}
+
+
+/*
+    Remove an empty slab from its class and return it to the region or O/S. Must be called locked.
+ */
+static void releaseSlab(WebsSlab *sp)
+{
+    AllocClass  *cp;
+
+    cp = &classes[sp->cls];
+    if (sp->prev) {
+        sp->prev->next = sp->next;
+    } else {
+        cp->slabs = sp->next;
+    }
+    if (sp->next) {
+        sp->next->prev = sp->prev;
+    }
+    cp->slabCount--;
+    cp->emptyCount--;
+    if (sp->region) {
+        sp->next = regionSlabs;
+        regionSlabs = sp;
+    } else {
+        free(sp);
+    }
+}
+
+
+/*
+    Move a slab to the end (full) or front (has free blocks) of its class list. Must be called locked.
+ */
+static void moveSlab(WebsSlab *sp, int toFront)
+{
+    AllocClass  *cp;
+    WebsSlab    *last;
+
+    cp = &classes[sp->cls];
+    if (toFront ? (cp->slabs == sp) : (sp->next == 0)) {
+        return;
+    }
+    if (sp->prev) {
+        sp->prev->next = sp->next;
+    } else {
+        cp->slabs = sp->next;
+    }
+    if (sp->next) {
+        sp->next->prev = sp->prev;
+    }
+    if (toFront) {
+        sp->prev = 0;
+        if ((sp->next = cp->slabs) != 0) {
+            cp->slabs->prev = sp;
+        }
+        cp->slabs = sp;
+    } else {
+        for (last = cp->slabs; last && last->next; last = last->next) ;
+        sp->next = 0;
+        if ((sp->prev = last) != 0) {
+            last->next = sp;
+        } else {
+            cp->slabs = sp;
+        }
+    }
+}
+
+
+static bool slabFull(WebsSlab *sp)
+{
+    return sp->freeList == 0 && (sp->carve + BLOCK_HDR + classSize[sp->cls]) > sp->end;
+}
+
+
+/*
+    Allocate a block of a given class. Must be called locked.
+ */
+static WebsAlloc *allocBlock(int cls)
+{
+    AllocClass  *cp;
+    WebsSlab    *sp;
+    WebsAlloc   *bp;
+
+    cp = &classes[cls];
+    if ((sp = cp->slabs) == 0 || slabFull(sp)) {
+        if ((sp = getSlab(cls)) == 0) {
+            return NULL;
+        }
+    }
+    if ((bp = sp->freeList) != 0) {
+        sp->freeList = bp->u.next;
+    } else {
+        bp = (WebsAlloc*) sp->carve;
+        sp->carve += BLOCK_HDR + classSize[cls];
+    }
+    if (sp->inuse++ == 0) {
+        cp->emptyCount--;
+    }
+    cp->blocks++;
+    bp->u.slab = sp;
+    bp->flags = WEBS_INTEGRITY | cls;
+    if (slabFull(sp)) {
+        moveSlab(sp, 0);
+    }
+    return bp;
+}
+
+
+/*
+    Free a block to its slab. Must be called locked.
+ */
+static void freeBlock(WebsAlloc *bp)
+{
+    AllocClass  *cp;
+    WebsSlab    *sp;
+    int         wasFull;
+
+    sp = bp->u.slab;
+    cp = &classes[sp->cls];
+    wasFull = slabFull(sp);
+    bp->flags = WEBS_FILL_WORD;
+    bp->u.next = sp->freeList;
+    sp->freeList = bp;
+    cp->blocks--;
+    if (--sp->inuse == 0) {
+        /*
+            Retain one empty slab per class and return others
+         */
+        if (++cp->emptyCount > 1) {
+            releaseSlab(sp);
+            return;
+        }
+    }
+    if (wasFull) {
+        moveSlab(sp, 1);
+    }
+}
+
+
+#if WEBS_ALLOC_CACHE
+/*
+    Return the blocks in the thread cache to their slabs when a thread exits. If the allocator has been closed since
+    the cache was filled, the slabs are gone and the cache is just discarded.
+ */
+static void flushCache(void *arg)
+{
+    WebsAlloc   *bp;
+    int         cls;
+
+    LOCK();
+    if (wopenCount > 0 && cache.generation == cacheGeneration) {
+        for (cls = 0; cls < WEBS_MAX_CLASS; cls++) {
+            while (cache.count[cls] > 0) {
+                bp = cache.blocks[cls][--cache.count[cls]];
+                freeBlock(bp);
+            }
+        }
+    }
+    resetCache();
+    UNLOCK();
+}
+
+
+static void resetCache()
+{
+    memset(cache.count, 0, sizeof(cache.count));
+    cache.generation = cacheGeneration;
+}
+
+
+static void createCacheKey()
+{
+    pthread_key_create(&cacheKey, flushCache);
+}
+
+
+static void registerCache()
+{
+    pthread_once(&cacheOnce, createCacheKey);
+    pthread_setspecific(cacheKey, &cache);
+    cacheRegistered = 1;
 }
+#endif
 
 
 #else /* !ME_GOAHEAD_REPLACE_MALLOC */
@@ -1049,6 +1049,14 @@ PUBLIC int websSetRouteAuth(WebsRoute *route, char *auth)
         parseAuth = parseDigestDetails;
 #endif
     } else {
+        if (websGetWorkers() > 1) {
+            /*
+                Form login state is kept in the session store which is private to each worker. The kernel spreads a
+                client's connections across workers, so logins would be lost.
+             */
+            error("Form authentication for route %s is not supported with worker processes", route->prefix);
+            return -1;
+        }
         auth = 0;
     }
     route->authType = sclone(auth);
@@ -5,8 +5,14 @@
     goforms processing in that each CGI request is executed as a separate 
     process, rather than within the webserver process. For each CGI request the
     environment of the new process must be set to include all the CGI variables
-    and its standard input and output must be directed to the socket.  This
-    is done using temporary files.
+    and its standard input and output must be directed to the socket.  On Unix,
+    this is done using non-blocking pipes that are serviced by the socket event
+    loop so output streams to the client as it is produced. Other systems use
+    temporary files that are polled for output.
+
+    On Unix, this module also implements the "fastcgi" handler. FastCGI programs
+    are run as a pool of persistent worker processes that are sent requests over
+    Unix domain sockets using the FastCGI protocol.
 
     Copyright (c) All Rights Reserved. See details at the end of the file.
  */
@@ -15,27 +21,152 @@
 
 #include    "goahead.h"
 
+#if WEBS_FASTCGI
+    #include    <sys/un.h>
+#endif
+
 /*********************************** Defines **********************************/
 #if ME_GOAHEAD_CGI && !ME_ROM
 
 typedef struct Cgi {            /* Struct for CGI tasks which have completed */
     Webs    *wp;                /* Connection object */
-    char    *stdIn;             /* File desc. for task's temp input fd */
-    char    *stdOut;            /* File desc. for task's temp output fd */
     char    *cgiPath;           /* Path to executable process file */
     char    **argp;             /* Pointer to buf containing argv tokens */
     char    **envp;             /* Pointer to array of environment strings */
     int     handle;             /* Process handle of the task */
+#if ME_UNIX_LIKE
+    char    *headers;           /* Output buffered until the CGI response headers are complete */
+    ssize   hlen;               /* Length of buffered header output */
+    int     inSid;              /* Socket handle for the pipe to the task's stdin */
+    int     outSid;             /* Socket handle for the pipe from the task's stdout */
+#else
+    char    *stdIn;             /* File desc. for task's temp input fd */
+    char    *stdOut;            /* File desc. for task's temp output fd */
     off_t   fplacemark;         /* Seek location for CGI output file */
+#endif
 } Cgi;
 
 static Cgi      **cgiList;      /* walloc chain list of wp's to be closed */
 static int      cgiMax;         /* Size of walloc list */
 
+#if ME_UNIX_LIKE
+static int      cgiSignalPipe[2] = { -1, -1 };  /* Written by the SIGCHLD handler to wake the event loop */
+#endif
+
+#if WEBS_FASTCGI
+/*
+    FastCGI protocol definitions
+ */
+#define FCGI_VERSION                1
+#define FCGI_BEGIN_REQUEST          1
+#define FCGI_ABORT_REQUEST          2
+#define FCGI_END_REQUEST            3
+#define FCGI_PARAMS                 4
+#define FCGI_STDIN                  5
+#define FCGI_STDOUT                 6
+#define FCGI_STDERR                 7
+#define FCGI_GET_VALUES             9
+#define FCGI_GET_VALUES_RESULT      10
+#define FCGI_RESPONDER              1
+#define FCGI_KEEP_CONN              1
+#define FCGI_LISTENSOCK_FILENO      0
+#define FCGI_HEADER_LEN             8
+#define FCGI_MAX_RECORD             65535
+#define FCGI_MAX_REQUESTS           16      /* Maximum requests multiplexed over one connection */
+
+struct FcgiConn;
+struct FcgiPool;
+
+typedef struct FcgiRequest {    /* Request serviced by a FastCGI program */
+    Webs                *wp;        /* Connection object. Null if the request has been abandoned */
+    struct FcgiPool     *pool;      /* Pool servicing the request */
+    struct FcgiConn     *conn;      /* Connection carrying the request. Null while waiting for a connection */
+    struct FcgiRequest  *next;      /* Next request waiting for a connection */
+    char                *headers;   /* Output buffered until the CGI response headers are complete */
+    ssize               hlen;       /* Length of buffered header output */
+    int                 id;         /* FastCGI request ID on the connection */
+} FcgiRequest;
+
+typedef struct FcgiConn {       /* Persistent connection to a FastCGI program */
+    struct FcgiPool     *pool;      /* Owning pool */
+    FcgiRequest         *reqs[FCGI_MAX_REQUESTS + 1];   /* Active requests indexed by request ID */
+    Webs                *blocked;   /* Request whose client is not keeping up. Reading pauses until it drains */
+    WebsBuf             rx;         /* Records read from the program */
+    WebsBuf             tx;         /* Records to write to the program */
+    int                 active;     /* Number of active requests */
+    int                 failed;     /* Write to the program failed */
+    int                 index;      /* Index in the pool connections */
+    int                 sid;        /* Socket handle for the connection */
+} FcgiConn;
+
+typedef struct FcgiWorker {     /* FastCGI program process */
+    int                 pid;        /* Process ID. Zero if not running */
+    WebsTime            started;    /* Time the process was started */
+} FcgiWorker;
+
+typedef struct FcgiPool {       /* Pool of processes running a FastCGI program */
+    char                *program;   /* Path to the program */
+    char                *path;      /* Path of the listening socket shared by the workers */
+    FcgiConn            *conns[ME_GOAHEAD_FASTCGI_WORKERS];     /* Connections to the workers */
+    FcgiWorker          workers[ME_GOAHEAD_FASTCGI_WORKERS];    /* Worker processes */
+    FcgiRequest         *first;     /* First request waiting for a connection */
+    FcgiRequest         *last;      /* Last request waiting for a connection */
+    int                 connCount;  /* Number of open connections */
+    int                 listenFd;   /* Listening socket passed to the workers */
+    int                 maxRequests;/* Requests per connection. Set via FCGI_MPXS_CONNS */
+    int                 probed;     /* FCGI_GET_VALUES has been sent */
+    int                 respawn;    /* Event to restart workers that exit prematurely */
+} FcgiPool;
+
+static WebsHash fcgiPools = -1;     /* Pools indexed by program path */
+#endif /* WEBS_FASTCGI */
+
 /************************************ Forwards ********************************/
 
 static int checkCgi(int handle);
+static bool isCgiVar(WebsKey *s);
+static char *mapCgiProgram(Webs *wp, char *dir);
+#if ME_UNIX_LIKE
+static void childEvent(int sid, int mask, void *data);
+static void childSignal(int signo);
+static void endCgiOutput(Webs *wp, char *headers, ssize hlen);
+static void finishCgi(Cgi *cgip);
+static void gatherOutput(Cgi *cgip);
+static void inputEvent(int sid, int mask, void *data);
+static int launchCgi(char *cgiPath, char **argp, char **envp, int *fdin, int *fdout);
+static void outputEvent(int sid, int mask, void *data);
+static void resumeOutput(Webs *wp);
+static void writeInput(Cgi *cgip);
+#else
 static int launchCgi(char *cgiPath, char **argp, char **envp, char *stdIn, char *stdOut);
+#endif
+#if WEBS_FASTCGI
+static void closeFastCgi();
+static void completeRequest(FcgiRequest *req, char *msg);
+static void connEvent(int sid, int mask, void *data);
+static void detachRequest(FcgiRequest *req);
+static void dispatchRequests(FcgiPool *pool);
+static void endRequest(FcgiConn *conn, FcgiRequest *req);
+static void failConn(FcgiConn *conn);
+static bool fastCgiHandler(Webs *wp);
+static int flushConn(FcgiConn *conn);
+static void freeConn(FcgiConn *conn);
+static FcgiConn *getConn(FcgiPool *pool);
+static FcgiPool *getPool(char *program);
+static FcgiConn *openConn(FcgiPool *pool, int index);
+static int processRecords(FcgiConn *conn);
+static void putParams(FcgiConn *conn, FcgiRequest *req);
+static void putRecord(FcgiConn *conn, int type, int id, char *data, ssize len);
+static void readConn(FcgiConn *conn);
+static void reapWorkers();
+static void respawnEvent(void *data, int id);
+static void resumeFastCgi(Webs *wp);
+static void setValues(FcgiPool *pool, uchar *data, ssize len);
+static int spawnWorker(FcgiPool *pool, int index);
+static void startRequest(FcgiConn *conn, FcgiRequest *req);
+static void startWorkers(FcgiPool *pool);
+static void writeCgiOutput(Webs *wp, char *headers, ssize *hlen, char *buf, ssize len);
+#endif
 
 /************************************* Code ***********************************/
 /*
@@ -45,28 +176,160 @@ static bool cgiHandler(Webs *wp)
 {
     Cgi         *cgip;
     WebsKey     *s;
-    char        cgiPrefix[ME_GOAHEAD_LIMIT_FILENAME], *stdIn, *stdOut, cwd[ME_GOAHEAD_LIMIT_FILENAME];
-    char        *cp, *cgiName, *cgiPath, **argp, **envp, **ep, *tok, *query, *dir, *extraPath;
+    char        cwd[ME_GOAHEAD_LIMIT_FILENAME];
+    char        *cp, *cgiPath, **argp, **envp, **ep, *tok, *query, *dir;
     int         n, envpsize, argpsize, pHandle, cid;
+#if ME_UNIX_LIKE
+    int         fdin, fdout;
+#else
+    char        *stdIn, *stdOut;
+#endif
 
     assert(websValid(wp));
     
     websSetEnv(wp);
 
+    getcwd(cwd, ME_GOAHEAD_LIMIT_FILENAME);
+    dir = wp->route->dir ? wp->route->dir : cwd;
+    chdir(dir);
+    
+    if ((cgiPath = mapCgiProgram(wp, dir)) == 0) {
+        chdir(cwd);
+        return 1;
+    }
+    /*
+        Build command line arguments.  Only used if there is no non-encoded = character.  This is indicative of a ISINDEX
+        query.  POST separators are & and others are +.  argp will point to a walloc'd array of pointers.  Each pointer
+        will point to substring within the query string.  This array of string pointers is how the spawn or exec routines
+        expect command line arguments to be passed.  Since we don't know ahead of time how many individual items there are
+        in the query string, the for loop includes logic to grow the array size via wrealloc.
+     */
+    argpsize = 10;
+    argp = walloc(argpsize * sizeof(char *));
+    *argp = cgiPath;
+    n = 1;
+    query = 0;
+
+    if (strchr(wp->query, '=') == NULL) {
+        query = sclone(wp->query);
+        websDecodeUrl(query, query, strlen(query));
+        for (cp = stok(query, " ", &tok); cp != NULL; ) {
+            *(argp+n) = cp;
+            trace(5, "ARG[%d] %s", n, argp[n-1]);
+            n++;
+            if (n >= argpsize) {
+                argpsize *= 2;
+                argp = wrealloc(argp, argpsize * sizeof(char *));
+            }
+            cp = stok(NULL, " ", &tok);
+        }
+    }
+    *(argp+n) = NULL;
+
+    /*
+        Add all CGI variables to the environment strings to be passed to the spawned CGI process. This includes a few
+        we don't already have in the symbol table, plus all those that are in the vars symbol table. envp will point
+        to a walloc'd array of pointers. Each pointer will point to a walloc'd string containing the keyword value pair
+        in the form keyword=value. Since we don't know ahead of time how many environment strings there will be the for
+        loop includes logic to grow the array size via wrealloc.
+     */
+    envpsize = 64;
+    envp = walloc(envpsize * sizeof(char*));
+    for (n = 0, s = hashFirst(wp->vars); s != NULL; s = hashNext(wp->vars, s)) {
+        if (isCgiVar(s)) {
+            envp[n++] = sfmt("%s=%s", s->name.value.string, s->content.value.string);
+            trace(5, "Env[%d] %s", n, envp[n-1]);
+            if (n >= envpsize) {
+                envpsize *= 2;
+                envp = wrealloc(envp, envpsize * sizeof(char *));
+            }
+        }
+    }
+    *(envp+n) = NULL;
+
+#if ME_UNIX_LIKE
+    /*
+        Now launch the process with pipes for its stdin and stdout. If not successful, do the cleanup of resources.
+        If successful, the cleanup will be done after the process completes and its output is consumed.
+     */
+    if ((pHandle = launchCgi(cgiPath, argp, envp, &fdin, &fdout)) == -1) {
+#else
+    /*
+        Create temporary file name(s) for the child's stdin and stdout. For POST data the stdin temp file (and name)
+        should already exist.  
+     */
+    if (wp->cgiStdin == NULL) {
+        wp->cgiStdin = websGetCgiCommName();
+    } 
+    stdIn = wp->cgiStdin;
+    stdOut = websGetCgiCommName();
+    /*
+        Now launch the process.  If not successful, do the cleanup of resources.  If successful, the cleanup will be
+        done after the process completes.  
+     */
+    if ((pHandle = launchCgi(cgiPath, argp, envp, stdIn, stdOut)) == -1) {
+        wfree(stdOut);
+#endif
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "failed to spawn CGI task");
+        for (ep = envp; *ep != NULL; ep++) {
+            wfree(*ep);
+        }
+        wfree(cgiPath);
+        wfree(argp);
+        wfree(envp);
+        wfree(query);
+
+    } else {
+        /*
+            If the spawn was successful, put this wp on a queue to be checked for completion.
+         */
+        cid = wallocObject(&cgiList, &cgiMax, sizeof(Cgi));
+        cgip = cgiList[cid];
+        cgip->handle = pHandle;
+        cgip->cgiPath = cgiPath;
+        cgip->argp = argp;
+        cgip->envp = envp;
+        cgip->wp = wp;
+        wfree(query);
+#if ME_UNIX_LIKE
+        cgip->headers = walloc(ME_GOAHEAD_LIMIT_HEADERS + 1);
+        cgip->inSid = socketAttach(fdin);
+        cgip->outSid = socketAttach(fdout);
+        socketCreateHandler(cgip->outSid, SOCKET_READABLE, outputEvent, cgip);
+        writeInput(cgip);
+#else
+        cgip->stdIn = stdIn;
+        cgip->stdOut = stdOut;
+        cgip->fplacemark = 0;
+#endif
+    }
+    /*
+        Restore the current working directory after spawning child CGI
+     */
+    chdir(cwd);
+    return 1;
+}
+
+
+/*
+    Map the request to a program in the CGI directory and define the script variables. The program name follows the
+    first '/' in the path. Returns an allocated program path, or null if an error response has been written.
+ */
+static char *mapCgiProgram(Webs *wp, char *dir)
+{
+    char    cgiPrefix[ME_GOAHEAD_LIMIT_FILENAME];
+    char    *cp, *cgiName, *cgiPath, *extraPath;
+
     /*
         Extract the form name and then build the full path name.  The form name will follow the first '/' in path.
      */
     scopy(cgiPrefix, sizeof(cgiPrefix), wp->path);
     if ((cgiName = strchr(&cgiPrefix[1], '/')) == NULL) {
         websError(wp, HTTP_CODE_NOT_FOUND, "Missing CGI name");
-        return 1;
+        return 0;
     }
     *cgiName++ = '\0';
 
-    getcwd(cwd, ME_GOAHEAD_LIMIT_FILENAME);
-    dir = wp->route->dir ? wp->route->dir : cwd;
-    chdir(dir);
-    
     extraPath = 0;
     if ((cp = strchr(cgiName, '/')) != NULL) {
         extraPath = sclone(cp);
@@ -93,7 +356,7 @@ static bool cgiHandler(Webs *wp)
             error("Cannot find CGI program: ", cgiPath);
             websError(wp, HTTP_CODE_NOT_FOUND | WEBS_NOLOG, "CGI program file does not exist");
             wfree(cgiPath);
-            return 1;
+            return 0;
         }
 #if ME_WIN_LIKE
         if (strstr(cgiPath, ".exe") == NULL && strstr(cgiPath, ".bat") == NULL)
@@ -103,212 +366,1301 @@ static bool cgiHandler(Webs *wp)
         {
             websError(wp, HTTP_CODE_NOT_FOUND, "CGI process file is not executable");
             wfree(cgiPath);
-            return 1;
+            return 0;
+        }
+    }
+#endif /* ! VXWORKS */
+    return cgiPath;
+}
+
+
+/*
+    Test if a request variable is passed to CGI programs
+ */
+static bool isCgiVar(WebsKey *s)
+{
+    return s->content.valid && s->content.type == string &&
+        strcmp(s->name.value.string, "REMOTE_HOST") != 0 &&
+        strcmp(s->name.value.string, "HTTP_AUTHORIZATION") != 0;
+}
+
+
+PUBLIC int websCgiOpen()
+{
+#if ME_UNIX_LIKE
+    struct sigaction    act;
+    int                 sid;
+
+    /*
+        Child exits are signalled via a pipe that is serviced by the event loop
+     */
+    if (cgiSignalPipe[1] >= 0) {
+        close(cgiSignalPipe[1]);
+    }
+    if (pipe(cgiSignalPipe) < 0) {
+        error("Cannot create CGI signal pipe, errno %d", errno);
+        return -1;
+    }
+    fcntl(cgiSignalPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(cgiSignalPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(cgiSignalPipe[1], F_SETFL, fcntl(cgiSignalPipe[1], F_GETFL) | O_NONBLOCK);
+    if ((sid = socketAttach(cgiSignalPipe[0])) < 0) {
+        return -1;
+    }
+    socketCreateHandler(sid, SOCKET_READABLE, childEvent, 0);
+
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = childSignal;
+    act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&act.sa_mask);
+    sigaction(SIGCHLD, &act, 0);
+#endif
+    websDefineHandler("cgi", 0, cgiHandler, 0, 0);
+#if WEBS_FASTCGI
+    if (fcgiPools < 0) {
+        fcgiPools = hashCreate(-1);
+    }
+    websDefineHandler("fastcgi", 0, fastCgiHandler, closeFastCgi, 0);
+#endif
+    return 0;
+}
+
+
+PUBLIC int websProcessCgiData(Webs *wp)
+{
+    ssize   nbytes;
+
+    nbytes = bufLen(&wp->input);
+    trace(5, "cgi: write %d bytes to CGI program", nbytes);
+    if (write(wp->cgifd, wp->input.servp, (int) nbytes) != nbytes) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR| WEBS_CLOSE, "Cannot write to CGI gateway");
+        return -1;
+    }
+    websConsumeInput(wp, nbytes);
+    trace(5, "cgi: write %d bytes to CGI program", nbytes);
+    return 0;
+}
+
+
+static void writeCgiHeaders(Webs *wp, int status, ssize contentLength, char *location, char *contentType)
+{
+    trace(5, "cgi: Start response headers");
+    websSetStatus(wp, status);
+    websWriteHeaders(wp, contentLength, location);
+    websWriteHeader(wp, "Pragma", "no-cache");
+    websWriteHeader(wp, "Cache-Control", "no-cache");
+    if (contentType) {
+        websWriteHeader(wp, "Content-Type", contentType);
+    }
+}
+
+
+static ssize parseCgiHeaders(Webs *wp, char *buf)
+{
+    char    *end, *cp, *key, *value, *location, *contentType;
+    ssize   len, contentLength;
+    int     status, doneHeaders;
+
+    status = HTTP_CODE_OK;
+    contentLength = -1;
+    contentType = 0;
+    location = 0;
+    doneHeaders = 0;
+
+    /*
+        Look for end of headers
+     */
+    if ((end = strstr(buf, "\r\n\r\n")) == NULL) {
+        if ((end = strstr(buf, "\n\n")) == NULL) {
+            return 0;
+        }
+        len = 2;
+    } else {
+        len = 4;
+    }
+    for (cp = buf; cp < end && *cp != ':'; cp++) {}
+    if (cp >= end) {
+        /* No headers found. Leave the output unmodified so it can be written as the response body. */
+        return 0;
+    }
+    end[len - 1] = '\0';
+    end += len;
+    cp = buf;
+    if (strncmp(cp, "HTTP/1.", 7) == 0) {
+        ssplit(cp, "\r\n", &cp);
+    }
+    for (; cp && *cp && (*cp != '\r' && *cp != '\n') && cp < end; ) {
+        key = slower(ssplit(cp, ":", &value));
+        /*
+            Terminate the value before it is used and advance to the next header
+         */
+        stok(value, "\r\n", &cp);
+        value = strim(value, " \t", WEBS_TRIM_BOTH);
+        if (strcmp(key, "location") == 0) {
+            location = value;
+        } else if (strcmp(key, "status") == 0) {
+            status = atoi(value);
+        } else if (strcmp(key, "content-type") == 0) {
+            contentType = value;
+        } else if (strcmp(key, "content-length") == 0) {
+            contentLength = atoi(value);
+        } else {
+            /*
+                Now pass all other headers back to the client
+             */
+            if (!doneHeaders) {
+                writeCgiHeaders(wp, status, contentLength, location, contentType);
+                doneHeaders = 1;
+            }
+            if (key && value && !strspn(key, "%<>/\\")) {
+                websWriteHeader(wp, key, "%s", value);
+            } else {
+                trace(5, "cgi: bad response http header: \"%s\": \"%s\"", key, value);
+            }
+        }
+    }
+    if (!doneHeaders) {
+        writeCgiHeaders(wp, status, contentLength, location, contentType);
+     }
+    websWriteEndHeaders(wp);
+    return end - buf;
+}
+
+
+#if ME_UNIX_LIKE
+/*
+    Write the request body to the CGI program. The body is bounded by ME_GOAHEAD_LIMIT_POST and is retained in
+    wp->input. The pipe is closed once the body is written so the program sees end of file.
+ */
+static void writeInput(Cgi *cgip)
+{
+    Webs    *wp;
+    ssize   nbytes;
+
+    wp = cgip->wp;
+    if (bufLen(&wp->input) > 0) {
+        if ((nbytes = socketWrite(cgip->inSid, wp->input.servp, bufLen(&wp->input))) < 0) {
+            trace(5, "cgi: CGI program is not reading its input");
+            bufFlush(&wp->input);
+        } else {
+            trace(5, "cgi: write %d bytes to CGI program", nbytes);
+            websConsumeInput(wp, nbytes);
+        }
+    }
+    if (bufLen(&wp->input) > 0) {
+        socketCreateHandler(cgip->inSid, SOCKET_WRITABLE, inputEvent, cgip);
+    } else {
+        socketFree(cgip->inSid);
+        cgip->inSid = -1;
+    }
+}
+
+
+static void inputEvent(int sid, int mask, void *data)
+{
+    writeInput((Cgi*) data);
+}
+
+
+static void outputEvent(int sid, int mask, void *data)
+{
+    gatherOutput((Cgi*) data);
+}
+
+
+/*
+    Read output from the CGI program and write it to the client. If the CGI program writes partial headers, the 
+    output is buffered until the headers are complete or more than ME_GOAHEAD_LIMIT_HEADERS of data is received.
+    Reading stops while the client is not keeping up and resumes once the response has drained.
+ */
+static void gatherOutput(Cgi *cgip)
+{
+    Webs    *wp;
+    char    buf[ME_GOAHEAD_LIMIT_BUFFER];
+    ssize   nbytes, skip;
+
+    if ((wp = cgip->wp) == 0) {
+        /* Request abandoned by websCgiAbort */
+        return;
+    }
+    /*
+        Output from the program counts as request activity so a long running program is not timed out
+     */
+    websNoteRequestActivity(wp);
+    while (!websWouldBlock(wp)) {
+        if (!(wp->flags & WEBS_HEADERS_CREATED)) {
+            nbytes = socketRead(cgip->outSid, &cgip->headers[cgip->hlen], ME_GOAHEAD_LIMIT_HEADERS - cgip->hlen);
+            if (nbytes <= 0) {
+                break;
+            }
+            cgip->hlen += nbytes;
+            cgip->headers[cgip->hlen] = '\0';
+            if ((skip = parseCgiHeaders(wp, cgip->headers)) == 0) {
+                if (cgip->hlen < ME_GOAHEAD_LIMIT_HEADERS) {
+                    trace(5, "cgi: waiting for http headers");
+                    continue;
+                }
+                trace(5, "cgi: missing http headers - create default headers");
+                writeCgiHeaders(wp, HTTP_CODE_OK, -1, 0, 0);
+                websWriteEndHeaders(wp);
+            }
+            trace(5, "cgi: write %d bytes to client", cgip->hlen - skip);
+            websWriteBlock(wp, &cgip->headers[skip], cgip->hlen - skip);
+
+        } else {
+            if ((nbytes = socketRead(cgip->outSid, buf, sizeof(buf))) <= 0) {
+                break;
+            }
+            trace(5, "cgi: write %d bytes to client", nbytes);
+            websWriteBlock(wp, buf, nbytes);
+        }
+    }
+    if (socketEof(cgip->outSid)) {
+        socketFree(cgip->outSid);
+        cgip->outSid = -1;
+        if (cgip->handle && checkCgi(cgip->handle) == 0) {
+            cgip->handle = 0;
+        }
+        if (cgip->handle == 0) {
+            finishCgi(cgip);
+        }
+    } else if (wp->txq && websFlush(wp, 0) == 0 && websWouldBlock(wp)) {
+        /*
+            Output is flushed as it is produced. If the client is not keeping up, writable events drain the response
+            and then call resumeOutput.
+         */
+        socketRegisterInterest(cgip->outSid, 0);
+        wp->writeData = resumeOutput;
+    }
+}
+
+
+/*
+    Background writer called when the response has drained. Resume reading output from the CGI program.
+ */
+static void resumeOutput(Webs *wp)
+{
+    WebsSocket  *sp;
+    Cgi         *cgip;
+    int         cid;
+
+    wp->writeData = 0;
+    if (wp->sid >= 0) {
+        sp = socketPtr(wp->sid);
+        socketRegisterInterest(wp->sid, sp->handlerMask & ~SOCKET_WRITABLE);
+    }
+    for (cid = 0; cid < cgiMax; cid++) {
+        if ((cgip = cgiList[cid]) != NULL && cgip->wp == wp && cgip->outSid >= 0) {
+            socketRegisterInterest(cgip->outSid, SOCKET_READABLE);
+        }
+    }
+}
+
+
+/*
+    Signal handler for SIGCHLD. Wake the event loop to reap the CGI program.
+ */
+static void childSignal(int signo)
+{
+    ssize   rc;
+    int     saveErrno;
+
+    saveErrno = errno;
+    rc = write(cgiSignalPipe[1], "c", 1);
+    rc = rc;
+    errno = saveErrno;
+}
+
+
+/*
+    A child process has exited. Complete the requests for CGI programs that have exited and whose output is consumed.
+    Replace FastCGI workers that have exited.
+ */
+static void childEvent(int sid, int mask, void *data)
+{
+    Cgi     *cgip;
+    char    buf[16];
+    int     cid;
+
+    while (socketRead(sid, buf, sizeof(buf)) > 0) {}
+
+    for (cid = 0; cid < cgiMax; cid++) {
+        if ((cgip = cgiList[cid]) != NULL && cgip->handle && checkCgi(cgip->handle) == 0) {
+            cgip->handle = 0;
+            if (cgip->outSid < 0) {
+                finishCgi(cgip);
+            }
+        }
+    }
+#if WEBS_FASTCGI
+    reapWorkers();
+#endif
+}
+
+
+/*
+    Complete the response once all the program output has been read. If the program did not write any headers,
+    the buffered output is written with default headers.
+ */
+static void endCgiOutput(Webs *wp, char *headers, ssize hlen)
+{
+    if (!(wp->flags & WEBS_HEADERS_CREATED) && hlen == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "CGI generated no output");
+    } else {
+        if (!(wp->flags & WEBS_HEADERS_CREATED)) {
+            trace(5, "cgi: missing http headers - create default headers");
+            writeCgiHeaders(wp, HTTP_CODE_OK, -1, 0, 0);
+            websWriteEndHeaders(wp);
+            websWriteBlock(wp, headers, hlen);
+        }
+        trace(5, "cgi: Request complete - calling websDone");
+        websDone(wp);
+    }
+}
+
+
+/*
+    The CGI program has exited and all its output has been read. Complete the request and clean up.
+    If the request was abandoned by websCgiAbort, only the CGI record is freed.
+ */
+static void finishCgi(Cgi *cgip)
+{
+    Webs    *wp;
+    char    **ep;
+    int     cid;
+
+    wp = cgip->wp;
+    /*
+        Remove the record before completing the request so websCgiAbort does not find it
+     */
+    for (cid = 0; cid < cgiMax; cid++) {
+        if (cgiList[cid] == cgip) {
+            cgiMax = wfreeHandle(&cgiList, cid);
+            break;
+        }
+    }
+    if (cgip->inSid >= 0) {
+        socketFree(cgip->inSid);
+        cgip->inSid = -1;
+    }
+    if (wp) {
+        endCgiOutput(wp, cgip->headers, cgip->hlen);
+    }
+    for (ep = cgip->envp; ep != NULL && *ep != NULL; ep++) {
+        wfree(*ep);
+    }
+    wfree(cgip->cgiPath);
+    wfree(cgip->argp);
+    wfree(cgip->envp);
+    wfree(cgip->headers);
+    wfree(cgip);
+    if (wp == 0) {
+        return;
+    }
+    websPump(wp);
+    if (wp->state == WEBS_RUNNING) {
+        /*
+            The response is still draining. The connection is closed once it is written.
+         */
+        wp->flags &= ~WEBS_KEEP_ALIVE;
+    } else {
+        websFree(wp);
+        /* wp no longer valid */
+    }
+}
+
+
+/*
+    Abandon the CGI program for a request that is being terminated. The pipes are closed and the program is killed.
+    The CGI record is freed when the SIGCHLD handler reaps the program.
+ */
+PUBLIC void websCgiAbort(Webs *wp)
+{
+    Cgi     *cgip;
+    int     cid;
+
+    for (cid = 0; cid < cgiMax; cid++) {
+        if ((cgip = cgiList[cid]) != NULL && cgip->wp == wp) {
+            trace(5, "cgi: abort CGI program %d", cgip->handle);
+            cgip->wp = 0;
+            if (cgip->inSid >= 0) {
+                socketFree(cgip->inSid);
+                cgip->inSid = -1;
+            }
+            if (cgip->outSid >= 0) {
+                socketFree(cgip->outSid);
+                cgip->outSid = -1;
+            }
+            if (cgip->handle) {
+                kill(cgip->handle, SIGKILL);
+            } else {
+                finishCgi(cgip);
+            }
+            break;
+        }
+    }
+}
+
+
+/*
+    CGI output is serviced by the event loop so there is nothing to poll
+ */
+WebsTime websCgiPoll()
+{
+    return MAXINT;
+}
+
+#if WEBS_FASTCGI
+/*
+    FastCGI handler. Programs are run as a pool of long-lived worker processes that share a listening Unix domain
+    socket passed as their stdin. Requests are sent to the workers over persistent connections and the output is 
+    parsed like CGI output. If the program reports FCGI_MPXS_CONNS, each connection carries several requests.
+ */
+static bool fastCgiHandler(Webs *wp)
+{
+    FcgiPool    *pool;
+    FcgiConn    *conn;
+    FcgiRequest *req;
+    char        cwd[ME_GOAHEAD_LIMIT_FILENAME];
+    char        *program, *dir;
+
+    assert(websValid(wp));
+
+    websSetEnv(wp);
+    if ((dir = wp->route->dir) == 0) {
+        getcwd(cwd, ME_GOAHEAD_LIMIT_FILENAME);
+        dir = cwd;
+    }
+    if ((program = mapCgiProgram(wp, dir)) == 0) {
+        return 1;
+    }
+    pool = getPool(program);
+    wfree(program);
+    if (pool == 0) {
+        websError(wp, HTTP_CODE_SERVICE_UNAVAILABLE, "Cannot start FastCGI program");
+        return 1;
+    }
+    if ((req = walloc(sizeof(FcgiRequest))) == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot allocate FastCGI request");
+        return 1;
+    }
+    memset(req, 0, sizeof(FcgiRequest));
+    req->wp = wp;
+    req->pool = pool;
+    req->headers = walloc(ME_GOAHEAD_LIMIT_HEADERS + 1);
+
+    if (!pool->first && (conn = getConn(pool)) != 0) {
+        wp->fastcgi = req;
+        startRequest(conn, req);
+
+    } else if (pool->connCount == 0) {
+        websError(wp, HTTP_CODE_SERVICE_UNAVAILABLE, "Cannot connect to FastCGI program");
+        wfree(req->headers);
+        wfree(req);
+
+    } else {
+        /*
+            All connections are busy. The request is started when a connection completes a request.
+         */
+        wp->fastcgi = req;
+        if (pool->last) {
+            pool->last->next = req;
+        } else {
+            pool->first = req;
+        }
+        pool->last = req;
+    }
+    return 1;
+}
+
+
+/*
+    Get the pool for a program. The pool and its workers are created on first use.
+ */
+static FcgiPool *getPool(char *program)
+{
+    FcgiPool            *pool;
+    WebsKey             *key;
+    struct sockaddr_un  addr;
+    char                *prefix;
+
+    if ((key = hashLookup(fcgiPools, program)) != 0) {
+        return key->content.value.symbol;
+    }
+    if ((pool = walloc(sizeof(FcgiPool))) == 0) {
+        return 0;
+    }
+    memset(pool, 0, sizeof(FcgiPool));
+    pool->program = sclone(program);
+    pool->maxRequests = 1;
+    pool->respawn = -1;
+    prefix = sfmt("fcgi-%d", getpid());
+    pool->path = websTempFile(NULL, prefix);
+    wfree(prefix);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    scopy(addr.sun_path, sizeof(addr.sun_path), pool->path);
+    unlink(pool->path);
+    if ((pool->listenFd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+            bind(pool->listenFd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(pool->listenFd, SOMAXCONN) < 0) {
+        error("Cannot listen for FastCGI program %s at %s, errno %d", program, pool->path, errno);
+        if (pool->listenFd >= 0) {
+            close(pool->listenFd);
+        }
+        unlink(pool->path);
+        wfree(pool->program);
+        wfree(pool->path);
+        wfree(pool);
+        return 0;
+    }
+    fcntl(pool->listenFd, F_SETFD, FD_CLOEXEC);
+    hashEnter(fcgiPools, pool->program, valueSymbol(pool), 0);
+    startWorkers(pool);
+    return pool;
+}
+
+
+/*
+    Start workers for the empty slots in the pool. Workers that exited within a second of starting are restarted 
+    after a delay so a failing program does not continually respawn.
+ */
+static void startWorkers(FcgiPool *pool)
+{
+    FcgiWorker  *worker;
+    WebsTime    now;
+    int         i, delay;
+
+    now = time(0);
+    for (i = 0, delay = 0; i < ME_GOAHEAD_FASTCGI_WORKERS; i++) {
+        worker = &pool->workers[i];
+        if (worker->pid > 0) {
+            continue;
+        }
+        if ((worker->started && (now - worker->started) < 1) || spawnWorker(pool, i) < 0) {
+            delay = 1;
+        }
+    }
+    if (delay && pool->respawn < 0) {
+        pool->respawn = websStartEvent(1000, respawnEvent, pool);
+    }
+}
+
+
+static void respawnEvent(void *data, int id)
+{
+    FcgiPool    *pool;
+
+    pool = data;
+    websStopEvent(id);
+    pool->respawn = -1;
+    startWorkers(pool);
+}
+
+
+/*
+    Start a worker process. The worker accepts connections on the listening socket passed as its stdin.
+ */
+static int spawnWorker(FcgiPool *pool, int index)
+{
+    char    *argv[2];
+    int     pid, fd, fdmax;
+
+    argv[0] = pool->program;
+    argv[1] = 0;
+    pool->workers[index].started = time(0);
+    if ((pid = fork()) < 0) {
+        error("Cannot fork FastCGI program %s, errno %d", pool->program, errno);
+        return -1;
+    }
+    if (pid == 0) {
+        /*
+            Child. Close the server descriptors other than stdout and stderr.
+         */
+        dup2(pool->listenFd, FCGI_LISTENSOCK_FILENO);
+        fdmax = (int) min(sysconf(_SC_OPEN_MAX), 65536);
+        for (fd = 3; fd < fdmax; fd++) {
+            close(fd);
+        }
+        execv(pool->program, argv);
+        _exit(1);
+    }
+    trace(2, "fastcgi: started %s, pid %d", pool->program, pid);
+    pool->workers[index].pid = pid;
+    return 0;
+}
+
+
+/*
+    Reap workers that have exited and start replacements. Called when a child process exits.
+ */
+static void reapWorkers()
+{
+    FcgiPool    *pool;
+    WebsKey     *key;
+    int         i, pid, status, exited;
+
+    if (fcgiPools < 0) {
+        return;
+    }
+    for (key = hashFirst(fcgiPools); key; key = hashNext(fcgiPools, key)) {
+        pool = key->content.value.symbol;
+        for (i = 0, exited = 0; i < ME_GOAHEAD_FASTCGI_WORKERS; i++) {
+            if ((pid = pool->workers[i].pid) > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+                error("FastCGI program %s exited, pid %d, status %d", pool->program, pid, status);
+                pool->workers[i].pid = 0;
+                exited = 1;
+            }
+        }
+        if (exited) {
+            startWorkers(pool);
+        }
+    }
+}
+
+
+/*
+    Get a connection that can accept another request. Opens a new connection if all are busy and there are fewer 
+    connections than workers. Returns null if the request must wait.
+ */
+static FcgiConn *getConn(FcgiPool *pool)
+{
+    FcgiConn    *conn;
+    int         i;
+
+    for (i = 0; i < ME_GOAHEAD_FASTCGI_WORKERS; i++) {
+        if ((conn = pool->conns[i]) != 0 && !conn->failed && conn->active < pool->maxRequests) {
+            return conn;
+        }
+    }
+    for (i = 0; i < ME_GOAHEAD_FASTCGI_WORKERS; i++) {
+        if (pool->conns[i] == 0) {
+            return openConn(pool, i);
+        }
+    }
+    return 0;
+}
+
+
+static FcgiConn *openConn(FcgiPool *pool, int index)
+{
+    FcgiConn            *conn;
+    struct sockaddr_un  addr;
+    char                values[40];
+    int                 fd, sid;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    scopy(addr.sun_path, sizeof(addr.sun_path), pool->path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        return 0;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || (sid = socketAttach(fd)) < 0) {
+        error("Cannot connect to FastCGI program %s, errno %d", pool->program, errno);
+        close(fd);
+        return 0;
+    }
+    if ((conn = walloc(sizeof(FcgiConn))) == 0) {
+        socketFree(sid);
+        return 0;
+    }
+    memset(conn, 0, sizeof(FcgiConn));
+    conn->pool = pool;
+    conn->index = index;
+    conn->sid = sid;
+    bufCreate(&conn->rx, ME_GOAHEAD_LIMIT_BUFFER, MAXINT);
+    bufCreate(&conn->tx, ME_GOAHEAD_LIMIT_BUFFER, MAXINT);
+    pool->conns[index] = conn;
+    pool->connCount++;
+    socketCreateHandler(sid, SOCKET_READABLE, connEvent, conn);
+
+    if (!pool->probed) {
+        /*
+            Ask if the program can multiplex requests. Until it replies, connections carry one request at a time.
+         */
+        pool->probed = 1;
+        values[0] = 15;
+        values[1] = 0;
+        memcpy(&values[2], "FCGI_MPXS_CONNS", 15);
+        values[17] = 13;
+        values[18] = 0;
+        memcpy(&values[19], "FCGI_MAX_REQS", 13);
+        putRecord(conn, FCGI_GET_VALUES, 0, values, 32);
+    }
+    return conn;
+}
+
+
+static void freeConn(FcgiConn *conn)
+{
+    FcgiPool    *pool;
+
+    pool = conn->pool;
+    pool->conns[conn->index] = 0;
+    pool->connCount--;
+    socketFree(conn->sid);
+    bufFree(&conn->rx);
+    bufFree(&conn->tx);
+    wfree(conn);
+}
+
+
+/*
+    The connection to the program has failed. Fail its requests and start waiting requests on a new connection.
+ */
+static void failConn(FcgiConn *conn)
+{
+    FcgiPool    *pool;
+    FcgiRequest *req;
+    int         id;
+
+    pool = conn->pool;
+    for (id = 1; id <= FCGI_MAX_REQUESTS; id++) {
+        if ((req = conn->reqs[id]) != 0) {
+            conn->reqs[id] = 0;
+            completeRequest(req, "FastCGI program closed the connection");
+        }
+    }
+    freeConn(conn);
+    dispatchRequests(pool);
+}
+
+
+/*
+    Start waiting requests on connections that can accept them
+ */
+static void dispatchRequests(FcgiPool *pool)
+{
+    FcgiConn    *conn;
+    FcgiRequest *req;
+
+    while ((req = pool->first) != 0) {
+        if ((conn = getConn(pool)) == 0 && pool->connCount > 0) {
+            break;
+        }
+        if ((pool->first = req->next) == 0) {
+            pool->last = 0;
+        }
+        req->next = 0;
+        if (conn) {
+            startRequest(conn, req);
+        } else {
+            completeRequest(req, "Cannot connect to FastCGI program");
+        }
+    }
+}
+
+
+/*
+    Send the request parameters and body to the program
+ */
+static void startRequest(FcgiConn *conn, FcgiRequest *req)
+{
+    Webs    *wp;
+    char    body[8];
+    ssize   len;
+    int     id;
+
+    wp = req->wp;
+    for (id = 1; conn->reqs[id]; id++) {}
+    req->id = id;
+    req->conn = conn;
+    conn->reqs[id] = req;
+    conn->active++;
+
+    memset(body, 0, sizeof(body));
+    body[1] = FCGI_RESPONDER;
+    body[2] = FCGI_KEEP_CONN;
+    putRecord(conn, FCGI_BEGIN_REQUEST, id, body, sizeof(body));
+    putParams(conn, req);
+    while ((len = min(bufGetBlkMax(&wp->input), FCGI_MAX_RECORD)) > 0) {
+        putRecord(conn, FCGI_STDIN, id, wp->input.servp, len);
+        websConsumeInput(wp, len);
+    }
+    putRecord(conn, FCGI_STDIN, id, 0, 0);
+    trace(5, "fastcgi: start request %d for %s", id, conn->pool->program);
+    flushConn(conn);
+}
+
+
+/*
+    Encode the CGI variables as FastCGI name-value pairs
+ */
+static void putParams(FcgiConn *conn, FcgiRequest *req)
+{
+    WebsBuf     buf;
+    WebsKey     *s;
+    ssize       len, lens[2];
+    char        *name, *value;
+    int         i;
+
+    bufCreate(&buf, ME_GOAHEAD_LIMIT_BUFFER, MAXINT);
+    for (s = hashFirst(req->wp->vars); s != NULL; s = hashNext(req->wp->vars, s)) {
+        if (!isCgiVar(s)) {
+            continue;
+        }
+        name = s->name.value.string;
+        value = s->content.value.string;
+        lens[0] = slen(name);
+        lens[1] = slen(value);
+        for (i = 0; i < 2; i++) {
+            if (lens[i] < 128) {
+                bufPutc(&buf, (char) lens[i]);
+            } else {
+                bufPutc(&buf, (char) (((lens[i] >> 24) & 0x7f) | 0x80));
+                bufPutc(&buf, (char) (lens[i] >> 16));
+                bufPutc(&buf, (char) (lens[i] >> 8));
+                bufPutc(&buf, (char) lens[i]);
+            }
+        }
+        bufPutBlk(&buf, name, lens[0]);
+        bufPutBlk(&buf, value, lens[1]);
+    }
+    while ((len = min(bufLen(&buf), FCGI_MAX_RECORD)) > 0) {
+        putRecord(conn, FCGI_PARAMS, req->id, buf.servp, len);
+        bufAdjustStart(&buf, len);
+    }
+    putRecord(conn, FCGI_PARAMS, req->id, 0, 0);
+    bufFree(&buf);
+}
+
+
+static void putRecord(FcgiConn *conn, int type, int id, char *data, ssize len)
+{
+    char    header[FCGI_HEADER_LEN];
+
+    header[0] = FCGI_VERSION;
+    header[1] = (char) type;
+    header[2] = (char) (id >> 8);
+    header[3] = (char) id;
+    header[4] = (char) (len >> 8);
+    header[5] = (char) len;
+    header[6] = 0;
+    header[7] = 0;
+    bufPutBlk(&conn->tx, header, sizeof(header));
+    if (len > 0) {
+        bufPutBlk(&conn->tx, data, len);
+    }
+}
+
+
+/*
+    Write buffered records to the program. A failed connection is serviced via the event loop so the caller's
+    requests are not completed beneath it.
+ */
+static int flushConn(FcgiConn *conn)
+{
+    ssize   len, written;
+    int     mask;
+
+    while ((len = bufGetBlkMax(&conn->tx)) > 0) {
+        if ((written = socketWrite(conn->sid, conn->tx.servp, len)) < 0) {
+            conn->failed = 1;
+            socketRegisterInterest(conn->sid, SOCKET_READABLE);
+            socketReservice(conn->sid);
+            return -1;
+        }
+        if (written == 0) {
+            break;
+        }
+        bufAdjustStart(&conn->tx, written);
+    }
+    bufReset(&conn->tx);
+    mask = conn->blocked ? 0 : SOCKET_READABLE;
+    if (bufLen(&conn->tx) > 0) {
+        mask |= SOCKET_WRITABLE;
+    }
+    socketRegisterInterest(conn->sid, mask);
+    return 0;
+}
+
+
+static void connEvent(int sid, int mask, void *data)
+{
+    FcgiConn    *conn;
+
+    conn = data;
+    if (conn->failed || ((mask & SOCKET_WRITABLE) && flushConn(conn) < 0)) {
+        failConn(conn);
+        return;
+    }
+    if (mask & SOCKET_READABLE) {
+        readConn(conn);
+    }
+}
+
+
+/*
+    Read and process records from the program. Reading pauses while a client is not keeping up with its response.
+ */
+static void readConn(FcgiConn *conn)
+{
+    FcgiRequest *req;
+    ssize       nbytes;
+    int         id;
+
+    while (1) {
+        if (processRecords(conn) < 0) {
+            failConn(conn);
+            return;
+        }
+        if (conn->blocked) {
+            break;
+        }
+        bufCompact(&conn->rx);
+        if (bufRoom(&conn->rx) < ME_GOAHEAD_LIMIT_BUFFER && !bufGrow(&conn->rx, ME_GOAHEAD_LIMIT_BUFFER)) {
+            failConn(conn);
+            return;
+        }
+        if ((nbytes = socketRead(conn->sid, conn->rx.endp, bufRoom(&conn->rx))) < 0) {
+            failConn(conn);
+            return;
+        } else if (nbytes == 0) {
+            break;
         }
+        bufAdjustEnd(&conn->rx, nbytes);
     }
-#endif /* ! VXWORKS */
     /*
-        Build command line arguments.  Only used if there is no non-encoded = character.  This is indicative of a ISINDEX
-        query.  POST separators are & and others are +.  argp will point to a walloc'd array of pointers.  Each pointer
-        will point to substring within the query string.  This array of string pointers is how the spawn or exec routines
-        expect command line arguments to be passed.  Since we don't know ahead of time how many individual items there are
-        in the query string, the for loop includes logic to grow the array size via wrealloc.
+        Output is flushed as it is produced so responses stream to the clients
      */
-    argpsize = 10;
-    argp = walloc(argpsize * sizeof(char *));
-    *argp = cgiPath;
-    n = 1;
-    query = 0;
+    for (id = 1; id <= FCGI_MAX_REQUESTS; id++) {
+        if ((req = conn->reqs[id]) != 0 && req->wp && req->wp->txq) {
+            websFlush(req->wp, 0);
+        }
+    }
+}
 
-    if (strchr(wp->query, '=') == NULL) {
-        query = sclone(wp->query);
-        websDecodeUrl(query, query, strlen(query));
-        for (cp = stok(query, " ", &tok); cp != NULL; ) {
-            *(argp+n) = cp;
-            trace(5, "ARG[%d] %s", n, argp[n-1]);
-            n++;
-            if (n >= argpsize) {
-                argpsize *= 2;
-                argp = wrealloc(argp, argpsize * sizeof(char *));
+
+/*
+    Process complete records in the receive buffer. Returns -1 for protocol errors.
+ */
+static int processRecords(FcgiConn *conn)
+{
+    FcgiRequest *req;
+    Webs        *wp;
+    uchar       *hp;
+    char        msg[ME_GOAHEAD_LIMIT_STRING], *data;
+    ssize       len, size;
+    int         type, id;
+
+    while (!conn->blocked && bufLen(&conn->rx) >= FCGI_HEADER_LEN) {
+        hp = (uchar*) conn->rx.servp;
+        if (hp[0] != FCGI_VERSION) {
+            error("Bad FastCGI record from %s", conn->pool->program);
+            return -1;
+        }
+        len = hp[4] << 8 | hp[5];
+        size = FCGI_HEADER_LEN + len + hp[6];
+        if (bufLen(&conn->rx) < size) {
+            break;
+        }
+        type = hp[1];
+        id = hp[2] << 8 | hp[3];
+        data = (char*) &hp[FCGI_HEADER_LEN];
+        req = (id > 0 && id <= FCGI_MAX_REQUESTS) ? conn->reqs[id] : 0;
+        bufAdjustStart(&conn->rx, size);
+
+        switch (type) {
+        case FCGI_STDOUT:
+            if (req && (wp = req->wp) != 0 && len > 0) {
+                writeCgiOutput(wp, req->headers, &req->hlen, data, len);
+                if (websWouldBlock(wp) && websFlush(wp, 0) == 0 && websWouldBlock(wp)) {
+                    /*
+                        Stop reading from the program until the response drains and resumeFastCgi is called
+                     */
+                    conn->blocked = wp;
+                    wp->writeData = resumeFastCgi;
+                    socketRegisterInterest(conn->sid, bufLen(&conn->tx) > 0 ? SOCKET_WRITABLE : 0);
+                }
             }
-            cp = stok(NULL, " ", &tok);
+            break;
+
+        case FCGI_STDERR:
+            if (len > 0) {
+                len = min(len, (ssize) sizeof(msg) - 1);
+                memcpy(msg, data, len);
+                msg[len] = '\0';
+                error("%s: %s", conn->pool->program, strim(msg, "\r\n", WEBS_TRIM_END));
+            }
+            break;
+
+        case FCGI_END_REQUEST:
+            if (req) {
+                endRequest(conn, req);
+            }
+            break;
+
+        case FCGI_GET_VALUES_RESULT:
+            setValues(conn->pool, (uchar*) data, len);
+            dispatchRequests(conn->pool);
+            break;
+
+        default:
+            trace(5, "fastcgi: ignore record type %d", type);
+            break;
         }
     }
-    *(argp+n) = NULL;
+    return 0;
+}
 
-    /*
-        Add all CGI variables to the environment strings to be passed to the spawned CGI process. This includes a few
-        we don't already have in the symbol table, plus all those that are in the vars symbol table. envp will point
-        to a walloc'd array of pointers. Each pointer will point to a walloc'd string containing the keyword value pair
-        in the form keyword=value. Since we don't know ahead of time how many environment strings there will be the for
-        loop includes logic to grow the array size via wrealloc.
-     */
-    envpsize = 64;
-    envp = walloc(envpsize * sizeof(char*));
-    for (n = 0, s = hashFirst(wp->vars); s != NULL; s = hashNext(wp->vars, s)) {
-        if (s->content.valid && s->content.type == string &&
-            strcmp(s->name.value.string, "REMOTE_HOST") != 0 &&
-            strcmp(s->name.value.string, "HTTP_AUTHORIZATION") != 0) {
-            envp[n++] = sfmt("%s=%s", s->name.value.string, s->content.value.string);
-            trace(5, "Env[%d] %s", n, envp[n-1]);
-            if (n >= envpsize) {
-                envpsize *= 2;
-                envp = wrealloc(envp, envpsize * sizeof(char *));
+
+/*
+    Parse the FCGI_GET_VALUES reply to determine if the program can multiplex requests over a connection
+ */
+static void setValues(FcgiPool *pool, uchar *data, ssize len)
+{
+    uchar   *cp, *end;
+    char    value[16];
+    ssize   lens[2], vlen;
+    int     i, multiplex, maxRequests;
+
+    multiplex = 0;
+    maxRequests = FCGI_MAX_REQUESTS;
+    for (cp = data, end = data + len; cp < end; cp += lens[0] + lens[1]) {
+        for (i = 0; i < 2; i++) {
+            if (cp < end && !(*cp & 0x80)) {
+                lens[i] = *cp++;
+            } else if (end - cp >= 4) {
+                lens[i] = (cp[0] & 0x7f) << 24 | cp[1] << 16 | cp[2] << 8 | cp[3];
+                cp += 4;
+            } else {
+                return;
             }
         }
+        if (lens[0] + lens[1] > end - cp) {
+            return;
+        }
+        vlen = min(lens[1], (ssize) sizeof(value) - 1);
+        memcpy(value, &cp[lens[0]], vlen);
+        value[vlen] = '\0';
+        if (lens[0] == 15 && strncmp((char*) cp, "FCGI_MPXS_CONNS", 15) == 0) {
+            multiplex = atoi(value);
+        } else if (lens[0] == 13 && strncmp((char*) cp, "FCGI_MAX_REQS", 13) == 0 && atoi(value) > 0) {
+            maxRequests = min(atoi(value), FCGI_MAX_REQUESTS);
+        }
     }
-    *(envp+n) = NULL;
+    pool->maxRequests = multiplex ? maxRequests : 1;
+    trace(2, "fastcgi: %s accepts %d requests per connection", pool->program, pool->maxRequests);
+}
 
-    /*
-        Create temporary file name(s) for the child's stdin and stdout. For POST data the stdin temp file (and name)
-        should already exist.  
-     */
-    if (wp->cgiStdin == NULL) {
-        wp->cgiStdin = websGetCgiCommName();
-    } 
-    stdIn = wp->cgiStdin;
-    stdOut = websGetCgiCommName();
-    /*
-        Now launch the process.  If not successful, do the cleanup of resources.  If successful, the cleanup will be
-        done after the process completes.  
-     */
-    if ((pHandle = launchCgi(cgiPath, argp, envp, stdIn, stdOut)) == -1) {
-        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "failed to spawn CGI task");
-        for (ep = envp; *ep != NULL; ep++) {
-            wfree(*ep);
-        }
-        wfree(cgiPath);
-        wfree(argp);
-        wfree(envp);
-        wfree(stdOut);
-        wfree(query);
 
-    } else {
-        /*
-            If the spawn was successful, put this wp on a queue to be checked for completion.
-         */
-        cid = wallocObject(&cgiList, &cgiMax, sizeof(Cgi));
-        cgip = cgiList[cid];
-        cgip->handle = pHandle;
-        cgip->stdIn = stdIn;
-        cgip->stdOut = stdOut;
-        cgip->cgiPath = cgiPath;
-        cgip->argp = argp;
-        cgip->envp = envp;
-        cgip->wp = wp;
-        cgip->fplacemark = 0;
-        wfree(query);
+/*
+    Write program output to the client. If the program writes partial headers, the output is buffered until the 
+    headers are complete or more than ME_GOAHEAD_LIMIT_HEADERS of data is received.
+ */
+static void writeCgiOutput(Webs *wp, char *headers, ssize *hlen, char *buf, ssize len)
+{
+    ssize   count, skip;
+
+    while (!(wp->flags & WEBS_HEADERS_CREATED) && len > 0) {
+        count = min(len, ME_GOAHEAD_LIMIT_HEADERS - *hlen);
+        memcpy(&headers[*hlen], buf, count);
+        *hlen += count;
+        headers[*hlen] = '\0';
+        buf += count;
+        len -= count;
+        if ((skip = parseCgiHeaders(wp, headers)) == 0) {
+            if (*hlen < ME_GOAHEAD_LIMIT_HEADERS) {
+                trace(5, "cgi: waiting for http headers");
+                return;
+            }
+            trace(5, "cgi: missing http headers - create default headers");
+            writeCgiHeaders(wp, HTTP_CODE_OK, -1, 0, 0);
+            websWriteEndHeaders(wp);
+        }
+        websWriteBlock(wp, &headers[skip], *hlen - skip);
+    }
+    if (len > 0) {
+        websWriteBlock(wp, buf, len);
     }
-    /*
-        Restore the current working directory after spawning child CGI
-     */
-    chdir(cwd);
-    return 1;
 }
 
 
-PUBLIC int websCgiOpen()
+/*
+    The program has completed a request. The request ID can then be reused.
+ */
+static void endRequest(FcgiConn *conn, FcgiRequest *req)
 {
-    websDefineHandler("cgi", 0, cgiHandler, 0, 0);
-    return 0;
+    conn->reqs[req->id] = 0;
+    conn->active--;
+    trace(5, "fastcgi: end request %d for %s", req->id, conn->pool->program);
+    completeRequest(req, 0);
+    dispatchRequests(conn->pool);
 }
 
 
-PUBLIC int websProcessCgiData(Webs *wp)
+/*
+    Detach a request from its client connection
+ */
+static void detachRequest(FcgiRequest *req)
 {
-    ssize   nbytes;
+    Webs    *wp;
 
-    nbytes = bufLen(&wp->input);
-    trace(5, "cgi: write %d bytes to CGI program", nbytes);
-    if (write(wp->cgifd, wp->input.servp, (int) nbytes) != nbytes) {
-        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR| WEBS_CLOSE, "Cannot write to CGI gateway");
-        return -1;
+    if ((wp = req->wp) != 0) {
+        wp->fastcgi = 0;
+        if (wp->writeData == resumeFastCgi) {
+            wp->writeData = 0;
+        }
+        if (req->conn && req->conn->blocked == wp) {
+            req->conn->blocked = 0;
+        }
+        req->wp = 0;
     }
-    websConsumeInput(wp, nbytes);
-    trace(5, "cgi: write %d bytes to CGI program", nbytes);
-    return 0;
 }
 
 
-static void writeCgiHeaders(Webs *wp, int status, ssize contentLength, char *location, char *contentType)
+/*
+    Complete the response and free the request. If msg is set, the request failed.
+ */
+static void completeRequest(FcgiRequest *req, char *msg)
 {
-    trace(5, "cgi: Start response headers");
-    websSetStatus(wp, status);
-    websWriteHeaders(wp, contentLength, location);
-    websWriteHeader(wp, "Pragma", "no-cache");
-    websWriteHeader(wp, "Cache-Control", "no-cache");
-    if (contentType) {
-        websWriteHeader(wp, "Content-Type", contentType);
+    Webs    *wp;
+
+    wp = req->wp;
+    detachRequest(req);
+    if (wp == 0) {
+        /* Abandoned by the client */
+    } else if (msg == 0) {
+        endCgiOutput(wp, req->headers, req->hlen);
+    } else if (!(wp->flags & WEBS_HEADERS_CREATED)) {
+        websError(wp, HTTP_CODE_BAD_GATEWAY, "%s", msg);
+    } else {
+        /*
+            The response is incomplete. Close the connection so the client does not treat it as complete.
+         */
+        error("%s", msg);
+        wp->flags &= ~WEBS_KEEP_ALIVE;
+        websDone(wp);
+    }
+    wfree(req->headers);
+    wfree(req);
+    if (wp) {
+        websPump(wp);
+        if (wp->flags & WEBS_CLOSED) {
+            websFree(wp);
+        }
     }
 }
 
 
-static ssize parseCgiHeaders(Webs *wp, char *buf)
+/*
+    Background writer called when the response has drained. Resume reading from the program.
+ */
+static void resumeFastCgi(Webs *wp)
 {
-    char    *end, *cp, *key, *value, *location, *contentType;
-    ssize   len, contentLength;
-    int     status, doneHeaders;
+    WebsSocket  *sp;
+    FcgiRequest *req;
+    FcgiConn    *conn;
+
+    wp->writeData = 0;
+    if (wp->sid >= 0) {
+        sp = socketPtr(wp->sid);
+        socketRegisterInterest(wp->sid, sp->handlerMask & ~SOCKET_WRITABLE);
+    }
+    if ((req = wp->fastcgi) != 0 && (conn = req->conn) != 0 && conn->blocked == wp) {
+        conn->blocked = 0;
+        if (flushConn(conn) == 0) {
+            /* Process records already buffered */
+            socketReservice(conn->sid);
+        }
+    }
+}
 
-    status = HTTP_CODE_OK;
-    contentLength = -1;
-    contentType = 0;
-    location = 0;
-    doneHeaders = 0;
 
-    /*
-        Look for end of headers
-     */
-    if ((end = strstr(buf, "\r\n\r\n")) == NULL) {
-        if ((end = strstr(buf, "\n\n")) == NULL) {
-            return 0;
+/*
+    Abandon the FastCGI request for a connection that is being closed
+ */
+PUBLIC void websFastCgiAbort(Webs *wp)
+{
+    FcgiRequest *req, *prior, *next;
+    FcgiPool    *pool;
+    FcgiConn    *conn;
+
+    if ((req = wp->fastcgi) == 0) {
+        return;
+    }
+    conn = req->conn;
+    detachRequest(req);
+    if (conn) {
+        /*
+            Output for the request is discarded until the program ends the request
+         */
+        putRecord(conn, FCGI_ABORT_REQUEST, req->id, 0, 0);
+        if (flushConn(conn) == 0) {
+            socketReservice(conn->sid);
         }
-        len = 2;
     } else {
-        len = 4;
-    }
-    end[len - 1] = '\0';
-    end += len;
-    cp = buf;
-    if (!strchr(cp, ':')) {
-        /* No headers found */
-        return 0;
+        pool = req->pool;
+        for (prior = 0, next = pool->first; next && next != req; prior = next, next = next->next) {}
+        if (next) {
+            if (prior) {
+                prior->next = req->next;
+            } else {
+                pool->first = req->next;
+            }
+            if (pool->last == req) {
+                pool->last = prior;
+            }
+        }
+        wfree(req->headers);
+        wfree(req);
     }
-    if (strncmp(cp, "HTTP/1.", 7) == 0) {
-        ssplit(cp, "\r\n", &cp);
+}
+
+
+/*
+    Stop the workers and free the pools. Called when the handler is closed.
+ */
+static void closeFastCgi()
+{
+    FcgiPool    *pool;
+    FcgiConn    *conn;
+    FcgiRequest *req, *next;
+    WebsKey     *key;
+    int         i, id;
+
+    if (fcgiPools < 0) {
+        return;
     }
-    for (; cp && *cp && (*cp != '\r' && *cp != '\n') && cp < end; ) {
-        key = slower(ssplit(cp, ":", &value));
-        if (strcmp(key, "location") == 0) {
-            location = value;
-        } else if (strcmp(key, "status") == 0) {
-            status = atoi(value);
-        } else if (strcmp(key, "content-type") == 0) {
-            contentType = value;
-        } else if (strcmp(key, "content-length") == 0) {
-            contentLength = atoi(value);
-        } else {
-            /*
-                Now pass all other headers back to the client
-             */
-            if (!doneHeaders) {
-                writeCgiHeaders(wp, status, contentLength, location, contentType);
-                doneHeaders = 1;
+    for (key = hashFirst(fcgiPools); key; key = hashNext(fcgiPools, key)) {
+        pool = key->content.value.symbol;
+        for (req = pool->first; req; req = next) {
+            next = req->next;
+            detachRequest(req);
+            wfree(req->headers);
+            wfree(req);
+        }
+        for (i = 0; i < ME_GOAHEAD_FASTCGI_WORKERS; i++) {
+            if ((conn = pool->conns[i]) != 0) {
+                for (id = 1; id <= FCGI_MAX_REQUESTS; id++) {
+                    if ((req = conn->reqs[id]) != 0) {
+                        detachRequest(req);
+                        wfree(req->headers);
+                        wfree(req);
+                    }
+                }
+                freeConn(conn);
             }
-            if (key && value && !strspn(key, "%<>/\\")) {
-                websWriteHeader(wp, key, "%s", value);
-            } else {
-                trace(5, "cgi: bad response http header: \"%s\": \"%s\"", key, value);
+            if (pool->workers[i].pid > 0) {
+                kill(pool->workers[i].pid, SIGTERM);
             }
         }
-        stok(value, "\r\n", &cp);
+        if (pool->respawn >= 0) {
+            websStopEvent(pool->respawn);
+        }
+        close(pool->listenFd);
+        unlink(pool->path);
+        wfree(pool->program);
+        wfree(pool->path);
+        wfree(pool);
     }
-    if (!doneHeaders) {
-        writeCgiHeaders(wp, status, contentLength, location, contentType);
-     }
-    websWriteEndHeaders(wp);
-    return end - buf;
+    hashFree(fcgiPools);
+    fcgiPools = -1;
 }
+#endif /* WEBS_FASTCGI */
 
+#else /* !ME_UNIX_LIKE */
 
 PUBLIC void websCgiGatherOutput(Cgi *cgip)
 {
@@ -331,7 +1683,11 @@ PUBLIC void websCgiGatherOutput(Cgi *cgip)
              */
             wp = cgip->wp;
             lseek(fdout, cgip->fplacemark, SEEK_SET);
-            while ((nbytes = read(fdout, buf, sizeof(buf))) > 0) {
+            /*
+                While the CGI program is running, stop gathering output if the client is not keeping up
+             */
+            while (!(cgip->handle && websWouldBlock(wp)) && (nbytes = read(fdout, buf, sizeof(buf))) > 0) {
+                skip = 0;
                 if (!(wp->flags & WEBS_HEADERS_CREATED)) {
                     if ((skip = parseCgiHeaders(wp, buf)) == 0) {
                         if (cgip->handle && sbuf.st_size < ME_GOAHEAD_LIMIT_HEADERS) {
@@ -416,13 +1772,21 @@ WebsTime websCgiPoll()
                 wfree(cgip->stdOut);
                 wfree(cgip);
                 websPump(wp);
-                websFree(wp);
-                /* wp no longer valid */
+                if (wp->state == WEBS_RUNNING) {
+                    /*
+                        The response is still draining. The connection is closed once it is written.
+                     */
+                    wp->flags &= ~WEBS_KEEP_ALIVE;
+                } else {
+                    websFree(wp);
+                    /* wp no longer valid */
+                }
             }
         }
     }
     return cgiMax ? 10 : MAXINT;
 }
+#endif /* ME_UNIX_LIKE */
 
 
 /*
@@ -505,20 +1869,31 @@ static int checkCgi(int handle)
 #endif /* WINCE */
 
 
-#if ME_UNIX_LIKE || QNX
+#if ME_UNIX_LIKE
 /*
-    Launch the CGI process and return a handle to it.
+    Launch the CGI process and return a handle to it. The parent ends of the pipes for the process stdin and stdout 
+    are returned via fdin and fdout.
  */
-static int launchCgi(char *cgiPath, char **argp, char **envp, char *stdIn, char *stdOut)
+static int launchCgi(char *cgiPath, char **argp, char **envp, int *fdin, int *fdout)
 {
-    int pid, fdin, fdout, hstdin, hstdout;
+    char    *msg;
+    int     pid, hstdin, hstdout, inPipe[2], outPipe[2], i;
 
     trace(5, "cgi: run %s", cgiPath);
-    pid = fdin = fdout = hstdin = hstdout = -1;
-    if ((fdin = open(stdIn, O_RDWR | O_CREAT | O_BINARY, 0666)) < 0 ||
-            (fdout = open(stdOut, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666)) < 0 ||
-            (hstdin = dup(0)) == -1 || (hstdout = dup(1)) == -1 ||
-            dup2(fdin, 0) == -1 || dup2(fdout, 1) == -1) {
+    pid = hstdin = hstdout = -1;
+    inPipe[0] = inPipe[1] = outPipe[0] = outPipe[1] = -1;
+    if (pipe(inPipe) < 0 || pipe(outPipe) < 0) {
+        goto done;
+    }
+    /*
+        Only the duplicates on stdin and stdout are inherited by the CGI process
+     */
+    for (i = 0; i < 2; i++) {
+        fcntl(inPipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(outPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    if ((hstdin = dup(0)) == -1 || (hstdout = dup(1)) == -1 ||
+            dup2(inPipe[0], 0) == -1 || dup2(outPipe[1], 1) == -1) {
         goto done;
     }
 
@@ -528,7 +1903,8 @@ static int launchCgi(char *cgiPath, char **argp, char **envp, char *stdIn, char
             if pid == 0, then we are in the child process
          */
         if (execve(cgiPath, argp, envp) == -1) {
-            printf("content-type: text/html\n\nExecution of cgi process failed\n");
+            msg = "content-type: text/html\n\nExecution of cgi process failed\n";
+            if (write(1, msg, strlen(msg)) < 0) {}
         }
         _exit(0);
     }
@@ -541,11 +1917,22 @@ done:
         dup2(hstdin, 0);
         close(hstdin);
     }
-    if (fdout >= 0) {
-        close(fdout);
+    if (inPipe[0] >= 0) {
+        close(inPipe[0]);
     }
-    if (fdin >= 0) {
-        close(fdin);
+    if (outPipe[1] >= 0) {
+        close(outPipe[1]);
+    }
+    if (pid > 0) {
+        *fdin = inPipe[1];
+        *fdout = outPipe[0];
+    } else {
+        if (inPipe[1] >= 0) {
+            close(inPipe[1]);
+        }
+        if (outPipe[0] >= 0) {
+            close(outPipe[0]);
+        }
     }
     return pid;
 }
@@ -569,7 +1956,7 @@ static int checkCgi(int handle)
     }
 }
 
-#endif /* LINUX || LYNX || MACOSX || QNX4 */
+#endif /* ME_UNIX_LIKE */
 
 
 #if VXWORKS
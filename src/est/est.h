@@ -40,6 +40,9 @@
 #ifndef ME_EST_AES
     #define ME_EST_AES 1
 #endif
+#ifndef ME_EST_AESNI
+    #define ME_EST_AESNI 1
+#endif
 #ifndef ME_EST_BIGNUM
     #define ME_EST_BIGNUM 1
 #endif
@@ -49,15 +52,24 @@
 #ifndef ME_EST_CAMELLIA
     #define ME_EST_CAMELLIA 0
 #endif
+#ifndef ME_EST_CTR_DRBG
+    #define ME_EST_CTR_DRBG 1
+#endif
 #ifndef ME_EST_DES
     #define ME_EST_DES 0
 #endif
 #ifndef ME_EST_DHM
     #define ME_EST_DHM 1
 #endif
+#ifndef ME_EST_ECP
+    #define ME_EST_ECP 1
+#endif
 #ifndef ME_EST_GEN_PRIME
     #define ME_EST_GEN_PRIME 1
 #endif
+#ifndef ME_EST_GCM
+    #define ME_EST_GCM 1
+#endif
 #ifndef ME_EST_HAVEGE
     #define ME_EST_HAVEGE 1
 #endif
@@ -226,9 +238,13 @@
     #if defined(_MSC_VER) && defined(_M_IX86)
         typedef unsigned __int64 t_dbl;
     #else
-        #if defined(__amd64__) || defined(__x86_64__) || defined(__ppc64__) || defined(__powerpc64__) || defined(__mips64) || \
-                defined(__ia64__)  || defined(__alpha__)
+        #if defined(__SIZEOF_INT128__)
+            typedef unsigned __int128 t_dbl;
+            #define EST_HAVE_INT128 1
+        #elif defined(__amd64__) || defined(__x86_64__) || defined(__ppc64__) || defined(__powerpc64__) || \
+                defined(__mips64) || defined(__ia64__)  || defined(__alpha__)
             typedef uint t_dbl __attribute__ ((mode(TI)));
+            #define EST_HAVE_INT128 1
         #else
             typedef unsigned long long t_dbl;
             #define ME_USE_LONG_LONG 1
@@ -474,6 +490,14 @@ extern "C" {
      */
     PUBLIC int mpi_exp_mod(mpi *X, mpi *A, mpi *E, mpi *N, mpi *_RR);
 
+    /**
+       @brief          Fixed-window exponentiation for secret exponents: X = A^E mod N
+       @return         0 if successful, 1 if memory allocation failed, EST_ERR_MPI_BAD_INPUT_DATA if N is negative or even
+       @note           Every window costs the same squarings and one multiplication, and the precomputed powers are read
+                       in constant time. Used for the RSA private key CRT exponents. _RR is used as for mpi_exp_mod.
+     */
+    PUBLIC int mpi_exp_mod_fixed(mpi *X, mpi *A, mpi *E, mpi *N, mpi *_RR);
+
     /**
        @brief          Greatest common divisor: G = gcd(A, B)
        @return         0 if successful, 1 if memory allocation failed
@@ -786,6 +810,154 @@ extern "C" {
 
 
 
+/********* Start of file src/ecp.h ************/
+
+
+/*
+    ecp.h -- Elliptic curve key exchange and signatures (ECDH, ECDSA)
+
+    Supports NIST P-256 (secp256r1) for ECDH and ECDSA, and Curve25519 (X25519) for ECDH.
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+ */
+#ifndef EST_ECP_H
+#define EST_ECP_H
+
+#define EST_ERR_ECP_BAD_INPUT_DATA                    -0x04E0
+#define EST_ERR_ECP_INVALID_KEY                       -0x04F0
+#define EST_ERR_ECP_VERIFY_FAILED                     -0x0500
+
+/*
+    Curve identifiers. These are the TLS NamedCurve values (RFC 4492, RFC 7748).
+ */
+#define ECP_GROUP_NONE          0
+#define ECP_GROUP_SECP256R1     23
+#define ECP_GROUP_X25519        29
+
+#define ECP_MAX_POINT_LEN       65      /**< Uncompressed P-256 point: 04 | X | Y */
+#define ECDSA_MAX_SIG_LEN       72      /**< DER encoded P-256 signature */
+
+/**
+   @brief          Elliptic curve key pair
+ */
+typedef struct {
+    int group;                      /**<  ECP_GROUP_XXX, or ECP_GROUP_NONE if unset */
+    int qlen;                       /**<  length of Q in bytes */
+    uchar Q[ECP_MAX_POINT_LEN];     /**<  public key. Uncompressed point for P-256, u-coordinate for X25519 */
+    uchar d[32];                    /**<  private key. Big-endian for P-256, little-endian for X25519 */
+} ecp_keypair;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+       @brief          Generate a key pair
+       @param key      key pair to initialize
+       @param group    ECP_GROUP_SECP256R1 or ECP_GROUP_X25519
+       @param f_rng    RNG function
+       @param p_rng    RNG parameter
+       @return         0 if successful, or an EST_ERR_ECP_XXX error code
+     */
+    PUBLIC int ecp_gen_keypair(ecp_keypair *key, int group, int (*f_rng) (void *), void *p_rng);
+
+    /**
+       @brief          Set the private key and derive the public key
+       @param key      key pair to initialize
+       @param group    ECP_GROUP_SECP256R1 or ECP_GROUP_X25519
+       @param d        private key
+       @param dlen     size of the private key. At most 32 bytes.
+       @return         0 if successful, or an EST_ERR_ECP_XXX error code
+     */
+    PUBLIC int ecp_set_privkey(ecp_keypair *key, int group, uchar *d, int dlen);
+
+    /**
+       @brief          Check that a public key is a valid point on the curve
+       @param group    ECP_GROUP_SECP256R1 or ECP_GROUP_X25519
+       @param point    public key
+       @param plen     size of the public key
+       @return         0 if successful, or EST_ERR_ECP_INVALID_KEY
+     */
+    PUBLIC int ecp_check_pubkey(int group, uchar *point, int plen);
+
+    /**
+       @brief          Derive the ECDH shared secret from the peer public key
+       @param key      own key pair
+       @param peer     peer public key in the same format as key->Q
+       @param plen     size of the peer public key
+       @param output   destination buffer. Must hold 32 bytes.
+       @param olen     number of chars written
+       @note           The secret is the x-coordinate of the shared point for P-256 and the u-coordinate for
+                       X25519, as used for the TLS premaster secret.
+       @return         0 if successful, or an EST_ERR_ECP_XXX error code
+     */
+    PUBLIC int ecp_calc_secret(ecp_keypair *key, uchar *peer, int plen, uchar *output, int *olen);
+
+    /**
+       @brief          Create an ECDSA signature (P-256 only)
+       @param key      own key pair
+       @param hash     message hash
+       @param hlen     size of the hash
+       @param sig      destination buffer for the DER encoded signature. Must hold ECDSA_MAX_SIG_LEN bytes.
+       @param slen     number of chars written
+       @param f_rng    RNG function
+       @param p_rng    RNG parameter
+       @return         0 if successful, or an EST_ERR_ECP_XXX error code
+     */
+    PUBLIC int ecdsa_sign(ecp_keypair *key, uchar *hash, int hlen, uchar *sig, int *slen,
+        int (*f_rng) (void *), void *p_rng);
+
+    /**
+       @brief          Verify an ECDSA signature (P-256 only)
+       @param key      public key. Only key->group and key->Q are used.
+       @param hash     message hash
+       @param hlen     size of the hash
+       @param sig      DER encoded signature
+       @param slen     size of the signature
+       @return         0 if successful, or EST_ERR_ECP_VERIFY_FAILED
+     */
+    PUBLIC int ecdsa_verify(ecp_keypair *key, uchar *hash, int hlen, uchar *sig, int slen);
+
+    /**
+       @brief          Clear a key pair
+     */
+    PUBLIC void ecp_free(ecp_keypair *key);
+
+#if ME_EST_SELF_TEST
+    /**
+       @brief          Checkup routine. Runs the RFC 7748 and RFC 6979 test vectors.
+       @return         0 if successful, or 1 if the test failed
+     */
+    PUBLIC int ecp_self_test(int verbose);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif              /* ecp.h */
+
+/*
+    @copy   default
+
+    Copyright (c) Embedthis Software. All Rights Reserved.
+
+    This software is distributed under commercial and open source licenses.
+    You may use the Embedthis Open Source license or you may acquire a 
+    commercial license from Embedthis Software. You agree to be fully bound
+    by the terms of either license. Consult the LICENSE.md distributed with
+    this software for full details and other copyrights.
+
+    Local variables:
+    tab-width: 4
+    c-basic-offset: 4
+    End:
+    vim: sw=4 ts=4 expandtab
+
+    @end
+ */
+
+
+
 /********* Start of file src/rsa.h ************/
 
 
@@ -1392,6 +1564,17 @@ extern "C" {
 #define OID_PKCS1_RSA_SHA       "\x2A\x86\x48\x86\xF7\x0D\x01\x01\x05"
 #define OID_PKCS9               "\x2A\x86\x48\x86\xF7\x0D\x01\x09"
 #define OID_PKCS9_EMAIL         "\x2A\x86\x48\x86\xF7\x0D\x01\x09\x01"
+#define OID_EC_PUBLIC_KEY       "\x2A\x86\x48\xCE\x3D\x02\x01"
+#define OID_EC_SECP256R1        "\x2A\x86\x48\xCE\x3D\x03\x01\x07"
+#define OID_ECDSA_SHA1          "\x2A\x86\x48\xCE\x3D\x04\x01"
+#define OID_ECDSA_SHA256        "\x2A\x86\x48\xCE\x3D\x04\x03\x02"
+
+/*
+    Certificate signature algorithms. RSA signatures use the RSA_MD2 .. RSA_SHA256 hash identifiers.
+ */
+#define X509_SIG_ECDSA          0x100
+#define X509_SIG_ECDSA_SHA1     (X509_SIG_ECDSA | RSA_SHA1)
+#define X509_SIG_ECDSA_SHA256   (X509_SIG_ECDSA | RSA_SHA256)
 
 /*
    Structures for parsing X.509 certificates
@@ -1420,6 +1603,7 @@ typedef struct _x509_cert {
     int version;
     x509_buf serial;
     x509_buf sig_oid1;
+    int sig_alg;
 
     x509_buf issuer_raw;
     x509_buf subject_raw;
@@ -1432,6 +1616,9 @@ typedef struct _x509_cert {
 
     x509_buf pk_oid;
     rsa_context rsa;
+#if ME_EST_ECP
+    ecp_keypair ec;         /* EC public key. The group is zero for RSA keys */
+#endif
 
     x509_buf issuer_id;
     x509_buf subject_id;
@@ -1512,6 +1699,25 @@ extern "C" {
      */
     PUBLIC int x509parse_keyfile(rsa_context * rsa, char *path, char *password);
 
+#if ME_EST_ECP
+    /**
+       @brief          Parse an unencrypted SEC1 EC private key ("EC PRIVATE KEY") on the P-256 curve
+       @param key      EC key pair to be initialized
+       @param buf      input buffer in PEM or DER format
+       @param buflen   size of the buffer
+       @return         0 if successful, or a specific X509 error code
+     */
+    PUBLIC int x509parse_eckey(ecp_keypair *key, uchar *buf, int buflen);
+
+    /**
+       @brief          Load and parse an unencrypted SEC1 EC private key
+       @param key      EC key pair to be initialized
+       @param path     filename to read the private key from
+       @return         0 if successful, or a specific X509 error code
+     */
+    PUBLIC int x509parse_eckeyfile(ecp_keypair *key, char *path);
+#endif
+
     /**
        @brief          Store the certificate DN in printable form into buf;
                        no more than (bufsize) characters will be written.
@@ -1663,6 +1869,17 @@ typedef struct EstCipher {
 #define TLS_RSA_WITH_CAMELLIA_128_CBC_SHA       0x41
 #define TLS_RSA_WITH_CAMELLIA_256_CBC_SHA       0x84
 #define TLS_DHE_RSA_WITH_CAMELLIA_256_CBC_SHA   0x88
+#define TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA    0xC009
+#define TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA    0xC00A
+#define TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA      0xC013
+#define TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA      0xC014
+
+/*
+    ECDHE ciphersuites (RFC 4492) and those authenticated with an ECDSA certificate
+ */
+#define SSL_CIPHER_IS_ECDHE(c)  (((c) >> 8) == 0xC0)
+#define SSL_CIPHER_IS_ECDSA(c)  ((c) == TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA || \
+                                 (c) == TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA)
 
 /*
    Message, alert and handshake types
@@ -1680,6 +1897,7 @@ typedef struct EstCipher {
 #define SSL_HS_HELLO_REQUEST            0
 #define SSL_HS_CLIENT_HELLO             1
 #define SSL_HS_SERVER_HELLO             2
+#define SSL_HS_NEW_SESSION_TICKET       4
 #define SSL_HS_CERTIFICATE             11
 #define SSL_HS_SERVER_KEY_EXCHANGE     12
 #define SSL_HS_CERTIFICATE_REQUEST     13
@@ -1693,6 +1911,18 @@ typedef struct EstCipher {
  */
 #define TLS_EXT_SERVERNAME              0
 #define TLS_EXT_SERVERNAME_HOSTNAME     0
+#define TLS_EXT_SUPPORTED_GROUPS        10
+#define TLS_EXT_EC_POINT_FORMATS        11
+#define TLS_EXT_SESSION_TICKET          35
+
+#define TLS_EC_CURVE_TYPE_NAMED         3
+#define TLS_EC_POINT_UNCOMPRESSED       0
+
+/*
+    Curves offered by the client (ssl_context.curves)
+ */
+#define SSL_CURVE_SECP256R1             0x1
+#define SSL_CURVE_X25519                0x2
 
 /*
     SSL state machine
@@ -1731,6 +1961,24 @@ struct _ssl_session {
     ssl_session *next;  /**< next session entry */
 };
 
+/*
+    Session ticket keys (RFC 5077). Tickets are encrypted with AES-256-CBC and authenticated with HMAC-SHA256.
+ */
+#define SSL_TICKET_KEYS     2
+#define SSL_TICKET_STATE    64
+#define SSL_TICKET_LEN      (16 + 16 + SSL_TICKET_STATE + 32)
+
+typedef struct ssl_ticket_key {
+    uchar name[16];     /**< key name sent in the ticket  */
+    uchar aes[32];      /**< ticket encryption key        */
+    uchar mac[32];      /**< ticket HMAC key              */
+    time_t created;     /**< key creation time, 0 if unset */
+} ssl_ticket_key;
+
+typedef struct ssl_tickets {
+    ssl_ticket_key keys[SSL_TICKET_KEYS];   /**< keys[0] issues tickets, all keys are accepted */
+} ssl_tickets;
+
 struct _ssl_context {
     /*
         Miscellaneous
@@ -1796,6 +2044,10 @@ struct _ssl_context {
      */
     rsa_context *rsa_key;   /**< own RSA private key     */
     x509_cert *own_cert;    /**< own X.509 certificate   */
+#if ME_EST_ECP
+    ecp_keypair *ec_key;    /**< own ECDSA private key   */
+    x509_cert *ec_cert;     /**< own ECDSA certificate   */
+#endif
     x509_cert *ca_chain;    /**< own trusted CA chain    */
     x509_cert *peer_cert;   /**< peer X.509 cert chain   */
     char *peer_cn;          /**< expected peer CN        */
@@ -1809,6 +2061,11 @@ struct _ssl_context {
         Crypto layer
      */
     dhm_context dhm_ctx;    /**< DHM key exchange        */
+#if ME_EST_ECP
+    ecp_keypair ecdh;       /**< ECDHE key exchange      */
+    int curves;             /**< (server) SSL_CURVE_* offered by the client */
+    int ec_formats_ext;     /**< (server) client sent the point formats extension */
+#endif
     md5_context fin_md5;    /**< Finished MD5 checksum   */
     sha1_context fin_sha1;  /**< Finished SHA-1 checksum */
 
@@ -1837,6 +2094,13 @@ struct _ssl_context {
      */
     uchar *hostname;
     ulong hostname_len;
+
+    ssl_tickets *tickets;       /**< (server) ticket keys or NULL */
+    ssl_session ticket_session; /**< (server) session decoded from the client ticket */
+    int ticket_ext;             /**< (server) client sent the ticket extension */
+    int ticket_offered;         /**< (server) client presented a non-empty ticket */
+    int ticket_resume;          /**< (server) session resumed from the client ticket */
+    int new_ticket;             /**< (server) send a NewSessionTicket message */
 };
 
 #ifdef __cplusplus
@@ -1918,6 +2182,13 @@ extern "C" {
      */
     PUBLIC void ssl_set_session(ssl_context *ssl, int resume, int timeout, ssl_session *session);
 
+    /**
+       @brief          Enable session tickets (server-side only)
+       @param ssl      SSL context
+       @param tickets  ticket keys. The caller owns and rotates the keys.
+     */
+    PUBLIC void ssl_set_tickets(ssl_context *ssl, ssl_tickets *tickets);
+
     /**
        @brief          Set the list of allowed ciphersuites
        @param ssl      SSL context
@@ -1942,6 +2213,17 @@ extern "C" {
      */
     PUBLIC void ssl_set_own_cert(ssl_context *ssl, x509_cert *own_cert, rsa_context *rsa_key);
 
+#if ME_EST_ECP
+    /**
+       @brief          Set own ECDSA certificate and private key for the ECDHE_ECDSA ciphersuites (server-side only).
+                       This may be used together with or instead of an RSA certificate.
+       @param ssl      SSL context
+       @param ec_cert  own public certificate with a P-256 key
+       @param ec_key   own private P-256 key
+     */
+    PUBLIC void ssl_set_own_ec_cert(ssl_context *ssl, x509_cert *ec_cert, ecp_keypair *ec_key);
+#endif
+
     /**
        @brief          Set the Diffie-Hellman public P and G values, read as hexadecimal strings (server-side only)
        @param ssl      SSL context
@@ -2092,8 +2374,8 @@ extern "C" {
  */
 typedef struct {
     int     nr;         /**< number of rounds */
-    ulong   *rk;        /**< AES round keys */
-    ulong   buf[68];    /**<  unaligned data */
+    uint    *rk;        /**< AES round keys */
+    uint    buf[68];    /**<  unaligned data */
 } aes_context;
 
 #ifdef __cplusplus
@@ -2149,9 +2431,9 @@ extern "C" {
     PUBLIC void aes_crypt_cfb128(aes_context *ctx, int mode, int length, int *iv_off, uchar iv[16], 
             uchar *input, uchar *output);
 
-#if UNUSED
+#if ME_EST_SELF_TEST
     /**
-       @brief          Checkup routine
+       @brief          Checkup routine. Runs the FIPS-197 and SP 800-38A known answer tests.
        @return         0 if successful, or 1 if the test failed
      */
     PUBLIC int aes_self_test(int verbose);
@@ -2184,6 +2466,116 @@ extern "C" {
 
 
 
+/********* Start of file src/aesni.h ************/
+
+
+/*
+    aesni.h -- AES-NI and PCLMULQDQ support for x86 and x64 CPUs
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+ */
+#ifndef EST_AESNI_H
+#define EST_AESNI_H
+
+#if ME_EST_AESNI && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#ifndef EST_HAVE_AESNI
+#define EST_HAVE_AESNI
+#endif
+
+#define AESNI_AES       0x02000000      /**< CPUID.1:ECX AES instructions */
+#define AESNI_CLMUL     0x00000002      /**< CPUID.1:ECX PCLMULQDQ instruction */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+       @brief          AES-NI detection routine. The CPU is queried once.
+       @param what     AESNI_AES or AESNI_CLMUL
+       @return         Non-zero if the CPU supports the feature and it is enabled
+     */
+    PUBLIC int aesni_supports(int what);
+
+    /**
+       @brief          Enable or disable the AES-NI code. The portable code is used when disabled.
+       @param enable   Set to 0 to disable
+     */
+    PUBLIC void aesni_enable(int enable);
+
+    /**
+       @brief          AES-NI AES-ECB block encryption/decryption
+       @param ctx      AES context
+       @param mode     AES_ENCRYPT or AES_DECRYPT
+       @param input    16-byte input block
+       @param output   16-byte output block
+     */
+    PUBLIC void aesni_crypt_ecb(aes_context *ctx, int mode, uchar input[16], uchar output[16]);
+
+    /**
+       @brief          AES-NI AES-CBC buffer encryption/decryption
+       @param ctx      AES context
+       @param mode     AES_ENCRYPT or AES_DECRYPT
+       @param length   length of the input data
+       @param iv       initialization vector (updated after use)
+       @param input    buffer holding the input data
+       @param output   buffer holding the output data
+     */
+    PUBLIC void aesni_crypt_cbc(aes_context *ctx, int mode, int length, uchar iv[16], uchar *input, uchar *output);
+
+    /**
+       @brief          AES-NI counter mode encryption of whole blocks. The low 32 bits of the counter are incremented.
+       @param ctx      AES context with an encryption key
+       @param blocks   number of 16-byte blocks
+       @param counter  counter block (updated after use)
+       @param input    buffer holding the input data
+       @param output   buffer holding the output data
+     */
+    PUBLIC void aesni_crypt_ctr32(aes_context *ctx, int blocks, uchar counter[16], uchar *input, uchar *output);
+
+    /**
+       @brief          PCLMULQDQ GHASH multiplication: x = x * h in GF(2^128)
+       @param x        16-byte block (updated)
+       @param h        16-byte hash key
+     */
+    PUBLIC void aesni_gcm_mult(uchar x[16], uchar h[16]);
+
+#if ME_EST_SELF_TEST
+    /**
+       @brief          Checkup routine. Runs the AES and GCM known answer tests with and without AES-NI.
+                       If verbose, also reports AES-CBC and AES-GCM throughput for each.
+       @return         0 if successful, or 1 if the test failed
+     */
+    PUBLIC int aesni_self_test(int verbose);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif              /* EST_HAVE_AESNI */
+#endif              /* aesni.h */
+
+/*
+    @copy   default
+
+    Copyright (c) Embedthis Software. All Rights Reserved.
+
+    This software is distributed under commercial and open source licenses.
+    You may use the Embedthis Open Source license or you may acquire a 
+    commercial license from Embedthis Software. You agree to be fully bound
+    by the terms of either license. Consult the LICENSE.md distributed with
+    this software for full details and other copyrights.
+
+    Local variables:
+    tab-width: 4
+    c-basic-offset: 4
+    End:
+    vim: sw=4 ts=4 expandtab
+
+    @end
+ */
+
+
+
 /********* Start of file src/arc4.h ************/
 
 
@@ -2970,7 +3362,7 @@ extern "C" {
 #endif /* EST_HAVE_ASM */
 
 #if !defined(MULADDC_CORE)
-#if ME_USE_LONG_LONG
+#if ME_USE_LONG_LONG || EST_HAVE_INT128
 
 #define MULADDC_INIT                    \
 {                                       \
@@ -3183,6 +3575,97 @@ extern "C" {
 #endif              /* certs.h */
 
 
+/********* Start of file src/ctr_drbg.h ************/
+
+
+/*
+    ctr_drbg.h -- CTR_DRBG Random Support (NIST SP 800-90A, AES-256, no derivation function)
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+ */
+#ifndef EST_CTR_DRBG_H
+#define EST_CTR_DRBG_H
+
+#define CTR_DRBG_KEYLEN             32      /**< AES-256 key length */
+#define CTR_DRBG_BLOCKLEN           16      /**< AES block length */
+#define CTR_DRBG_SEEDLEN            (CTR_DRBG_KEYLEN + CTR_DRBG_BLOCKLEN)
+#define CTR_DRBG_BUFLEN             64      /**< Output buffered for ctr_drbg_rand */
+#define CTR_DRBG_RESEED_INTERVAL    10000   /**< Generate requests between reseeds */
+#define CTR_DRBG_MAX_REQUEST        1024    /**< Maximum bytes per generate request */
+
+#define EST_ERR_CTR_DRBG_ENTROPY    -0x0030 /**< The entropy source failed */
+#define EST_ERR_CTR_DRBG_REQUEST    -0x0032 /**< The request is too large */
+
+/**
+   @brief          CTR_DRBG state structure
+ */
+typedef struct {
+    aes_context aes;                        /**< AES context for the current key */
+    uchar v[CTR_DRBG_BLOCKLEN];             /**< Counter block */
+    uchar buf[CTR_DRBG_BUFLEN];             /**< Buffered output for ctr_drbg_rand */
+    int avail;                              /**< Bytes remaining in buf */
+    int reseed_counter;                     /**< Generate requests since the last reseed */
+    int reseed_interval;                    /**< Generate requests between reseeds */
+    int (*f_entropy)(void *, uchar *, int); /**< Entropy source */
+    void *p_entropy;                        /**< Context for the entropy source */
+} ctr_drbg_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+       @brief          Instantiate the DRBG
+       @param ctx      DRBG state to initialize
+       @param f_entropy entropy callback. Set to NULL for ctr_drbg_entropy.
+       @param p_entropy entropy callback context
+       @param custom   optional personalization data. May be NULL.
+       @param len      length of custom
+       @return         0 if successful, or EST_ERR_CTR_DRBG_ENTROPY
+     */
+    PUBLIC int ctr_drbg_init(ctr_drbg_context *ctx, int (*f_entropy)(void *, uchar *, int), void *p_entropy,
+        uchar *custom, int len);
+
+    /**
+       @brief          Reseed the DRBG from the entropy source
+       @param ctx      DRBG state
+       @param additional optional additional input. May be NULL.
+       @param len      length of additional
+       @return         0 if successful, or EST_ERR_CTR_DRBG_ENTROPY
+     */
+    PUBLIC int ctr_drbg_reseed(ctr_drbg_context *ctx, uchar *additional, int len);
+
+    /**
+       @brief          Generate random bytes. The DRBG is reseeded every reseed_interval requests.
+       @param ctx      DRBG state
+       @param output   buffer to fill
+       @param len      length of output. Must not exceed CTR_DRBG_MAX_REQUEST.
+       @return         0 if successful, or an EST_ERR_CTR_DRBG error code
+     */
+    PUBLIC int ctr_drbg_random(ctr_drbg_context *ctx, uchar *output, int len);
+
+    /**
+       @brief          CTR_DRBG rand function for ssl_set_rng
+       @param p_rng    points to a CTR_DRBG state
+       @return         A random int
+     */
+    PUBLIC int ctr_drbg_rand(void *p_rng);
+
+    /**
+       @brief          Default entropy source. Uses getrandom() or /dev/urandom, otherwise HAVEGE.
+       @param data     unused
+       @param output   buffer to fill
+       @param len      length of output
+       @return         0 if successful, otherwise -1
+     */
+    PUBLIC int ctr_drbg_entropy(void *data, uchar *output, int len);
+
+#ifdef __cplusplus
+}
+#endif
+#endif              /* ctr_drbg.h */
+
+
 
 /********* Start of file src/debug.h ************/
 
@@ -3412,6 +3895,116 @@ extern "C" {
 
 
 
+/********* Start of file src/gcm.h ************/
+
+
+/*
+    gcm.h -- Galois/Counter Mode (NIST SP 800-38D) for AES
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+ */
+#ifndef EST_GCM_H
+#define EST_GCM_H
+
+#define GCM_ENCRYPT     1
+#define GCM_DECRYPT     0
+
+#define EST_ERR_GCM_AUTH_FAILED     -0x0024 /**< Authenticated decryption failed */
+#define EST_ERR_GCM_BAD_INPUT       -0x0026 /**< Bad input parameters */
+
+/**
+   @brief          GCM context structure
+ */
+typedef struct {
+    aes_context aes;        /**< AES context with the encryption key */
+    uint64 HL[16];          /**< Precalculated HTable low */
+    uint64 HH[16];          /**< Precalculated HTable high */
+    uchar H[16];            /**< Hash subkey */
+} gcm_context;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    /**
+       @brief          GCM key schedule
+       @param ctx      GCM context to be initialized
+       @param key      encryption key
+       @param keysize  must be 128, 192 or 256
+       @return         0 if successful, or EST_ERR_GCM_BAD_INPUT
+     */
+    PUBLIC int gcm_setkey(gcm_context *ctx, uchar *key, int keysize);
+
+    /**
+       @brief          GCM buffer encryption/decryption with tag generation
+       @param ctx      GCM context
+       @param mode     GCM_ENCRYPT or GCM_DECRYPT
+       @param length   length of the input data
+       @param iv       initialization vector
+       @param iv_len   length of the IV. 12 bytes is recommended.
+       @param add      additional authenticated data
+       @param add_len  length of add
+       @param input    buffer holding the input data
+       @param output   buffer for the output data. May be the same as input.
+       @param tag_len  length of the tag to generate (4 to 16)
+       @param tag      buffer for the tag
+       @return         0 if successful, or EST_ERR_GCM_BAD_INPUT
+     */
+    PUBLIC int gcm_crypt_and_tag(gcm_context *ctx, int mode, int length, uchar *iv, int iv_len, uchar *add,
+        int add_len, uchar *input, uchar *output, int tag_len, uchar *tag);
+
+    /**
+       @brief          GCM buffer authenticated decryption. The tag is compared in constant time.
+       @param ctx      GCM context
+       @param length   length of the input data
+       @param iv       initialization vector
+       @param iv_len   length of the IV
+       @param add      additional authenticated data
+       @param add_len  length of add
+       @param tag      tag to verify
+       @param tag_len  length of the tag
+       @param input    buffer holding the input data
+       @param output   buffer for the output data. Cleared if authentication fails.
+       @return         0 if successful, EST_ERR_GCM_AUTH_FAILED or EST_ERR_GCM_BAD_INPUT
+     */
+    PUBLIC int gcm_auth_decrypt(gcm_context *ctx, int length, uchar *iv, int iv_len, uchar *add, int add_len,
+        uchar *tag, int tag_len, uchar *input, uchar *output);
+
+#if ME_EST_SELF_TEST
+    /**
+       @brief          Checkup routine. Runs the GCM specification test vectors.
+       @return         0 if successful, or 1 if the test failed
+     */
+    PUBLIC int gcm_self_test(int verbose);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif              /* gcm.h */
+
+/*
+    @copy   default
+
+    Copyright (c) Embedthis Software. All Rights Reserved.
+
+    This software is distributed under commercial and open source licenses.
+    You may use the Embedthis Open Source license or you may acquire a 
+    commercial license from Embedthis Software. You agree to be fully bound
+    by the terms of either license. Consult the LICENSE.md distributed with
+    this software for full details and other copyrights.
+
+    Local variables:
+    tab-width: 4
+    c-basic-offset: 4
+    End:
+    vim: sw=4 ts=4 expandtab
+
+    @end
+ */
+
+
+
 /********* Start of file src/havege.h ************/
 
 
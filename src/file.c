@@ -13,9 +13,49 @@
 static char   *websIndex;                   /* Default page name */
 static char   *websDocuments;               /* Default Web page directory */
 
+#if WEBS_FILE_CACHE
+/*
+    Cached file information. Small files also cache their content. Entries are kept in LRU order and are revalidated 
+    against the file system at most every ME_GOAHEAD_FILE_CACHE_VALIDATE msecs.
+ */
+typedef struct FileCache {
+    char                *filename;          /* Resolved filename (cache key) */
+    char                *lastModified;      /* Pre-rendered Last-Modified header value */
+    char                *etag;              /* Pre-rendered ETag header value */
+    char                *data;              /* File content. Null if the file is too big to cache */
+    WebsFileInfo        info;               /* File status */
+    WebsTicks           checked;            /* When the entry was last validated */
+    ssize               memory;             /* Memory charged to the cache */
+    int                 refs;               /* Count of requests and output segments using the content */
+    int                 removed;            /* Removed from the cache. Free when refs reaches zero */
+    int                 gzip;               /* A pre-compressed "filename.gz" sibling exists */
+    struct FileCache    *prev;              /* Previous (more recently used) entry */
+    struct FileCache    *next;              /* Next (less recently used) entry */
+} FileCache;
+
+static WebsHash     fileCache = -1;         /* Hash of cached files by filename */
+static FileCache    *cacheHead;             /* Most recently used */
+static FileCache    *cacheTail;             /* Least recently used */
+static ssize        cacheMemory;            /* Total memory used by the cache */
+#endif
+
 /**************************** Forward Declarations ****************************/
 
-static void fileWriteEvent(Webs *wp);
+static char *getETag(WebsFileInfo *info);
+static bool matchETag(char *list, char *etag, bool strong);
+static int parseRanges(Webs *wp, Offset size);
+static void redirectToIndex(Webs *wp);
+#if ME_GOAHEAD_GZIP_STATIC
+static bool hasGzipFile(char *filename, WebsFileInfo *info);
+static void selectGzipFile(Webs *wp);
+#endif
+static void serveDocument(Webs *wp, WebsFileInfo *info, char *lastModified, char *etag);
+static int writeRange(Webs *wp, Offset start, Offset end, bool last);
+#if WEBS_FILE_CACHE
+static FileCache *getCachedFile(char *filename);
+static void invalidateCachedFile(char *filename);
+static void releaseCachedData(void *arg);
+#endif
 
 /*********************************** Code *************************************/
 /*
@@ -24,15 +64,21 @@ static void fileWriteEvent(Webs *wp);
 static bool fileHandler(Webs *wp)
 {
     WebsFileInfo    info;
-    char            *tmp, *date;
-    ssize           nchars;
-    int             code;
+    char            *lastModified, *etag;
+#if WEBS_FILE_CACHE
+    FileCache       *cp;
+#endif
 
     assert(websValid(wp));
     assert(wp->method);
     assert(wp->filename && wp->filename[0]);
 
 #if !ME_ROM
+#if WEBS_FILE_CACHE
+    if (smatch(wp->method, "DELETE") || smatch(wp->method, "PUT")) {
+        invalidateCachedFile(wp->filename);
+    }
+#endif
     if (smatch(wp->method, "DELETE")) {
         if (unlink(wp->filename) < 0) {
             websError(wp, HTTP_CODE_NOT_FOUND, "Cannot delete the URI");
@@ -47,17 +93,31 @@ static bool fileHandler(Webs *wp)
     } else 
 #endif /* !ME_ROM */
     {
+#if ME_GOAHEAD_GZIP_STATIC
+        selectGzipFile(wp);
+#endif
+#if WEBS_FILE_CACHE
+        if ((cp = getCachedFile(wp->filename)) != 0) {
+            if (cp->info.isDir) {
+                redirectToIndex(wp);
+                return 1;
+            }
+            if (cp->data) {
+                /*
+                    Hold a reference so the content survives eviction until websPageClose
+                 */
+                cp->refs++;
+                wp->cached = cp;
+            }
+            serveDocument(wp, &cp->info, cp->lastModified, cp->etag);
+            return 1;
+        }
+#endif
         /*
             If the file is a directory, redirect using the nominated default page
          */
         if (websPageIsDirectory(wp)) {
-            nchars = strlen(wp->path);
-            if (wp->path[nchars - 1] == '/' || wp->path[nchars - 1] == '\\') {
-                wp->path[--nchars] = '\0';
-            }
-            tmp = sfmt("%s/%s", wp->path, websIndex);
-            websRedirect(wp, tmp);
-            wfree(tmp);
+            redirectToIndex(wp);
             return 1;
         }
         if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
@@ -73,74 +133,623 @@ static bool fileHandler(Webs *wp)
             websError(wp, HTTP_CODE_NOT_FOUND, "Cannot stat page for URL");
             return 1;
         }
-        code = 200;
-        if (wp->since && info.mtime <= wp->since) {
-            code = 304;
-            info.size = 0;
+        lastModified = websGetDateString(&info);
+        etag = getETag(&info);
+        serveDocument(wp, &info, lastModified, etag);
+        wfree(lastModified);
+        wfree(etag);
+    }
+    return 1;
+}
+
+
+static void redirectToIndex(Webs *wp)
+{
+    char    *tmp;
+    ssize   nchars;
+
+    nchars = strlen(wp->path);
+    if (wp->path[nchars - 1] == '/' || wp->path[nchars - 1] == '\\') {
+        wp->path[--nchars] = '\0';
+    }
+    tmp = sfmt("%s/%s", wp->path, websIndex);
+    websRedirect(wp, tmp);
+    wfree(tmp);
+}
+
+
+#if ME_GOAHEAD_GZIP_STATIC
+/*
+    Test if a pre-compressed "filename.gz" sibling exists that is not older than the document described by info
+ */
+static bool hasGzipFile(char *filename, WebsFileInfo *info)
+{
+    WebsFileInfo    gzinfo;
+    char            *gzname;
+    bool            rc;
+
+    gzname = sfmt("%s.gz", filename);
+    rc = websStatFile(gzname, &gzinfo) == 0 && !gzinfo.isDir && gzinfo.mtime >= info->mtime;
+    wfree(gzname);
+    return rc;
+}
+
+
+/*
+    Serve the pre-compressed sibling of the requested document to a client that accepts gzip encoding.
+    The sibling is only used if the document itself exists and the sibling is not older than the document.
+    This switches wp->filename to the sibling. The mime type is still determined by the request extension.
+    If there is a sibling, the response varies by Accept-Encoding whether or not the sibling is served.
+ */
+static void selectGzipFile(Webs *wp)
+{
+    char            *gzname;
+#if WEBS_FILE_CACHE
+    FileCache       *cp, *gp;
+
+    if ((cp = getCachedFile(wp->filename)) == 0 || !cp->gzip) {
+        return;
+    }
+    gzname = sfmt("%s.gz", wp->filename);
+    if ((gp = getCachedFile(gzname)) == 0 || gp->info.isDir || gp->info.mtime < cp->info.mtime) {
+        wfree(gzname);
+        return;
+    }
+#else
+    WebsFileInfo    info;
+
+    if (websStatFile(wp->filename, &info) < 0 || info.isDir || !hasGzipFile(wp->filename, &info)) {
+        return;
+    }
+    gzname = sfmt("%s.gz", wp->filename);
+#endif
+    wp->flags |= WEBS_VARY_ENCODING;
+    if (!(wp->flags & WEBS_ACCEPT_GZIP)) {
+        wfree(gzname);
+        return;
+    }
+    wfree(wp->filename);
+    wp->filename = gzname;
+    wp->flags |= WEBS_GZIP;
+}
+#endif
+
+
+/*
+    Create a strong entity tag from the file inode, size and modification time
+ */
+static char *getETag(WebsFileInfo *info)
+{
+    return sfmt("\"%Lx-%Lx-%Lx\"", (int64) info->inode, (int64) info->size, (int64) info->mtime);
+}
+
+
+/*
+    Test if an entity tag matches a list of entity tags from an If-None-Match or If-Range header.
+    Strong comparison is required for If-Range and does not match weak tags.
+ */
+static bool matchETag(char *list, char *etag, bool strong)
+{
+    char    *cp, *end;
+    ssize   len;
+    bool    weak;
+
+    len = slen(etag);
+    for (cp = list; *cp; cp = end) {
+        while (*cp == ' ' || *cp == '\t' || *cp == ',') {
+            cp++;
+        }
+        if (*cp == '\0') {
+            break;
+        }
+        if (*cp == '*') {
+            return !strong;
         }
-        websSetStatus(wp, code);
-        websWriteHeaders(wp, info.size, 0);
-        if ((date = websGetDateString(&info)) != NULL) {
-            websWriteHeader(wp, "Last-Modified", "%s", date);
-            wfree(date);
+        weak = 0;
+        if (cp[0] == 'W' && cp[1] == '/') {
+            weak = 1;
+            cp += 2;
         }
-        websWriteEndHeaders(wp);
+        for (end = cp; *end && *end != ','; end++) ;
+        if ((end - cp) >= len && sncmp(cp, etag, len) == 0 && !(weak && strong)) {
+            if (cp[len] == '\0' || cp[len] == ',' || cp[len] == ' ' || cp[len] == '\t') {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
 
-        /*
-            All done if the browser did a HEAD request
-         */
-        if (smatch(wp->method, "HEAD")) {
-            websDone(wp);
+
+/*
+    Return true if the client's copy of the document is current and a 304 response should be sent.
+    If-None-Match takes precedence over If-Modified-Since. Dates are compared as strings before parsing as clients
+    normally echo the Last-Modified value.
+ */
+static bool notModified(Webs *wp, WebsFileInfo *info, char *lastModified, char *etag)
+{
+    if (wp->ifNoneMatch) {
+        return (smatch(wp->method, "GET") || smatch(wp->method, "HEAD")) && matchETag(wp->ifNoneMatch, etag, 0);
+    }
+    if (wp->ifModifiedSince) {
+        if (lastModified && smatch(wp->ifModifiedSince, lastModified)) {
             return 1;
         }
-        if (info.size > 0) {
-            websSetBackgroundWriter(wp, fileWriteEvent);
+        if (!wp->since) {
+            wp->since = websParseDate(wp->ifModifiedSince);
+        }
+        return wp->since && info->mtime <= wp->since;
+    }
+    return 0;
+}
+
+
+/*
+    Return true if the Range header should be applied. An If-Range validator must match the current document.
+ */
+static bool matchIfRange(Webs *wp, WebsFileInfo *info, char *lastModified, char *etag)
+{
+    char    *value;
+
+    if ((value = wp->ifRange) == 0) {
+        return 1;
+    }
+    if (*value == '"' || sncmp(value, "W/", 2) == 0) {
+        return matchETag(value, etag, 1);
+    }
+    if (lastModified && smatch(value, lastModified)) {
+        return 1;
+    }
+    return info->mtime && websParseDate(value) == info->mtime;
+}
+
+
+static int parseOffset(char **str, Offset *offset)
+{
+    char    *cp;
+    Offset  value;
+
+    value = 0;
+    for (cp = *str; isdigit((uchar) *cp); cp++) {
+        if (value > (MAXINT64 - 9) / 10) {
+            return -1;
+        }
+        value = value * 10 + (*cp - '0');
+    }
+    if (cp == *str) {
+        return -1;
+    }
+    *str = cp;
+    *offset = value;
+    return 0;
+}
+
+
+/*
+    Parse the Range header into wp->ranges. Returns the number of satisfiable ranges, zero if the header should be 
+    ignored or -1 if no range is satisfiable. Invalid headers and requests for too many ranges are ignored.
+ */
+static int parseRanges(Webs *wp, Offset size)
+{
+    WebsRange   *ranges;
+    char        *cp;
+    Offset      start, end;
+    int         count, specs;
+
+    if (sncaselesscmp(wp->range, "bytes=", 6) != 0) {
+        return 0;
+    }
+    if ((ranges = walloc(sizeof(WebsRange) * WEBS_MAX_RANGES)) == 0) {
+        return 0;
+    }
+    count = specs = 0;
+    for (cp = &wp->range[6]; *cp; ) {
+        while (*cp == ' ' || *cp == '\t' || *cp == ',') {
+            cp++;
+        }
+        if (*cp == '\0') {
+            break;
+        }
+        start = end = -1;
+        if (isdigit((uchar) *cp) && parseOffset(&cp, &start) < 0) {
+            break;
+        }
+        if (*cp++ != '-') {
+            break;
+        }
+        if (isdigit((uchar) *cp) && parseOffset(&cp, &end) < 0) {
+            break;
+        }
+        while (*cp == ' ' || *cp == '\t') {
+            cp++;
+        }
+        if ((*cp && *cp != ',') || (start < 0 && end < 0) || (start >= 0 && end >= 0 && end < start)) {
+            break;
+        }
+        if (++specs > WEBS_MAX_RANGES) {
+            break;
+        }
+        if (start < 0) {
+            /* Suffix range of the last "end" bytes */
+            if (end == 0) {
+                continue;
+            }
+            start = (end >= size) ? 0 : size - end;
+            end = size;
         } else {
-            websDone(wp);
+            if (start >= size) {
+                continue;
+            }
+            end = (end < 0 || end >= size) ? size : end + 1;
         }
+        ranges[count].start = start;
+        ranges[count].end = end;
+        count++;
     }
-    return 1;
+    if (*cp) {
+        /* Invalid range specification */
+        wfree(ranges);
+        return 0;
+    }
+    if (count == 0) {
+        wfree(ranges);
+        return specs ? -1 : 0;
+    }
+    wp->ranges = ranges;
+    wp->rangeCount = count;
+    wp->rangeSize = size;
+    if (count > 1) {
+        wp->rangeBoundary = sfmt("%Lx%x", websGetTicks(), (int) (size & 0xFFFFFF) ^ wp->wid);
+    }
+    return count;
+}
+
+
+static char *getPartHeader(Webs *wp, WebsRange *rp)
+{
+    char    *mimeType;
+
+    if ((mimeType = websGetMimeType(wp)) != 0) {
+        return sfmt("\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %Ld-%Ld/%Ld\r\n\r\n", 
+            wp->rangeBoundary, mimeType, rp->start, rp->end - 1, wp->rangeSize);
+    }
+    return sfmt("\r\n--%s\r\nContent-Range: bytes %Ld-%Ld/%Ld\r\n\r\n", 
+        wp->rangeBoundary, rp->start, rp->end - 1, wp->rangeSize);
 }
 
 
 /*
-    Do output back to the browser in the background. This is a socket write handler.
-    This bypasses the output buffer and writes directly to the socket.
+    Compute the Content-Length of a range response including multipart boundaries
  */
-static void fileWriteEvent(Webs *wp)
+static Offset getRangeLength(Webs *wp)
 {
-    char    *buf;
-    ssize   len, wrote;
+    WebsRange   *rp;
+    char        *header;
+    Offset      length;
 
-    assert(wp);
-    assert(websValid(wp));
+    if (wp->rangeCount == 1) {
+        return wp->ranges[0].end - wp->ranges[0].start;
+    }
+    length = 0;
+    for (rp = wp->ranges; rp < &wp->ranges[wp->rangeCount]; rp++) {
+        header = getPartHeader(wp, rp);
+        length += slen(header) + (rp->end - rp->start);
+        wfree(header);
+    }
+    /* Closing delimiter "\r\n--boundary--\r\n" */
+    return length + slen(wp->rangeBoundary) + 8;
+}
+
+
+/*
+    Add a document range to the output. Cached content is referenced from the cache. Otherwise the file range is
+    written from the document file. The output takes ownership of the document file with the last range.
+ */
+static int writeRange(Webs *wp, Offset start, Offset end, bool last)
+{
+    int         fd;
+#if WEBS_FILE_CACHE
+    FileCache   *cp;
+
+    if ((cp = wp->cached) != 0) {
+        /*
+            Each reference holds the content until it is written, which may be after this request completes
+         */
+        cp->refs++;
+        return websWriteReference(wp, &cp->data[start], (ssize) (end - start), releaseCachedData, cp) < 0 ? -1 : 0;
+    }
+#endif
+    if ((fd = wp->docfd) < 0) {
+        return -1;
+    }
+    if (last) {
+        wp->docfd = -1;
+    }
+    return websSendFile(wp, fd, start, (ssize) (end - start), last) < 0 ? -1 : 0;
+}
+
+
+/*
+    Write the response headers and add the document to the output. The document is written as the socket permits.
+    This handles conditional requests and byte range requests.
+ */
+static void serveDocument(Webs *wp, WebsFileInfo *info, char *lastModified, char *etag)
+{
+    WebsRange   *rp;
+    Offset      size, length;
+    char        *header;
+    int         code, count;
+
+    size = (Offset) info->size;
+    length = size;
+    code = HTTP_CODE_OK;
+    count = 0;
+
+    if (notModified(wp, info, lastModified, etag)) {
+        code = HTTP_CODE_NOT_MODIFIED;
+        length = 0;
+
+    } else if (wp->range && smatch(wp->method, "GET") && matchIfRange(wp, info, lastModified, etag)) {
+        if ((count = parseRanges(wp, size)) < 0) {
+            code = HTTP_CODE_RANGE_NOT_SATISFIABLE;
+            length = 0;
+        } else if (count > 0) {
+            code = HTTP_CODE_PARTIAL;
+            length = getRangeLength(wp);
+        }
+    }
+    if (length > 0 && !smatch(wp->method, "HEAD") && !wp->cached && wp->docfd < 0) {
+        if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
+#if WEBS_FILE_CACHE
+            invalidateCachedFile(wp->filename);
+#endif
+            websError(wp, HTTP_CODE_NOT_FOUND, "Cannot open document for: %s", wp->path);
+            return;
+        }
+    }
+    websSetStatus(wp, code);
+    websWriteHeaders(wp, (ssize) length, 0);
+    if (lastModified) {
+        websWriteHeader(wp, "Last-Modified", "%s", lastModified);
+    }
+    if (etag) {
+        websWriteHeader(wp, "ETag", "%s", etag);
+    }
+    websWriteHeader(wp, "Accept-Ranges", "bytes");
+    if (wp->flags & WEBS_GZIP) {
+        websWriteHeader(wp, "Content-Encoding", "gzip");
+    }
+    if (wp->flags & WEBS_VARY_ENCODING) {
+        websWriteHeader(wp, "Vary", "Accept-Encoding");
+    }
+    if (code == HTTP_CODE_RANGE_NOT_SATISFIABLE) {
+        websWriteHeader(wp, "Content-Range", "bytes */%Ld", size);
+    } else if (count == 1) {
+        websWriteHeader(wp, "Content-Range", "bytes %Ld-%Ld/%Ld", wp->ranges[0].start, wp->ranges[0].end - 1, size);
+    }
+    websWriteEndHeaders(wp);
 
     /*
-        Note: websWriteSocket may return less than we wanted. It will return -1 on a socket error.
+        All done if the browser did a HEAD request
      */
-    if ((buf = walloc(ME_GOAHEAD_LIMIT_BUFFER)) == NULL) {
-        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot get memory");
+    if (smatch(wp->method, "HEAD") || length <= 0) {
+        websDone(wp);
         return;
     }
-    /*
-        OPT - we could potentially save this buffer so that on short-writes, it does not need to be re-read.
-     */
-    while ((len = websPageReadData(wp, buf, ME_GOAHEAD_LIMIT_BUFFER)) > 0) {
-        if ((wrote = websWriteSocket(wp, buf, len)) < 0) {
-            break;
+    if (count == 0) {
+        writeRange(wp, 0, size, 1);
+    } else {
+        for (rp = wp->ranges; rp < &wp->ranges[count]; rp++) {
+            if (wp->rangeBoundary) {
+                header = getPartHeader(wp, rp);
+                websWriteBlock(wp, header, slen(header));
+                wfree(header);
+            }
+            writeRange(wp, rp->start, rp->end, rp == &wp->ranges[count - 1]);
         }
-        if (wrote != len) {
-            websPageSeek(wp, - (len - wrote), SEEK_CUR);
-            break;
+        if (wp->rangeBoundary) {
+            websWrite(wp, "\r\n--%s--\r\n", wp->rangeBoundary);
         }
     }
-    wfree(buf);
-    if (len <= 0) {
-        websDone(wp);
+    websDone(wp);
+}
+
+
+#if WEBS_FILE_CACHE
+static void freeCachedFile(FileCache *cp)
+{
+    wfree(cp->filename);
+    wfree(cp->lastModified);
+    wfree(cp->etag);
+    wfree(cp->data);
+    wfree(cp);
+}
+
+
+/*
+    Release a reference to cached content once it has been written
+ */
+static void releaseCachedData(void *arg)
+{
+    FileCache   *cp;
+
+    cp = arg;
+    if (--cp->refs == 0 && cp->removed) {
+        freeCachedFile(cp);
     }
 }
 
 
+/*
+    Remove an entry from the cache. If requests are still writing its content, it is freed when they complete.
+ */
+static void removeCachedFile(FileCache *cp)
+{
+    if (cp->removed) {
+        return;
+    }
+    hashDelete(fileCache, cp->filename);
+    if (cp->prev) {
+        cp->prev->next = cp->next;
+    } else {
+        cacheHead = cp->next;
+    }
+    if (cp->next) {
+        cp->next->prev = cp->prev;
+    } else {
+        cacheTail = cp->prev;
+    }
+    cp->prev = cp->next = 0;
+    cacheMemory -= cp->memory;
+    cp->removed = 1;
+    if (cp->refs == 0) {
+        freeCachedFile(cp);
+    }
+}
+
+
+static void invalidateCachedFile(char *filename)
+{
+    WebsKey     *key;
+
+    if ((key = hashLookup(fileCache, filename)) != 0) {
+        removeCachedFile((FileCache*) key->content.value.symbol);
+    }
+}
+
+
+PUBLIC void websReleaseCachedFile(Webs *wp)
+{
+    FileCache   *cp;
+
+    if ((cp = wp->cached) != 0) {
+        wp->cached = 0;
+        releaseCachedData(cp);
+    }
+}
+
+
+static void touchCachedFile(FileCache *cp)
+{
+    if (cp == cacheHead) {
+        return;
+    }
+    if (cp->prev) {
+        cp->prev->next = cp->next;
+    }
+    if (cp->next) {
+        cp->next->prev = cp->prev;
+    } else if (cacheTail == cp) {
+        cacheTail = cp->prev;
+    }
+    cp->prev = 0;
+    cp->next = cacheHead;
+    if (cacheHead) {
+        cacheHead->prev = cp;
+    }
+    cacheHead = cp;
+    if (!cacheTail) {
+        cacheTail = cp;
+    }
+}
+
+
+/*
+    Read small files into memory. Returns null if the file cannot be fully read.
+ */
+static char *readCachedContent(char *filename, ssize size)
+{
+    char    *data;
+    ssize   nbytes, len;
+    int     fd;
+
+    if ((fd = websOpenFile(filename, O_RDONLY | O_BINARY, 0666)) < 0) {
+        return 0;
+    }
+    if ((data = walloc(max(size, 1))) != 0) {
+        for (len = 0; len < size; len += nbytes) {
+            if ((nbytes = websReadFile(fd, &data[len], size - len)) <= 0) {
+                wfree(data);
+                data = 0;
+                break;
+            }
+        }
+    }
+    websCloseFile(fd);
+    return data;
+}
+
+
+/*
+    Return the cache entry for a filename. Entries are revalidated via stat when older than the validation period.
+    Missing files are not cached.
+ */
+static FileCache *getCachedFile(char *filename)
+{
+    FileCache       *cp;
+    WebsFileInfo    info;
+    WebsKey         *key;
+    WebsTicks       now;
+    ssize           memory;
+
+    now = websGetTicks();
+    if ((key = hashLookup(fileCache, filename)) != 0) {
+        cp = (FileCache*) key->content.value.symbol;
+        if ((now - cp->checked) < ME_GOAHEAD_FILE_CACHE_VALIDATE) {
+            touchCachedFile(cp);
+            return cp;
+        }
+        if (websStatFile(filename, &info) == 0 && info.mtime == cp->info.mtime && info.size == cp->info.size &&
+                info.isDir == cp->info.isDir) {
+            cp->checked = now;
+#if ME_GOAHEAD_GZIP_STATIC
+            cp->gzip = !info.isDir && hasGzipFile(filename, &info);
+#endif
+            touchCachedFile(cp);
+            return cp;
+        }
+        removeCachedFile(cp);
+    }
+    if (websStatFile(filename, &info) < 0) {
+        return 0;
+    }
+    if ((cp = walloc(sizeof(FileCache))) == 0) {
+        return 0;
+    }
+    memset(cp, 0, sizeof(FileCache));
+    cp->filename = sclone(filename);
+    cp->info = info;
+    cp->checked = now;
+    cp->lastModified = websGetDateString(&info);
+    cp->etag = getETag(&info);
+#if ME_GOAHEAD_GZIP_STATIC
+    cp->gzip = !info.isDir && hasGzipFile(filename, &info);
+#endif
+    if (!info.isDir && info.size <= ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM) {
+        cp->data = readCachedContent(filename, (ssize) info.size);
+    }
+    if (!cp->lastModified || !cp->etag) {
+        freeCachedFile(cp);
+        return 0;
+    }
+    memory = sizeof(FileCache) + slen(cp->filename) + slen(cp->lastModified) + slen(cp->etag) + 
+        (cp->data ? (ssize) info.size : 0);
+    while (cacheTail && (cacheMemory + memory) > ME_GOAHEAD_LIMIT_FILE_CACHE) {
+        removeCachedFile(cacheTail);
+    }
+    if ((cacheMemory + memory) > ME_GOAHEAD_LIMIT_FILE_CACHE) {
+        freeCachedFile(cp);
+        return 0;
+    }
+    cp->memory = memory;
+    cacheMemory += memory;
+    hashEnter(fileCache, cp->filename, valueSymbol(cp), 0);
+    touchCachedFile(cp);
+    return cp;
+}
+#endif /* WEBS_FILE_CACHE */
+
+
 #if !ME_ROM
 PUBLIC int websProcessPutData(Webs *wp)
 {
@@ -168,6 +777,15 @@ PUBLIC int websProcessPutData(Webs *wp)
 
 static void fileClose()
 {
+#if WEBS_FILE_CACHE
+    while (cacheHead) {
+        removeCachedFile(cacheHead);
+    }
+    if (fileCache >= 0) {
+        hashFree(fileCache);
+        fileCache = -1;
+    }
+#endif
     wfree(websIndex);
     websIndex = NULL;
     wfree(websDocuments);
@@ -178,6 +796,9 @@ static void fileClose()
 PUBLIC void websFileOpen()
 {
     websIndex = sclone("index.html");
+#if WEBS_FILE_CACHE
+    fileCache = hashCreate(WEBS_HASH_INIT);
+#endif
     websDefineHandler("file", 0, fileHandler, fileClose, 0);
 }
 
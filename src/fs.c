@@ -12,6 +12,7 @@
 
 #if ME_ROM
 static WebsHash romFs;             /* Symbol table for web pages */
+static ulong    *romHashes;        /* Content hashes for web pages. Used as the inode for ETags */
 #endif
 
 /*********************************** Code *************************************/
@@ -21,10 +22,24 @@ PUBLIC int websFsOpen()
 #if ME_ROM
     WebsRomIndex    *wip;
     char            name[ME_GOAHEAD_LIMIT_FILENAME];
-    ssize           len;
+    ssize           len, i;
+    ulong           hash;
 
     romFs = hashCreate(WEBS_HASH_INIT);
+    for (wip = websRomIndex; wip->path; wip++) ;
+    romHashes = walloc(max(wip - websRomIndex, 1) * sizeof(ulong));
+
     for (wip = websRomIndex; wip->path; wip++) {
+        /*
+            FNV-1a hash of the page content so ETags change when the ROM image changes
+         */
+        hash = 2166136261U;
+        for (i = 0; wip->page && i < wip->size; i++) {
+            hash = (hash ^ wip->page[i]) * 16777619U;
+        }
+        if (romHashes) {
+            romHashes[wip - websRomIndex] = hash;
+        }
         strncpy(name, wip->path, ME_GOAHEAD_LIMIT_FILENAME);
         len = strlen(name) - 1;
         if (len > 0 &&
@@ -42,6 +57,8 @@ PUBLIC void websFsClose()
 {
 #if ME_ROM
     hashFree(romFs);
+    wfree(romHashes);
+    romHashes = 0;
 #endif
 }
 
@@ -91,6 +108,9 @@ PUBLIC int websStatFile(char *path, WebsFileInfo *sbuf)
     if (wip->page == NULL) {
         sbuf->isDir = 1;
     }
+    if (romHashes) {
+        sbuf->inode = romHashes[wip - websRomIndex];
+    }
     return 0;
 #else
     WebsStat    s;
@@ -114,7 +134,8 @@ PUBLIC int websStatFile(char *path, WebsFileInfo *sbuf)
     }
     sbuf->size = (ssize) s.st_size;
     sbuf->mtime = s.st_mtime;
-    sbuf->isDir = s.st_mode & S_IFDIR;                                                                     
+    sbuf->isDir = s.st_mode & S_IFDIR;
+    sbuf->inode = (ulong) s.st_ino;                                                                     
     return 0;  
 #endif
 }
@@ -10,6 +10,7 @@
         --route routeFile      # Route configuration file
         --verbose              # Same as --log stdout:2
         --version              # Output version information
+        --workers count        # Number of worker processes
 
     Copyright (c) All Rights Reserved. See details at the end of the file.
  */
@@ -43,7 +44,7 @@ static void sigHandler(int signo);
 MAIN(goahead, int argc, char **argv, char **envp)
 {
     char    *argp, *home, *documents, *endpoints, *endpoint, *route, *auth, *tok, *lspec;
-    int     argind;
+    int     argind, rc;
 
 #if WINDOWS
     if (windowsInit() < 0) {
@@ -90,6 +91,10 @@ MAIN(goahead, int argc, char **argv, char **envp)
             printf("%s\n", ME_VERSION);
             exit(0);
 
+        } else if (smatch(argp, "--workers") || smatch(argp, "-w")) {
+            if (argind >= argc) usage();
+            websSetWorkers(atoi(argv[++argind]));
+
         } else if (*argp == '-' && isdigit((uchar) argp[1])) {
             lspec = sfmt("stdout:%s", &argp[1]);
             logSetPath(lspec);
@@ -104,6 +109,24 @@ MAIN(goahead, int argc, char **argv, char **envp)
         documents = argv[argind++];
     }
     initPlatform();
+#if ME_UNIX_LIKE
+    if (websGetWorkers() > 1) {
+        /*
+            Workers are started before websOpen so each has its own sockets, sessions and TLS state.
+            This process then supervises the workers until instructed to exit.
+         */
+#if !MACOSX
+        if (websGetBackground() && daemon(0, 0) < 0) {
+            error("Cannot run as daemon");
+            return -1;
+        }
+#endif
+        if ((rc = websStartWorkers(&finished)) != 0) {
+            logmsg(1, "Workers exited");
+            return rc < 0 ? -1 : 0;
+        }
+    }
+#endif
     if (websOpen(documents, route) < 0) {
         error("Cannot initialize server. Exiting.");
         return -1;
@@ -143,7 +166,7 @@ MAIN(goahead, int argc, char **argv, char **envp)
     /*
         Service events till terminated
      */
-    if (websGetBackground()) {
+    if (websGetBackground() && websGetWorkers() <= 1) {
         if (daemon(0, 0) < 0) {
             error("Cannot run as daemon");
             return -1;
@@ -192,7 +215,11 @@ static void usage() {
         "    --log logFile:level    # Log to file file at verbosity level\n"
         "    --route routeFile      # Route configuration file\n"
         "    --verbose              # Same as --log stdout:2\n"
-        "    --version              # Output version information\n\n",
+        "    --version              # Output version information\n"
+#if ME_UNIX_LIKE
+        "    --workers count        # Number of worker processes\n"
+#endif
+        "\n",
         ME_TITLE, ME_NAME);
     exit(-1);
 }
@@ -35,6 +35,110 @@
     #endif
 #endif /* ECOS */
 
+#ifndef ME_GOAHEAD_WORKERS
+    #define ME_GOAHEAD_WORKERS 0                /**< Number of worker processes. Zero to serve in the main process */
+#endif
+#ifndef ME_GOAHEAD_EPOLL
+    #define ME_GOAHEAD_EPOLL 1                  /**< Use epoll for socket readiness on Linux */
+#endif
+#ifndef ME_GOAHEAD_EPOLL_EDGE
+    #define ME_GOAHEAD_EPOLL_EDGE 0             /**< Use edge-triggered epoll events for non-TLS sockets */
+#endif
+#if LINUX && ME_GOAHEAD_EPOLL
+    #define WEBS_EPOLL 1
+#else
+    #define WEBS_EPOLL 0                        /**< Other systems use select */
+#endif
+#ifndef ME_GOAHEAD_SENDFILE
+    #define ME_GOAHEAD_SENDFILE 1               /**< Use sendfile to serve static documents on Linux */
+#endif
+#if LINUX && ME_GOAHEAD_SENDFILE && !ME_ROM
+    #define WEBS_SENDFILE 1
+#else
+    #define WEBS_SENDFILE 0                     /**< Documents are copied via a buffer */
+#endif
+#ifndef ME_GOAHEAD_FILE_CACHE
+    #define ME_GOAHEAD_FILE_CACHE 1             /**< Cache static document information and content */
+#endif
+#ifndef ME_GOAHEAD_FILE_CACHE_VALIDATE
+    #define ME_GOAHEAD_FILE_CACHE_VALIDATE 2000 /**< Msecs between file cache revalidations */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_FILE_CACHE
+    #define ME_GOAHEAD_LIMIT_FILE_CACHE 1048576 /**< Maximum memory for the file cache */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM
+    #define ME_GOAHEAD_LIMIT_FILE_CACHE_ITEM 65536 /**< Maximum document size to cache in memory */
+#endif
+#if ME_GOAHEAD_FILE_CACHE && !ME_ROM
+    #define WEBS_FILE_CACHE 1
+#else
+    #define WEBS_FILE_CACHE 0
+#endif
+#ifndef ME_GOAHEAD_JST_CACHE
+    #define ME_GOAHEAD_JST_CACHE 1              /**< Cache compiled Javascript templates */
+#endif
+#ifndef ME_GOAHEAD_GZIP_STATIC
+    #define ME_GOAHEAD_GZIP_STATIC 1            /**< Serve pre-compressed "file.gz" documents to gzip clients */
+#endif
+#ifndef ME_COM_ZLIB
+    #define ME_COM_ZLIB 0                       /**< Build with zlib for dynamic compression */
+#endif
+#ifndef ME_GOAHEAD_COMPRESS
+    #define ME_GOAHEAD_COMPRESS 1               /**< Compress dynamic responses when built with zlib */
+#endif
+#ifndef ME_GOAHEAD_COMPRESS_TYPES
+    #define ME_GOAHEAD_COMPRESS_TYPES "text/html,text/plain,text/css,text/xml,application/x-javascript,application/json"
+#endif
+#ifndef ME_GOAHEAD_LIMIT_COMPRESS
+    #define ME_GOAHEAD_LIMIT_COMPRESS 1024      /**< Minimum dynamic response size to compress */
+#endif
+#if ME_GOAHEAD_COMPRESS && ME_COM_ZLIB
+    #define WEBS_COMPRESS 1
+#else
+    #define WEBS_COMPRESS 0                     /**< Dynamic responses are sent with identity encoding */
+#endif
+#ifndef ME_GOAHEAD_FASTCGI
+    #define ME_GOAHEAD_FASTCGI 1                /**< Enable the FastCGI handler */
+#endif
+#ifndef ME_GOAHEAD_FASTCGI_WORKERS
+    #define ME_GOAHEAD_FASTCGI_WORKERS 2        /**< Number of worker processes for each FastCGI program */
+#endif
+#if ME_GOAHEAD_CGI && ME_GOAHEAD_FASTCGI && ME_UNIX_LIKE && !ME_ROM
+    #define WEBS_FASTCGI 1
+#else
+    #define WEBS_FASTCGI 0                      /**< FastCGI requires Unix domain sockets */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_ARENA
+    #define ME_GOAHEAD_LIMIT_ARENA 2048         /**< Size of the per-request arena for request strings */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_SSL_CACHE
+    #define ME_GOAHEAD_LIMIT_SSL_CACHE 256      /**< Maximum TLS sessions to cache for resumption (EST) */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_SSL_LIFESPAN
+    #define ME_GOAHEAD_LIMIT_SSL_LIFESPAN 3600  /**< TLS session and ticket lifespan in seconds (EST) */
+#endif
+#ifndef ME_GOAHEAD_SSL_TICKETS
+    #define ME_GOAHEAD_SSL_TICKETS 1            /**< Issue TLS session tickets (EST) */
+#endif
+#ifndef ME_GOAHEAD_SSL_TICKET_ROTATE
+    #define ME_GOAHEAD_SSL_TICKET_ROTATE 3600   /**< Seconds between TLS session ticket key rotations (EST) */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_UPLOAD_BUFFER
+    #define ME_GOAHEAD_LIMIT_UPLOAD_BUFFER 65536    /**< Uploaded file data to accumulate before writing */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_WEBS_POOL
+    #define ME_GOAHEAD_LIMIT_WEBS_POOL 64       /**< Maximum number of idle request objects to retain for reuse */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_PIPELINE
+    #define ME_GOAHEAD_LIMIT_PIPELINE 8         /**< Maximum pipelined responses to coalesce before writing */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_TX_HIGH_WATER
+    #define ME_GOAHEAD_LIMIT_TX_HIGH_WATER 65536    /**< Queued output at which websWouldBlock signals backpressure */
+#endif
+#ifndef ME_GOAHEAD_LIMIT_TX_QUEUE
+    #define ME_GOAHEAD_LIMIT_TX_QUEUE 1048576   /**< Maximum queued output before a request fails */
+#endif
+
 #if QNX
     typedef long fd_mask;
     #define NFDBITS (sizeof (fd_mask) * NBBY)   /* bits per mask */
@@ -120,6 +224,9 @@ PUBLIC int websParseArgs(char *args, char **argv, int maxArgc);
 
 #define WEBS_MAX_LISTEN     8           /**< Maximum number of listen endpoints */
 #define WEBS_SMALL_HASH     31          /**< General small hash size */
+#define WEBS_MAX_EVENTS     128         /**< Maximum I/O events to retrieve per epoll wait */
+#define WEBS_MAX_WORKERS    256         /**< Maximum number of worker processes */
+#define WEBS_MAX_RANGES     16          /**< Maximum byte ranges in a request before the Range header is ignored */
 
 /************************************* Error **********************************/
 
@@ -322,6 +429,12 @@ typedef enum WebsType {
  */
 typedef time_t WebsTime;
 
+/**
+    Monotonic time in milliseconds
+    @ingroup WebsRuntime
+ */
+typedef int64 WebsTicks;
+
 /**
     Value union to store primitive value types
  */
@@ -610,19 +723,21 @@ PUBLIC char *bufStart(WebsBuf *bp);
 #if ME_GOAHEAD_REPLACE_MALLOC
 /**
     GoAhead allocator memory block 
-    Memory block classes are: 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536.
+    Memory block classes are: 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144,
+    8192, 12288, 16384. Larger blocks are allocated via malloc.
     @defgroup WebsAlloc WebsAlloc
  */
 typedef struct WebsAlloc {
     union {
-        void    *next;                          /**< Pointer to next in q */
-        int     size;                           /**< Actual requested size */
+        void    *next;                          /**< Pointer to next free block */
+        struct WebsSlab *slab;                  /**< Slab owning an allocated block */
+        ssize   size;                           /**< Requested size of a large block */
     } u;
-    int         flags;                          /**< Per block allocation flags */
+    int         flags;                          /**< Per block allocation flags and size class */
 } WebsAlloc;
 
 #define WEBS_DEFAULT_MEM   (64 * 1024)         /**< Default memory allocation */
-#define WEBS_MAX_CLASS     13                  /**< Maximum class number + 1 */
+#define WEBS_MAX_CLASS     20                  /**< Maximum class number + 1 */
 #define WEBS_SHIFT         4                   /**< Convert size to class */
 #define WEBS_ROUND         ((1 << (B_SHIFT)) - 1)
 #define WEBS_MALLOCED      0x80000000          /* Block was malloced */
@@ -637,6 +752,26 @@ typedef struct WebsAlloc {
 #define WEBS_INTEGRITY         0x8124000       /* Integrity value */
 #define WEBS_INTEGRITY_MASK    0xFFFF000       /* Integrity mask */
 
+/**
+    Allocator statistics
+    @description Blocks held in per-thread caches are counted as allocated.
+    @ingroup WebsAlloc
+ */
+typedef struct WebsAllocStats {
+    ssize       bytes;                          /**< Bytes allocated */
+    ssize       blocks;                         /**< Blocks allocated */
+    ssize       slabs;                          /**< Slabs in use */
+    ssize       largeBytes;                     /**< Bytes allocated in blocks larger than the maximum class */
+    ssize       largeBlocks;                    /**< Blocks larger than the maximum class */
+    ssize       regionFree;                     /**< Unused memory in the primary memory region */
+    struct {
+        ssize   size;                           /**< Block size for the class */
+        ssize   bytes;                          /**< Bytes allocated in the class */
+        ssize   blocks;                         /**< Blocks allocated in the class */
+        ssize   slabs;                          /**< Slabs holding blocks of the class */
+    } classes[WEBS_MAX_CLASS];
+} WebsAllocStats;
+
 /**
     Close the GoAhead memory allocator
     @ingroup WebsAlloc
@@ -666,6 +801,13 @@ PUBLIC int wopenAlloc(void *buf, int bufsize, int flags);
  */
 PUBLIC void *walloc(ssize size);
 
+/**
+    Get allocator statistics
+    @param stats Reference to a statistics structure to fill
+    @ingroup WebsAlloc
+ */
+PUBLIC void wallocStats(WebsAllocStats *stats);
+
 /**
     Free an allocated block of memory
     @param blk Reference to the memory block to free.
@@ -675,8 +817,8 @@ PUBLIC void wfree(void *blk);
 
 /**
     Reallocate a block of memory and grow its size
-    @description If the new size is larger than the existing block, a new block will be allocated and the old data
-        will be copied to the new block.
+    @description If the new size is larger than the existing block, the block is grown in place if possible.
+        Otherwise, a new block will be allocated and the old data will be copied to the new block.
     @param blk Original block reference
     @param newsize Size of the new block. 
     @return Reference to the new memory block
@@ -702,16 +844,17 @@ PUBLIC char  *awtom(wchar *src, ssize *len);
 /**
     Hash table entry structure.
     @description The hash structure supports growable hash tables with high performance, collision resistant hashes.
-    Each hash entry has a descriptor entry. This is used to manage the hash table link chains.
+    Entries are stored in insertion order and are iterated in that order by hashFirst and hashNext. Tables grow
+    automatically. Adding a new entry may move existing entries, so entry references should not be retained across
+    calls to hashEnter.
     @see hashCreate hashFree hashLookup hashEnter hashDelete hashWalk hashFirst hashNext
     @defgroup WebsHash WebsHash
  */
 typedef struct WebsKey {
-    struct WebsKey  *forw;                  /* Pointer to next hash list */
     WebsValue       name;                   /* Name of symbol */
     WebsValue       content;                /* Value of symbol */
     int             arg;                    /* Parameter value */
-    int             bucket;                 /* Bucket index */
+    uint            hash;                   /* Cached hash code of the name */
 } WebsKey;
 
 /**
@@ -734,6 +877,14 @@ PUBLIC WebsHash hashCreate(int size);
  */
 PUBLIC void hashFree(WebsHash id);
 
+/**
+    Remove all keys from a hash table
+    @description The hash table remains valid and may be reused.
+    @param id Hash table id returned by hashCreate
+    @ingroup WebsHash
+ */
+PUBLIC void hashClear(WebsHash id);
+
 /**
     Lookup a name in the hash table
     @param id Hash table id returned by hashCreate
@@ -796,6 +947,10 @@ PUBLIC WebsKey *hashNext(WebsHash id, WebsKey *last);
 #define SOCKET_BUFFERED_READ    0x200   /**< Message pending on this socket */
 #define SOCKET_BUFFERED_WRITE   0x400   /**< Message pending on this socket */
 #define SOCKET_NODELAY          0x800   /**< Disable Nagle algorithm */
+#define SOCKET_QUEUED           0x1000  /**< Socket is queued for service by the event notifier */
+#define SOCKET_EDGE             0x2000  /**< Socket is registered for edge-triggered events */
+#define SOCKET_REUSEPORT        0x4000  /**< Permit multiple listeners on the same endpoint */
+#define SOCKET_PIPE             0x8000  /**< Handle is a pipe or other non-socket file descriptor */
 
 #define SOCKET_PORT_MAX         0xffff  /* Max Port size */
 
@@ -859,6 +1014,7 @@ typedef struct WebsSocket {
     int             fileHandle;         /**< ID of the file handler */
     int             interestEvents;     /**< Mask of events to watch for */
     int             currentEvents;      /**< Mask of ready events (FD_xx) */
+    int             readyEvents;        /**< Edge-triggered readiness not yet consumed by I/O */
     int             selectEvents;       /**< Events being selected */
     int             saveMask;           /**< saved Mask for socketFlush */
     int             error;              /**< Last error */
@@ -903,6 +1059,18 @@ PUBLIC bool socketAddressIsV6(char *ip);
  */
 PUBLIC int socketAlloc(char *host, int port, SocketAccept accept, int flags);
 
+#if ME_UNIX_LIKE
+/**
+    Attach a pipe or other file descriptor so it can be serviced by the event loop
+    @description The descriptor is put into non-blocking mode. It may then be used with socketCreateHandler,
+        socketRead and socketWrite. The descriptor is closed by socketFree.
+    @param fd Open file descriptor
+    @return Socket ID handle to use with other APIs. Returns -1 if the socket object cannot be allocated.
+    @ingroup WebsSocket
+ */
+PUBLIC int socketAttach(int fd);
+#endif
+
 /**
     Close the socket module
     @ingroup WebsSocket
@@ -1161,6 +1329,34 @@ PUBLIC int socketWaitForEvent(WebsSocket *sp, int mask);
  */
 PUBLIC ssize socketWrite(int sid, void *buf, ssize len);
 
+#if ME_UNIX_LIKE
+/**
+    Write a vector of buffers to the socket with a single gathering write
+    @param sid Socket ID handle returned from socketConnect or socketAccept.
+    @param iov Array of buffer descriptors
+    @param count Number of elements in iov
+    @return Count of bytes written. May be less than the total length if the socket is in non-blocking mode.
+        Returns -1 for errors.
+    @ingroup WebsSocket
+ */
+PUBLIC ssize socketWritev(int sid, struct iovec *iov, int count);
+#endif
+
+#if WEBS_SENDFILE
+/**
+    Write file data to the socket without copying via a user buffer
+    @description This writes from the given file position and does not modify the file position.
+    @param sid Socket ID handle returned from socketConnect or socketAccept.
+    @param fd Open file descriptor
+    @param pos File position of the data to write
+    @param len Number of bytes to write
+    @return Count of bytes written. May be less than len if the socket is in non-blocking mode.
+        Returns -1 for errors or if the file ends before len bytes are written.
+    @ingroup WebsSocket
+ */
+PUBLIC ssize socketSendFile(int sid, int fd, Offset pos, ssize len);
+#endif
+
 /**
     Return the socket object for the socket ID.
     @param sid Socket ID handle returned from socketConnect or socketAccept.
@@ -1480,12 +1676,29 @@ PUBLIC void websRestartEvent(int id, int delay);
 
 /**
     Run due events
+    @description Events are kept in a heap ordered by due time so only due events are visited.
     @ingroup WebsRuntime
-    @return Time till the next event
+    @return Time till the next event in milliseconds
     @internal
  */
 PUBLIC WebsTime websRunEvents();
 
+/**
+    Get the cached monotonic time
+    @description The time is cached and updated each time the event loop wakes. This avoids a system call for each 
+        use. Use websUpdateTicks to read the clock.
+    @return Monotonic time in milliseconds
+    @ingroup WebsRuntime
+ */
+PUBLIC WebsTicks websGetTicks();
+
+/**
+    Read the monotonic clock and update the cached time returned by websGetTicks
+    @return Monotonic time in milliseconds
+    @ingroup WebsRuntime
+ */
+PUBLIC WebsTicks websUpdateTicks();
+
 /* Forward declare */
 struct WebsRoute;
 struct WebsUser;
@@ -1521,6 +1734,30 @@ PUBLIC void websUploadOpen();
  */
 PUBLIC WebsHash websGetUpload(struct Webs *wp);
 
+/**
+    Callback to receive uploaded file data
+    @description The callback is invoked with blocks of file data as they arrive. It is invoked with null data and
+        a zero length when the file is complete and with a length of -1 if the request fails before the file is 
+        complete.
+    @param wp Webs request object
+    @param up Upload object for the file. The filename is null as no temp file is created.
+    @param data File data
+    @param len Length of data
+    @return Zero if successful, otherwise -1 to fail the request.
+    @ingroup WebsUpload
+ */
+typedef int (*WebsUploadProc)(struct Webs *wp, WebsUpload *up, char *data, ssize len);
+
+/**
+    Define a callback to receive uploaded file data
+    @description By default, uploaded files are written to temp files in the upload directory. If a callback is
+        defined, file data is passed to the callback instead and temp files are not created.
+    @param proc Callback procedure. Set to null to restore the default.
+    @return The prior callback
+    @ingroup WebsUpload
+ */
+PUBLIC WebsUploadProc websSetUploadProc(WebsUploadProc proc);
+
 /**
     Open the file upload filter
     @param wp Webs request object
@@ -1546,12 +1783,16 @@ PUBLIC WebsUpload *websLookupUpload(struct Webs *wp, char *key);
     Request flags
  */
 #define WEBS_ACCEPTED           0x1         /**< TLS connection accepted */
+#define WEBS_ACCEPT_GZIP        0x10000     /**< Client accepts gzip content encoding */
 #define WEBS_CHUNKING           0x2         /**< Currently chunking output body data */
 #define WEBS_CLOSED             0x4         /**< Connection closed, ready to free */
 #define WEBS_COOKIE             0x8         /**< Cookie supplied in request */
 #define WEBS_FINALIZED          0x10        /**< Output is finalized */
 #define WEBS_FORM               0x20        /**< Request is a form (url encoded data) */
+#define WEBS_GZIP               0x80000     /**< Response body is gzip encoded */
+#define WEBS_GZIP_PENDING       0x100000    /**< Dynamic response may be compressed when the body is flushed */
 #define WEBS_HEADERS_CREATED    0x40        /**< Headers have been created and buffered */
+#define WEBS_HEADER_VARS        0x200000    /**< HTTP_* header variables have been defined */
 #define WEBS_HTTP11             0x80        /**< Request is using HTTP/1.1 */
 #define WEBS_JSON               0x100       /**< Request has a JSON payload */
 #define WEBS_KEEP_ALIVE         0x200       /**< HTTP/1.1 keep alive */
@@ -1560,6 +1801,7 @@ PUBLIC WebsUpload *websLookupUpload(struct Webs *wp, char *key);
 #define WEBS_SECURE             0x1000      /**< Connection uses SSL */
 #define WEBS_UPLOAD             0x2000      /**< Multipart-mime file upload */
 #define WEBS_VARS_ADDED         0x4000      /**< Query and body form vars added */
+#define WEBS_VARY_ENCODING      0x400000    /**< Response encoding depends on the Accept-Encoding header */
 #if ME_GOAHEAD_LEGACY
 #define WEBS_LOCAL              0x8000      /**< Request from local system */
 #endif
@@ -1598,6 +1840,41 @@ PUBLIC WebsUpload *websLookupUpload(struct Webs *wp, char *key);
  */
 typedef void (*WebsWriteProc)(struct Webs *wp);
 
+/**
+    Request header. The name is lower case. The name and value reference the request header block.
+    @ingroup Webs
+ */
+typedef struct WebsHeader {
+    char            *name;              /**< Header name */
+    char            *value;             /**< Header value */
+} WebsHeader;
+
+/**
+    Callback to release the memory referenced by an output segment once it has been written
+    @param arg Argument supplied to websWriteReference
+    @ingroup Webs
+ */
+typedef void (*WebsReleaseProc)(void *arg);
+
+/**
+    Output segment. The response is a chain of segments that is written with scatter/gather I/O. A segment is 
+    either a data block with storage following the segment header, a reference to memory owned by the caller, 
+    or a range of an open file.
+    @ingroup Webs
+ */
+typedef struct WebsBlock {
+    struct WebsBlock *next;             /**< Next segment in the chain */
+    char            *start;             /**< Start of unwritten data */
+    char            *end;               /**< End of data */
+    char            *limit;             /**< End of the block storage. Equal to end if data cannot be appended */
+    WebsReleaseProc release;            /**< Callback to release referenced memory */
+    void            *arg;               /**< Argument for the release callback */
+    Offset          pos;                /**< File position of unwritten file data */
+    ssize           count;              /**< Length of unwritten file data */
+    int             fd;                 /**< File descriptor for file segments. Otherwise -1 */
+    bool            close;              /**< Close the file once written */
+} WebsBlock;
+
 /**
     GoAhead request structure. This is a per-socket connection structure.
     @defgroup Webs Webs
@@ -1605,12 +1882,15 @@ typedef void (*WebsWriteProc)(struct Webs *wp);
 typedef struct Webs {
     WebsBuf         rxbuf;              /**< Raw receive buffer */
     WebsBuf         input;              /**< Receive buffer after de-chunking */
-    WebsBuf         output;             /**< Transmit buffer after chunking */
-    WebsBuf         chunkbuf;           /**< Pre-chunking data buffer */
+    WebsBlock       *txq;               /**< Chain of output segments awaiting transmission */
+    WebsBlock       *txqTail;           /**< Last output segment */
+    ssize           txqLen;             /**< Length of output data held in memory */
+    WebsBlock       *txChunk;           /**< Prefix segment of the open transmit chunk */
+    ssize           txPending;          /**< Data written since the last flush. The open chunk length if chunking */
     WebsBuf         *txbuf;
-    WebsTime        since;              /**< Parsed if-modified-since time */
+    WebsTime        since;              /**< Parsed if-modified-since time. Set on demand by the file handler */
     WebsHash        vars;               /**< CGI standard variables */
-    WebsTime        timestamp;          /**< Last transaction with browser */
+    WebsTicks       timestamp;          /**< Last transaction with browser (msec ticks) */
     int             timeout;            /**< Timeout handle */
     char            ipaddr[64];         /**< Connecting ipaddress */
     char            ifaddr[64];         /**< Local interface ipaddress */
@@ -1619,37 +1899,44 @@ typedef struct Webs {
     ssize           rxChunkSize;        /**< Rx chunk size */
     char            *rxEndp;            /**< Pointer to end of raw data in input beyond endp */
     ssize           lastRead;           /**< Number of bytes last read from the socket */
+    ssize           rxScan;             /**< Bytes of rxbuf already scanned for the end of the headers */
+    int             pipelined;          /**< Completed pipelined responses awaiting a coalesced write */
     bool            eof;                /**< If at the end of the request content */
 
-    char            txChunkPrefix[16];  /**< Transmit chunk prefix */
-    char            *txChunkPrefixNext; /**< Current I/O pos in txChunkPrefix */
-    ssize           txChunkPrefixLen;   /**< Length of prefix */
-    ssize           txChunkLen;         /**< Length of the chunk */
-    int             txChunkState;       /**< Transmit chunk state */
+    char            *arena;             /**< Per-request arena for request strings */
+    ssize           arenaUsed;          /**< Bytes used in the arena */
+    void            *arenaBlocks;       /**< Overflow arena blocks */
+    WebsHeader      *headers;           /**< Request headers. The header block text follows the array */
+    int             headerCount;        /**< Number of request headers */
 
-    char            *authDetails;       /**< Http header auth details */
+    char            *authDetails;       /**< Http header auth details. In the request arena. Do not free. */
     char            *authResponse;      /**< Outgoing auth header */
-    char            *authType;          /**< Authorization type (Basic/DAA) */
-    char            *contentType;       /**< Body content type */
-    char            *cookie;            /**< Request cookie string */
-    char            *decodedQuery;      /**< Decoded request query */
+    char            *authType;          /**< Authorization type (Basic/DAA). In the request arena. Do not free. */
+    char            *contentType;       /**< Body content type. In the request arena. Do not free. */
+    char            *cookie;            /**< Request cookie string. In the request arena. Do not free. */
+    char            *decodedQuery;      /**< Decoded request query. In the request arena. Do not free. */
     char            *digest;            /**< Password digest */
-    char            *ext;               /**< Path extension */
+    char            *ext;               /**< Path extension. In the request arena. Do not free. */
     char            *filename;          /**< Document path name */
-    char            *host;              /**< Requested host */
+    char            *host;              /**< Requested host. In the request arena. Do not free. */
+    char            *ifModifiedSince;   /**< If-Modified-Since header value. In the request arena. Do not free. */
+    char            *ifNoneMatch;       /**< If-None-Match header value. In the request arena. Do not free. */
+    char            *ifRange;           /**< If-Range header value. In the request arena. Do not free. */
     char            *inputFile;         /**< File name to write input body data */
-    char            *method;            /**< HTTP request method */
+    char            *method;            /**< HTTP request method. In the request arena. Do not free. */
     char            *password;          /**< Authorization password */
     char            *path;              /**< Path name without query. This is decoded. */
-    char            *protoVersion;      /**< Protocol version (HTTP/1.1)*/
+    char            *protoVersion;      /**< Protocol version (HTTP/1.1). In the request arena. Do not free. */
     char            *protocol;          /**< Protocol scheme (normally http|https) */
     char            *putname;           /**< PUT temporary filename */
-    char            *query;             /**< Request query. This is decoded. */
+    char            *query;             /**< Request query. This is decoded. In the request arena. Do not free. */
+    char            *range;             /**< Range header value. In the request arena. Do not free. */
+    char            *rangeBoundary;     /**< Boundary for multipart/byteranges responses */
     char            *realm;             /**< Realm field supplied in auth header */
-    char            *referrer;          /**< The referring page */
+    char            *referrer;          /**< The referring page. In the request arena. Do not free. */
     char            *responseCookie;    /**< Outgoing cookie */
-    char            *url;               /**< Full request url. This is not decoded. */
-    char            *userAgent;         /**< User agent (browser) */
+    char            *url;               /**< Full request url. This is not decoded. In the request arena. Do not free. */
+    char            *userAgent;         /**< User agent (browser). In the request arena. Do not free. */
     char            *username;          /**< Authorization username */
 
     int             sid;                /**< Socket id (handler) */
@@ -1664,13 +1951,26 @@ typedef struct Webs {
     ssize           txLen;              /**< Tx content length header value */
     int             wid;                /**< Index into webs */
 #if ME_GOAHEAD_CGI
-    char            *cgiStdin;          /**< Filename for CGI program input */
-    int             cgifd;              /**< File handle for CGI program input */
+    char            *cgiStdin;          /**< Filename for CGI program input (not used on Unix) */
+    int             cgifd;              /**< File handle for CGI program input (not used on Unix) */
+#endif
+#if WEBS_FASTCGI
+    void            *fastcgi;           /**< Active FastCGI request */
+#endif
+#if ME_GOAHEAD_JAVASCRIPT
+    void            *jst;               /**< Javascript page being rendered */
 #endif
 #if !ME_ROM
     int             putfd;              /**< File handle to write PUT data */
+#endif
+#if WEBS_COMPRESS
+    void            *zstream;           /**< Deflate stream for compressed output */
 #endif
     int             docfd;              /**< File descriptor for document being served */
+    void            *cached;            /**< File cache entry for document being served */
+    struct WebsRange *ranges;           /**< Byte ranges to serve */
+    int             rangeCount;         /**< Number of byte ranges */
+    Offset          rangeSize;          /**< Complete document length for Content-Range */
     ssize           written;            /**< Bytes actually transferred */
     ssize           putLen;             /**< Bytes read by a PUT request */
 
@@ -1690,8 +1990,10 @@ typedef struct Webs {
 #if ME_GOAHEAD_UPLOAD
     int             upfd;               /**< Upload file handle */
     WebsHash        files;              /**< Uploaded files */
-    char            *boundary;          /**< Mime boundary (static) */
-    ssize           boundaryLen;        /**< Boundary length */
+    char            *boundary;          /**< Mime boundary delimiter including the leading "\r\n" */
+    ssize           boundaryLen;        /**< Boundary delimiter length */
+    uchar           *boundarySkip;      /**< Boyer-Moore-Horspool skip table for the boundary delimiter */
+    ssize           uploadScan;         /**< Offset of part data in the input not yet searched for the boundary */
     int             uploadState;        /**< Current file upload state */
     WebsUpload      *currentFile;       /**< Current file context */
     char            *clientFilename;    /**< Current file filename */
@@ -1770,8 +2072,18 @@ typedef struct WebsFileInfo {
     ulong           size;                   /**< File length */
     int             isDir;                  /**< Set if directory */
     WebsTime        mtime;                  /**< Modified time */
+    ulong           inode;                  /**< File inode. ROM documents use a content hash */
 } WebsFileInfo;
 
+/**
+    Byte range of a document
+    @ingroup Webs
+ */
+typedef struct WebsRange {
+    Offset          start;                  /**< Start offset */
+    Offset          end;                    /**< End offset (exclusive) */
+} WebsRange;
+
 /**
     Compiled Rom Page Index
     @ingroup Webs
@@ -1818,6 +2130,25 @@ PUBLIC void websActionOpen();
  */
 PUBLIC int websAlloc(int sid);
 
+/**
+    Allocate memory from the request arena
+    @description The arena memory is released in one step when the request completes. It must not be freed via wfree.
+    @param wp Webs request object
+    @param size Size of the memory block to allocate
+    @return Allocated memory block or null if the memory cannot be allocated.
+    @ingroup Webs
+ */
+PUBLIC void *websArenaAlloc(Webs *wp, ssize size);
+
+/**
+    Clone a string into the request arena
+    @param wp Webs request object
+    @param str String to clone. If null, an empty string is returned.
+    @return Cloned string that is valid until the request completes. Caller should not free.
+    @ingroup Webs
+ */
+PUBLIC char *websArenaClone(Webs *wp, char *str);
+
 /**
     Cancel the request timeout.
     @description Handlers may choose to manually manage the request timeout. This routine will disable the
@@ -1835,6 +2166,17 @@ PUBLIC void websCancelTimeout(Webs *wp);
  */
 PUBLIC int websCgiOpen();
 
+#if ME_UNIX_LIKE
+/**
+    Abandon the CGI program for a request
+    @description Called when a request is terminated before its CGI program has completed. The program is killed
+        and its output is discarded.
+    @param wp Webs request object
+    @ingroup Webs
+ */
+PUBLIC void websCgiAbort(Webs *wp);
+#endif
+
 /**
     CGI handler service callback
     @param wp Webs object
@@ -1845,10 +2187,23 @@ PUBLIC int websCgiHandler(Webs *wp);
 
 /**
     Poll for output from CGI processes and output.
+    @description On Unix, CGI programs are connected via pipes that are serviced by the socket event loop and
+        there is nothing to poll. Other systems poll temporary files for output.
     @return Time delay till next poll
     @ingroup Webs
  */
 PUBLIC WebsTime websCgiPoll();
+
+#if WEBS_FASTCGI
+/**
+    Abandon the FastCGI request for a connection
+    @description Called when a request is terminated before its FastCGI program has completed it. The program is
+        sent an abort request and its output for the request is discarded.
+    @param wp Webs request object
+    @ingroup Webs
+ */
+PUBLIC void websFastCgiAbort(Webs *wp);
+#endif
 #endif /* ME_GOAHEAD_CGI */
 
 /**
@@ -1987,12 +2342,14 @@ PUBLIC char *websErrorMsg(int code);
 PUBLIC void websFileOpen();
 
 /**
-    Flush buffered transmit data and compact the transmit buffer to make room for more data
+    Flush buffered transmit data
+    @description The chain of output segments is written to the socket using scatter/gather writes. File segments
+        are written with sendfile where supported.
     @param wp Webs request object
     @param block Set to true to wait for all data to be written to the socket. Set to false to 
         write whatever the socket can absorb without blocking. 
-    @return -1 for I/O errors. Zero if there is more data remaining in the buffer. Return 1 if the 
-    contents of the transmit buffer are fully written and the buffer is now empty.
+    @return -1 for I/O errors. Zero if there is more data remaining to be written. Return 1 if all the 
+        output has been written to the socket.
     @ingroup Webs
  */
 PUBLIC int websFlush(Webs *wp, bool block);
@@ -2090,6 +2447,16 @@ PUBLIC char *websGetExt(Webs *wp);
  */
 PUBLIC char *websGetFilename(Webs *wp);
 
+/**
+    Get a request HTTP header value
+    @param wp Webs request object
+    @param name Header name. The name is matched without regard to case.
+    @return Header value string or null if the header is not present. If the header is repeated, the last value is
+        returned. Caller should not free.
+    @ingroup Webs
+ */
+PUBLIC char *websGetHeader(Webs *wp, char *name);
+
 /**
     Get the request host
     @description The request host is set to the Host HTTP header value if it is present. Otherwise it is set to 
@@ -2124,6 +2491,15 @@ PUBLIC char *websGetIndex();
  */
 PUBLIC char *websGetMethod(Webs *wp);
 
+/**
+    Get the mime type for the request document
+    @description The mime type is determined from the request path extension.
+    @param wp Webs request object
+    @return Mime type string if known, otherwise null. Caller should not free.
+    @ingroup Webs
+ */
+PUBLIC char *websGetMimeType(Webs *wp);
+
 /**
     Get the request password
     @description The request password may be encoded depending on the authentication scheme. 
@@ -2221,6 +2597,13 @@ PUBLIC char *websGetUrl(Webs *wp);
  */
 PUBLIC char *websGetUserAgent(Webs *wp);
 
+/**
+    Get the number of worker processes
+    @return The configured number of worker processes. Zero if requests are served by the main process.
+    @ingroup Webs
+ */
+PUBLIC int websGetWorkers();
+
 /**
     Get the request username
     @description If the request is authenticated, this call returns the username supplied during authentication.
@@ -2405,6 +2788,14 @@ PUBLIC void websPageSeek(Webs *wp, Offset offset, int origin);
  */
 PUBLIC int websPageStat(Webs *wp, WebsFileInfo *sbuf);
 
+/**
+    Parse an HTTP date string
+    @param value Date string as used by HTTP headers such as If-Modified-Since
+    @return Time in seconds since 1970, or zero if the date cannot be parsed.
+    @ingroup Webs
+ */
+PUBLIC WebsTime websParseDate(char *value);
+
 #if !ME_ROM
 /**
     Process request PUT body data
@@ -2473,6 +2864,18 @@ PUBLIC void websRedirect(Webs *wp, char *url);
  */
 PUBLIC int websRedirectByStatus(Webs *wp, int status);
 
+/**
+    Release the file cache entry held by a request
+    @description This is called when the request document is closed. Cached content that has been evicted
+        is freed when the last request using it is released.
+    @param wp Webs request object
+    @ingroup Webs
+    @internal
+ */
+#if WEBS_FILE_CACHE
+PUBLIC void websReleaseCachedFile(Webs *wp);
+#endif
+
 /**
     Create and send a request response
     @description This creates a response for the current request using the specified HTTP status code and 
@@ -2518,6 +2921,27 @@ PUBLIC void websFsClose();
  */
 PUBLIC Offset websSeekFile(int fd, Offset offset, int origin);
 
+#if ME_UNIX_LIKE
+/**
+    Start worker processes
+    @description If the number of workers defined via websSetWorkers is greater than one, this starts the worker 
+        processes. Each worker must then call websOpen, websListen and websServiceEvents to run its own event loop. 
+        Listen sockets are opened with SO_REUSEPORT so that the kernel distributes connections across workers.
+        The calling process supervises the workers and restarts workers that die unexpectedly. This must be 
+        called before websOpen.
+        \n\n
+        Sessions are stored in each worker and are not shared. As a client's connections may be served by different
+        workers, session state may be lost. Routes using form authentication, which requires sessions, are refused 
+        when workers are configured.
+    @param finished Integer location to test. If set to true, the workers are sent SIGTERM and the call returns 
+        when they have exited.
+    @return Zero in each worker process. In the supervising process, returns 1 when all workers have exited,
+        or -1 if the workers could not be started or exited with an error.
+    @ingroup Webs
+ */
+PUBLIC int websStartWorkers(int *finished);
+#endif
+
 /**
     Get file status for a file
     @param path Filename path
@@ -2553,8 +2977,25 @@ PUBLIC void websServiceEvents(int *finished);
  */
 PUBLIC void websSetBackground(int on);
 
+/**
+    Write a range of a file to the response
+    @description The file data is not read into memory. It is written to the socket with sendfile where supported
+        and otherwise read as the socket becomes writable. The file must not be truncated before it is written.
+    @param wp Webs request object
+    @param fd File descriptor returned by websOpenFile
+    @param pos File position of the data to write
+    @param len Length of data to write
+    @param close Set to true to pass ownership of fd to the output. The file is closed via websCloseFile when
+        it has been written or if this routine fails.
+    @return Count of bytes written or -1.
+    @ingroup Webs
+ */
+PUBLIC ssize websSendFile(Webs *wp, int fd, Offset pos, ssize len, bool close);
+
 /**
     Define a background write I/O event callback
+    @description The callback is invoked when the socket is writable and all buffered and queued output has 
+        been written.
     @param wp Webs request object
     @param proc Write callback
  */
@@ -2613,6 +3054,16 @@ PUBLIC void websSetEnv(Webs *wp);
  */
 PUBLIC void websSetFormVars(Webs *wp);
 
+/**
+    Create request variables for the HTTP headers
+    @description This defines a CGI style HTTP_* variable for each request header. The variables are created on demand
+        by websSetEnv, websGetVar and the JST handler rather than when the request is parsed.
+        Existing variables are not overwritten.
+    @param wp Webs request object
+    @ingroup Webs
+ */
+PUBLIC void websSetHeaderVars(Webs *wp);
+
 /**
     Define the host name for the server
     @param host String host name
@@ -2682,6 +3133,16 @@ PUBLIC void websSetVarFmt(Webs *wp, char *name, char *fmt, ...);
  */
 PUBLIC void websSetVar(Webs *wp, char *name, char *value);
 
+/**
+    Set the number of worker processes
+    @description If set to more than one, websStartWorkers will start this number of worker processes that each 
+        run their own event loop and listen on the same endpoints. Sessions are not shared between workers, so
+        form authentication cannot be used with workers.
+    @param count Number of worker processes. Set to zero to serve requests in the main process.
+    @ingroup Webs
+ */
+PUBLIC void websSetWorkers(int count);
+
 /**
     Test if  a request variable is defined
     @param wp Webs request object
@@ -2787,6 +3248,17 @@ PUBLIC void websWriteEndHeaders(Webs *wp);
  */
 PUBLIC int websWriteHeader(Webs *wp, char *key, char *fmt, ...);
 
+/**
+    Test if writing more response data would block
+    @description Response output is queued without blocking. Handlers that generate large responses should stop
+        writing when this returns true and resume from a background writer callback. See websSetBackgroundWriter.
+        A request that queues more than ME_GOAHEAD_LIMIT_TX_QUEUE bytes fails and its connection is closed.
+    @param wp Webs request object
+    @return True if the pending output has reached ME_GOAHEAD_LIMIT_TX_HIGH_WATER.
+    @ingroup Webs
+ */
+PUBLIC bool websWouldBlock(Webs *wp);
+
 /**
     Write data to the response
     @description The data is buffered and will be sent to the client when the buffer is full or websFlush is
@@ -2811,8 +3283,12 @@ PUBLIC ssize websWriteFile(int fd, char *buf, ssize size);
 
 /**
     Write a block of data to the response
-    @description The data is buffered and will be sent to the client when the buffer is full or websFlush is
-        called. This routine will never return "short", it will always write all the data unless there are errors.
+    @description The data is copied to the output and will be sent to the client when sufficient data is buffered
+        or websFlush is called. This routine will never return "short", it will always write all the data unless 
+        there are errors. Output is written as the socket becomes writable, so this routine does not block. If more
+        than ME_GOAHEAD_LIMIT_TX_QUEUE bytes are queued, the request fails and the connection is closed. Handlers 
+        that generate large responses should test websWouldBlock and use websSetBackgroundWriter to resume once the
+        output has drained.
     @param wp Webs request object
     @param buf Buffer of data to write
     @param size Length of buf
@@ -2821,6 +3297,20 @@ PUBLIC ssize websWriteFile(int fd, char *buf, ssize size);
  */
 PUBLIC ssize websWriteBlock(Webs *wp, char *buf, ssize size);
 
+/**
+    Write a block of data to the response without copying
+    @description The memory is referenced by the output until it has been written to the client. The release
+        callback is then invoked. The memory must not be modified before it is released.
+    @param wp Webs request object
+    @param buf Buffer of data to write
+    @param size Length of buf
+    @param release Callback to invoke when the output no longer references buf. Set to null if the memory is static.
+    @param arg Argument to pass to the release callback
+    @return Count of bytes written or -1. The release callback is invoked even if this routine fails.
+    @ingroup Webs
+ */
+PUBLIC ssize websWriteReference(Webs *wp, char *buf, ssize size, WebsReleaseProc release, void *arg);
+
 /**
     Write a block of data to the network
     @description This bypassed output buffering and is the lowest level write.
@@ -2883,6 +3373,15 @@ typedef int (*WebsJstProc)(int jid, Webs *wp, int argc, char **argv);
  */
 PUBLIC int websDefineJst(char *name, WebsJstProc fn);
 
+/**
+    Abandon rendering a Javascript page
+    @description Called when a request is terminated while rendering of its page is suspended waiting for the
+        client to absorb the output. The Javascript engine and page reference are released.
+    @param wp Webs request object
+    @ingroup Webs
+ */
+PUBLIC void websJstAbort(Webs *wp);
+
 /**
     Open the Javascript module.
     @return Zero if successful, otherwise -1.
@@ -2953,6 +3452,29 @@ PUBLIC ssize sslRead(Webs *wp, void *buf, ssize len);
     @ingroup Webs
  */
 PUBLIC ssize sslWrite(Webs *wp, void *buf, ssize len);
+
+#if ME_COM_EST
+/**
+    TLS session resumption statistics
+    @ingroup Webs
+ */
+typedef struct WebsSslStats {
+    int         hits;                   /**< Handshakes resumed from the session cache */
+    int         misses;                 /**< Session IDs presented by clients that were not in the cache */
+    int         evictions;              /**< Live sessions replaced in the cache by new sessions */
+    int         cached;                 /**< Live sessions in the cache */
+    int         ticketHits;             /**< Handshakes resumed from a session ticket */
+    int         ticketMisses;           /**< Session tickets that were invalid, expired or had an unknown key */
+    int         ticketsIssued;          /**< Session tickets issued to clients */
+} WebsSslStats;
+
+/**
+    Get TLS session resumption statistics
+    @param stats Reference to a statistics structure to fill
+    @ingroup Webs
+ */
+PUBLIC void sslStats(WebsSslStats *stats);
+#endif
 #endif /* ME_COM_SSL */
 
 /*************************************** Route *********************************/
@@ -11,16 +11,30 @@
 
 #include    "goahead.h"
 
+#if WEBS_COMPRESS
+    #include    <zlib.h>
+#endif
+
 /*********************************** Globals **********************************/
 
 static int websBackground;              /* Run as a daemon */
 static int websDebug;                   /* Run in debug mode and defeat timeouts */
+static int websWorkers = ME_GOAHEAD_WORKERS;    /* Number of worker processes */
 static int defaultHttpPort;             /* Default port number for http */
 static int defaultSslPort;              /* Default port number for https */
 
 #define WEBS_TIMEOUT (ME_GOAHEAD_LIMIT_TIMEOUT * 1000)
 #define PARSE_TIMEOUT (ME_GOAHEAD_LIMIT_PARSE_TIMEOUT * 1000)
-#define CHUNK_LOW   128                 /* Low water mark for chunking */
+#define WEBS_TX_BLOCK   8192            /* Minimum size of output data blocks */
+#define WEBS_TX_COPY    512             /* Referenced data smaller than this is copied */
+#define WEBS_TX_IOVEC   32              /* Maximum segments per gathering write */
+#define WEBS_TX_STAGE   16384           /* Staging buffer size for TLS records and file reads */
+#define WEBS_CHUNK_PREFIX 24            /* Room for a transmit chunk prefix "\r\nSize\r\n" */
+#if WEBS_COMPRESS
+    #define COMPRESSING(wp) ((wp)->zstream != 0)
+#else
+    #define COMPRESSING(wp) 0
+#endif
 
 /************************************ Locals **********************************/
 
@@ -28,7 +42,17 @@ static int          listens[WEBS_MAX_LISTEN];   /* Listen endpoints */;
 static int          listenMax;
 static Webs         **webs;                     /* Open connection list head */
 static WebsHash     websMime;                   /* Set of mime types */
+#if defined(ME_GOAHEAD_CLIENT_CACHE)
+static char         clientCacheHeader[64];      /* Pre-rendered Cache-Control header for cached extensions */
+static ssize        clientCacheHeaderLen;
+#endif
 static int          websMax;                    /* List size */
+static char         txStage[WEBS_TX_STAGE];     /* Staging buffer for batched TLS writes and file reads */
+#if WEBS_COMPRESS
+static char         gzipHeaders[] = "Content-Encoding: gzip\r\n";
+#endif
+static Webs         **websPool;                 /* Idle request objects for reuse */
+static int          websPoolCount;              /* Number of idle request objects */
 static char         websHost[64];               /* Host name for the server */
 static char         websIpAddr[64];             /* IP address for the server */
 static char         *websHostUrl = NULL;        /* URL to access server */
@@ -176,8 +200,10 @@ static WebsError websErrors[] = {
     { 406, "Not Acceptable" },
     { 408, "Request Timeout" },
     { 413, "Request too large" },
+    { 416, "Range Not Satisfiable" },
     { 500, "Internal Server Error" },
     { 501, "Not Implemented" },
+    { 502, "Bad Gateway" },
     { 503, "Service Unavailable" },
     { 0, NULL }
 };
@@ -193,22 +219,43 @@ static int      pruneId;                            /* Callback ID */
 
 /**************************** Forward Declarations ****************************/
 
+static bool     acceptGzip(char *value);
+static void     appendBlock(Webs *wp, WebsBlock *bp);
+static WebsBlock *allocBlock(ssize size);
+static int      autoFlush(Webs *wp);
+static bool     canCoalesce(Webs *wp);
 static void     checkTimeout(void *arg, int id);
+static void     closeChunk(Webs *wp);
+static void     consumeOutput(Webs *wp, ssize written);
 static WebsTime dateParse(WebsTime tip, char *cmd);
 static bool     filterChunkData(Webs *wp);
+static void     finishChunks(Webs *wp);
+static void     flushPipeline(Webs *wp);
+static void     freeBlock(WebsBlock *bp);
+static void     freeQueue(Webs *wp);
+static void     freeWebs(Webs *wp);
 static WebsTime getTimeSinceMark(Webs *wp);
 static char     *getToken(Webs *wp, char *delim);
+static int      openChunk(Webs *wp);
 static void     parseFirstLine(Webs *wp);
-static void     parseHeaders(Webs *wp);
+static void     parseHeaders(Webs *wp, char *end);
 static bool     processContent(Webs *wp);
 static bool     parseIncoming(Webs *wp);
 static void     pruneCache();
+static int      putOutput(Webs *wp, char *buf, ssize size);
 static void     readEvent(Webs *wp);
 static void     reuseConn(Webs *wp);
 static void     setFileLimits();
 static int      setLocalHost();
 static void     socketEvent(int sid, int mask, void *data);
 static void     writeEvent(Webs *wp);
+static ssize    writeFileSegment(Webs *wp, WebsBlock *bp);
+static ssize    writeSegments(Webs *wp);
+static ssize    writeSocket(Webs *wp, char *buf, ssize len);
+#if WEBS_COMPRESS
+static int      compressData(Webs *wp, char *buf, ssize len, int flush);
+static void     startCompress(Webs *wp);
+#endif
 #if ME_GOAHEAD_ACCESS_LOG
 static void     logRequest(Webs *wp, int code);
 #endif
@@ -221,6 +268,10 @@ PUBLIC int websOpen(char *documents, char *routeFile)
 
     webs = NULL;
     websMax = 0;
+    websPoolCount = 0;
+    if ((websPool = walloc(sizeof(Webs*) * max(ME_GOAHEAD_LIMIT_WEBS_POOL, 1))) == 0) {
+        return -1;
+    }
 
     websOsOpen();
     websRuntimeOpen();
@@ -276,6 +327,31 @@ PUBLIC int websOpen(char *documents, char *routeFile)
     for (mt = websMimeList; mt->type; mt++) {
         hashEnter(websMime, mt->ext, valueString(mt->type, 0), 0);
     }
+#if defined(ME_GOAHEAD_CLIENT_CACHE)
+    /*
+        Flag the extensions that clients may cache in the mime table so a single lookup serves both headers.
+        Extensions without a mime type get a non-string placeholder entry.
+     */
+    {
+        WebsKey     *key;
+        char        *list, *ext, *tok, *dext;
+
+        list = sclone(ME_GOAHEAD_CLIENT_CACHE);
+        for (ext = stok(list, ", \t", &tok); ext; ext = stok(NULL, ", \t", &tok)) {
+            dext = sfmt(".%s", ext);
+            if ((key = hashLookup(websMime, dext)) != 0) {
+                key->arg = 1;
+            } else {
+                hashEnter(websMime, dext, valueInteger(0), 1);
+            }
+            wfree(dext);
+        }
+        wfree(list);
+        fmt(clientCacheHeader, sizeof(clientCacheHeader), "Cache-Control: public, max-age=%d\r\n",
+            ME_GOAHEAD_CLIENT_CACHE_LIFESPAN);
+        clientCacheHeaderLen = slen(clientCacheHeader);
+    }
+#endif
 
 #if ME_GOAHEAD_ACCESS_LOG && !ME_ROM
     if ((accessFd = open(accessLog, O_CREAT | O_TRUNC | O_APPEND | O_WRONLY, 0666)) < 0) {
@@ -323,6 +399,11 @@ PUBLIC void websClose()
         }
         websFree(wp);
     }
+    while (websPoolCount > 0) {
+        freeWebs(websPool[--websPoolCount]);
+    }
+    wfree(websPool);
+    websPool = 0;
     wfree(websHostUrl);
     wfree(websIpAddrUrl);
     websIpAddrUrl = websHostUrl = NULL;
@@ -345,24 +426,44 @@ PUBLIC void websClose()
 }
 
 
+/*
+    Initialize a request object. The buffers, variables table and arena are retained from a prior request if the 
+    object is being reused for keep-alive or was recycled from the request pool.
+ */
 static void initWebs(Webs *wp, int flags, int reuse)
 {
-    WebsBuf     rxbuf;
+    WebsBuf     rxbuf, input;
+    WebsBlock   *txq, *txqTail;
+    WebsHash    vars;
     void        *ssl;
-    int         wid, sid, timeout;
+    char        *arena;
+    ssize       txqLen;
+    int         wid, sid, timeout, recycled, pipelined;
 
     assert(wp);
 
     if (reuse) {
-        rxbuf = wp->rxbuf;
         wid = wp->wid;
         sid = wp->sid;
         timeout = wp->timeout;
         ssl = wp->ssl;
+        pipelined = wp->pipelined;
+        txq = wp->txq;
+        txqTail = wp->txqTail;
+        txqLen = wp->txqLen;
     } else {
         wid = sid = -1;
         timeout = -1;
         ssl = 0;
+        pipelined = 0;
+        txq = txqTail = 0;
+        txqLen = 0;
+    }
+    if ((recycled = (wp->arena != 0)) != 0) {
+        rxbuf = wp->rxbuf;
+        input = wp->input;
+        vars = wp->vars;
+        arena = wp->arena;
     }
     memset(wp, 0, sizeof(Webs));
     wp->flags = flags;
@@ -375,6 +476,10 @@ static void initWebs(Webs *wp, int flags, int reuse)
     wp->rxLen = -1;
     wp->code = HTTP_CODE_OK;
     wp->ssl = ssl;
+    wp->pipelined = pipelined;
+    wp->txq = txq;
+    wp->txqTail = txqTail;
+    wp->txqLen = txqLen;
 #if !ME_ROM
     wp->putfd = -1;
 #endif
@@ -384,24 +489,124 @@ static void initWebs(Webs *wp, int flags, int reuse)
 #if ME_GOAHEAD_UPLOAD
     wp->upfd = -1;
 #endif
-    if (!reuse) {
-        wp->timeout = -1;
+    if (recycled) {
+        wp->rxbuf = rxbuf;
+        wp->input = input;
+        wp->vars = vars;
+        wp->arena = arena;
+    } else {
+        wp->vars = hashCreate(WEBS_HASH_INIT);
+        wp->arena = walloc(ME_GOAHEAD_LIMIT_ARENA);
     }
-    wp->vars = hashCreate(WEBS_HASH_INIT);
     /*
         Ring queues can never be totally full and are short one byte. Better to do even I/O and allocate
-        a little more memory than required. The chunkbuf has extra room to fit chunk headers and trailers.
+        a little more memory than required. Buffers that were grown by a prior request are recreated at their 
+        initial size.
      */
     assert(ME_GOAHEAD_LIMIT_BUFFER >= 1024);
-    bufCreate(&wp->output, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_BUFFER + 1);
-    bufCreate(&wp->chunkbuf, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_BUFFER * 2);
-    bufCreate(&wp->input, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_PUT + 1);
-    if (reuse) {
-        wp->rxbuf = rxbuf;
-    } else {
+    if (!wp->rxbuf.buf) {
         bufCreate(&wp->rxbuf, ME_GOAHEAD_LIMIT_HEADERS, ME_GOAHEAD_LIMIT_HEADERS + ME_GOAHEAD_LIMIT_PUT);
     }
-    wp->rxbuf = wp->rxbuf;
+    if (!wp->input.buf) {
+        bufCreate(&wp->input, ME_GOAHEAD_LIMIT_BUFFER + 1, ME_GOAHEAD_LIMIT_PUT + 1);
+    }
+}
+
+
+/*
+    Release a buffer for reuse by the next request. Buffers that have grown beyond their initial size are freed.
+ */
+static void recycleBuf(WebsBuf *bp)
+{
+    if (bp->buf) {
+        if (bp->buflen > bp->increment) {
+            bufFree(bp);
+        } else {
+            bufFlush(bp);
+        }
+    }
+}
+
+
+/*
+    Free the memory retained by a request object for reuse
+ */
+static void freeWebs(Webs *wp)
+{
+    bufFree(&wp->rxbuf);
+    bufFree(&wp->input);
+    hashFree(wp->vars);
+    wfree(wp->arena);
+    wfree(wp);
+}
+
+
+/*
+    Arena memory is aligned for any data type
+ */
+#define ARENA_ALIGN(size) (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+/*
+    Overflow block for arena allocations that do not fit in the request arena. The memory follows the header.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock   *next;
+} ArenaBlock;
+
+
+PUBLIC void *websArenaAlloc(Webs *wp, ssize size)
+{
+    ArenaBlock  *bp;
+    void        *ptr;
+
+    assert(wp);
+    assert(size >= 0);
+
+    size = ARENA_ALIGN(size);
+    if (wp->arena && (wp->arenaUsed + size) <= ME_GOAHEAD_LIMIT_ARENA) {
+        ptr = &wp->arena[wp->arenaUsed];
+        wp->arenaUsed += size;
+        return ptr;
+    }
+    if ((bp = walloc(sizeof(ArenaBlock) + size)) == 0) {
+        return 0;
+    }
+    bp->next = wp->arenaBlocks;
+    wp->arenaBlocks = bp;
+    return &bp[1];
+}
+
+
+PUBLIC char *websArenaClone(Webs *wp, char *str)
+{
+    char    *ptr;
+    ssize   len;
+
+    if (str == 0) {
+        str = "";
+    }
+    len = slen(str);
+    if ((ptr = websArenaAlloc(wp, len + 1)) == 0) {
+        return 0;
+    }
+    memcpy(ptr, str, len + 1);
+    return ptr;
+}
+
+
+/*
+    Release all arena memory in one step
+ */
+static void resetArena(Webs *wp)
+{
+    ArenaBlock  *bp, *next;
+
+    for (bp = wp->arenaBlocks; bp; bp = next) {
+        next = bp->next;
+        wfree(bp);
+    }
+    wp->arenaBlocks = 0;
+    wp->arenaUsed = 0;
 }
 
 
@@ -411,12 +616,13 @@ static void termWebs(Webs *wp, int reuse)
 
     /*
         Some of this is done elsewhere, but keep this here for when a shutdown is done and there are open connections.
+        The buffers, variables and arena are retained for reuse by initWebs. When reusing the connection, the output
+        chain may hold pipelined responses that have not yet been written.
      */
-    bufFree(&wp->input);
-    bufFree(&wp->output);
-    bufFree(&wp->chunkbuf);
+    recycleBuf(&wp->input);
     if (!reuse) {
-        bufFree(&wp->rxbuf);
+        freeQueue(wp);
+        recycleBuf(&wp->rxbuf);
         if (wp->sid >= 0) {
 #if ME_COM_SSL
             sslFree(wp);
@@ -431,6 +637,26 @@ static void termWebs(Webs *wp, int reuse)
         close(wp->cgifd);
         wp->cgifd = -1;
     }
+#if ME_UNIX_LIKE && !ME_ROM
+    websCgiAbort(wp);
+#endif
+#endif
+#if WEBS_FASTCGI
+    if (wp->fastcgi) {
+        websFastCgiAbort(wp);
+    }
+#endif
+#if ME_GOAHEAD_JAVASCRIPT
+    if (wp->jst) {
+        websJstAbort(wp);
+    }
+#endif
+#if WEBS_COMPRESS
+    if (wp->zstream) {
+        deflateEnd(wp->zstream);
+        wfree(wp->zstream);
+        wp->zstream = 0;
+    }
 #endif
 #if !ME_ROM
     if (wp->putfd >= 0) {
@@ -446,31 +672,21 @@ static void termWebs(Webs *wp, int reuse)
     if (wp->timeout >= 0 && !reuse) {
         websCancelTimeout(wp);
     }
-    wfree(wp->authDetails);
     wfree(wp->authResponse);
-    wfree(wp->authType);
-    wfree(wp->contentType);
-    wfree(wp->cookie);
-    wfree(wp->decodedQuery);
     wfree(wp->digest);
-    wfree(wp->ext);
     wfree(wp->filename);
-    wfree(wp->host);
     wfree(wp->inputFile);
-    wfree(wp->method);
     wfree(wp->password);
     wfree(wp->path);
-    wfree(wp->protoVersion);
     wfree(wp->putname);
-    wfree(wp->query);
+    wfree(wp->rangeBoundary);
+    wfree(wp->ranges);
     wfree(wp->realm);
-    wfree(wp->referrer);
     wfree(wp->responseCookie);
-    wfree(wp->url);
-    wfree(wp->userAgent);
     wfree(wp->username);
 #if ME_GOAHEAD_UPLOAD
     wfree(wp->boundary);
+    wfree(wp->boundarySkip);
     wfree(wp->uploadTmp);
     wfree(wp->uploadVar);
 #endif
@@ -485,7 +701,8 @@ static void termWebs(Webs *wp, int reuse)
     wfree(wp->nonce);
     wfree(wp->qop);
 #endif
-    hashFree(wp->vars);
+    hashClear(wp->vars);
+    resetArena(wp);
 
 #if ME_GOAHEAD_UPLOAD
     if (wp->files) {
@@ -500,7 +717,15 @@ PUBLIC int websAlloc(int sid)
     Webs    *wp;
     int     wid;
 
-    if ((wid = wallocObject(&webs, &websMax, sizeof(Webs))) < 0) {
+    if (websPoolCount > 0) {
+        if ((wid = wallocHandle(&webs)) < 0) {
+            return -1;
+        }
+        webs[wid] = websPool[--websPoolCount];
+        if (wid >= websMax) {
+            websMax = wid + 1;
+        }
+    } else if ((wid = wallocObject(&webs, &websMax, sizeof(Webs))) < 0) {
         return -1;
     }
     wp = webs[wid];
@@ -508,7 +733,7 @@ PUBLIC int websAlloc(int sid)
     initWebs(wp, 0, 0);
     wp->wid = wid;
     wp->sid = sid;
-    wp->timestamp = time(0);
+    wp->timestamp = websGetTicks();
     return wid;
 }
 
@@ -534,7 +759,11 @@ PUBLIC void websFree(Webs *wp)
 
     termWebs(wp, 0);
     websMax = wfreeHandle(&webs, wp->wid);
-    wfree(wp);
+    if (websPool && websPoolCount < ME_GOAHEAD_LIMIT_WEBS_POOL) {
+        websPool[websPoolCount++] = wp;
+    } else {
+        freeWebs(wp);
+    }
     assert(websMax >= 0);
 }
 
@@ -556,10 +785,19 @@ PUBLIC void websDone(Webs *wp)
     wp->flags |= WEBS_FINALIZED;
 
     if (wp->state < WEBS_COMPLETE) {
-        /*
-            Initiate flush. If not all flushed, wait for output to drain via a socket event.
-         */
-        if (websFlush(wp, 0) == 0) {
+        if (canCoalesce(wp)) {
+            /*
+                More pipelined requests are already buffered. Defer writing so their responses share a single write.
+                Reservice the socket in case this request completed outside websPump.
+             */
+            wp->pipelined++;
+            wp->state = WEBS_COMPLETE;
+            socketReservice(wp->sid);
+
+        } else if (websFlush(wp, 0) == 0) {
+            /*
+                Initiate flush. If not all flushed, wait for output to drain via a socket event.
+             */
             sp = socketPtr(wp->sid);
             socketCreateHandler(wp->sid, sp->handlerMask | SOCKET_WRITABLE, socketEvent, wp);
         }
@@ -574,6 +812,48 @@ PUBLIC void websDone(Webs *wp)
 }
 
 
+/*
+    Test if the response to a finalized request can be left in the output and coalesced with the responses
+    to following pipelined requests
+ */
+static bool canCoalesce(Webs *wp)
+{
+    if (!(wp->flags & WEBS_KEEP_ALIVE) || wp->state < WEBS_READY || wp->sid < 0 || wp->writeData) {
+        return 0;
+    }
+    if (wp->pipelined >= ME_GOAHEAD_LIMIT_PIPELINE || bufLen(&wp->rxbuf) == 0) {
+        return 0;
+    }
+    if (wp->flags & WEBS_CHUNKING) {
+        finishChunks(wp);
+    }
+    return !(wp->flags & WEBS_CHUNKING);
+}
+
+
+/*
+    Write the coalesced responses to pipelined requests. If the socket cannot accept all the output, wait for it to
+    become writable. Stop reading new requests while the pipeline limit is reached.
+ */
+static void flushPipeline(Webs *wp)
+{
+    WebsSocket  *sp;
+    int         mask;
+
+    if ((wp->flags & WEBS_CLOSED) || wp->sid < 0) {
+        return;
+    }
+    if (websFlush(wp, 0) == 0) {
+        sp = socketPtr(wp->sid);
+        mask = sp->handlerMask | SOCKET_WRITABLE;
+        if (wp->pipelined >= ME_GOAHEAD_LIMIT_PIPELINE) {
+            mask &= ~SOCKET_READABLE;
+        }
+        socketCreateHandler(wp->sid, mask, socketEvent, wp);
+    }
+}
+
+
 static void complete(Webs *wp, int reuse) 
 {
     assert(wp);
@@ -616,7 +896,10 @@ PUBLIC int websListen(char *endpoint)
         return -1;
     }
     socketParseAddress(endpoint, &ip, &port, &secure, 80);
-    if ((sid = socketListen(ip, port, websAccept, 0)) < 0) {
+    /*
+        Each worker process has its own listen socket. The kernel distributes connections across them.
+     */
+    if ((sid = socketListen(ip, port, websAccept, (websWorkers > 1) ? SOCKET_REUSEPORT : 0)) < 0) {
         error("Unable to open socket on port %d.", port);
         return -1;
     }
@@ -819,7 +1102,7 @@ static void readEvent(Webs *wp)
         } else {
             socketDeleteHandler(wp->sid);
         }
-    } else if (wp->state < WEBS_READY) {
+    } else if (wp->state < WEBS_READY && wp->pipelined < ME_GOAHEAD_LIMIT_PIPELINE) {
         sp = socketPtr(wp->sid);
         socketCreateHandler(wp->sid, sp->handlerMask | SOCKET_READABLE, socketEvent, wp);
     }
@@ -849,13 +1132,21 @@ PUBLIC void websPump(Webs *wp)
             break;
         case WEBS_RUNNING:
             /* Nothing to do until websDone is called */
-            return;
+            canProceed = 0;
+            break;
         case WEBS_COMPLETE:
             complete(wp, 1);
-            canProceed = bufLen(&wp->rxbuf) != 0;
+            if ((canProceed = bufLen(&wp->rxbuf) != 0) && wp->pipelined >= ME_GOAHEAD_LIMIT_PIPELINE) {
+                /* Write the coalesced responses before parsing more requests */
+                flushPipeline(wp);
+                canProceed = (wp->pipelined == 0);
+            }
             break;
         }
     }
+    if (wp->pipelined) {
+        flushPipeline(wp);
+    }
 }
 
 
@@ -863,12 +1154,19 @@ static bool parseIncoming(Webs *wp)
 {
     WebsBuf     *rxbuf;
     char        *end, c;
+    ssize       limit;
 
     rxbuf = &wp->rxbuf;
     while (*rxbuf->servp == '\r' || *rxbuf->servp == '\n') {
         bufGetc(rxbuf);
+        wp->rxScan = 0;
     }
-    if ((end = strstr((char*) wp->rxbuf.servp, "\r\n\r\n")) == 0) {
+    /*
+        Resume searching for the end of the headers where the last read left off. Back up in case the
+        delimiter spans reads.
+     */
+    if ((end = strstr((char*) &rxbuf->servp[max(wp->rxScan - 3, 0)], "\r\n\r\n")) == 0) {
+        wp->rxScan = bufLen(rxbuf);
         if (bufLen(&wp->rxbuf) >= ME_GOAHEAD_LIMIT_HEADER) {
             websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Header too large");
             return 1;
@@ -888,7 +1186,7 @@ static bool parseIncoming(Webs *wp)
     if (wp->state == WEBS_COMPLETE) {
         return 1;
     }
-    parseHeaders(wp);
+    parseHeaders(wp, end);
     if (wp->state == WEBS_COMPLETE) {
         return 1;
     }
@@ -902,6 +1200,13 @@ static bool parseIncoming(Webs *wp)
 #if !ME_ROM
 #if ME_GOAHEAD_CGI
     if (strstr(wp->path, ME_GOAHEAD_CGI_BIN) != 0) {
+#if ME_UNIX_LIKE
+        /*
+            The body is retained in wp->input and is written to the CGI program via a pipe. The program receives
+            the raw body, so it is not parsed as form vars or uploads.
+         */
+        wp->flags &= ~(WEBS_FORM | WEBS_UPLOAD);
+#else
         if (smatch(wp->method, "POST")) {
             wp->cgiStdin = websGetCgiCommName();
             if ((wp->cgifd = open(wp->cgiStdin, O_CREAT | O_WRONLY | O_BINARY | O_TRUNC, 0666)) < 0) {
@@ -909,8 +1214,34 @@ static bool parseIncoming(Webs *wp)
                 return 1;
             }
         }
+#endif
     }
 #endif
+#if WEBS_FASTCGI
+    if (wp->route && wp->route->handler && smatch(wp->route->handler->name, "fastcgi")) {
+        /* The body is sent to the FastCGI program */
+        wp->flags &= ~(WEBS_FORM | WEBS_UPLOAD);
+    }
+#endif
+#endif
+    /*
+        The body limit is selected after routing. Only multipart bodies consumed by the upload filter are streamed
+        to disk and so are not bound by the POST limit. CGI and FastCGI routes buffer the body.
+     */
+    if (smatch(wp->method, "PUT")) {
+        limit = ME_GOAHEAD_LIMIT_PUT;
+#if ME_GOAHEAD_UPLOAD
+    } else if (wp->flags & WEBS_UPLOAD) {
+        limit = ME_GOAHEAD_LIMIT_UPLOAD;
+#endif
+    } else {
+        limit = ME_GOAHEAD_LIMIT_POST;
+    }
+    if (wp->rxLen > limit) {
+        websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too big");
+        return 1;
+    }
+#if !ME_ROM
     if (smatch(wp->method, "PUT")) {
         WebsStat    sbuf;
         wp->code = (stat(wp->filename, &sbuf) == 0 && sbuf.st_mode & S_IFDIR) ? HTTP_CODE_NO_CONTENT : HTTP_CODE_CREATED;
@@ -927,6 +1258,32 @@ static bool parseIncoming(Webs *wp)
 }
 
 
+/*
+    Test if an Accept-Encoding header value permits gzip. A zero quality value ("gzip;q=0") refuses the encoding.
+ */
+static bool acceptGzip(char *value)
+{
+    char    *cp, *tok;
+
+    slower(value);
+    for (cp = value; (cp = strstr(cp, "gzip")) != 0; cp += 4) {
+        if ((cp > value && (isalnum((uchar) cp[-1]) || cp[-1] == '-')) || isalnum((uchar) cp[4])) {
+            /* Part of another coding such as x-gzip */
+            continue;
+        }
+        for (tok = &cp[4]; *tok == ' ' || *tok == '\t'; tok++) ;
+        if (*tok == ';') {
+            for (tok++; *tok == ' ' || *tok == '\t'; tok++) ;
+            if (sncmp(tok, "q=", 2) == 0 && atof(&tok[2]) <= 0) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
 /*
     Parse the first line of a HTTP request
  */
@@ -946,7 +1303,11 @@ static void parseFirstLine(Webs *wp)
         websError(wp, HTTP_CODE_NOT_FOUND | WEBS_CLOSE, "Bad HTTP request");
         return;
     }
-    wp->method = supper(sclone(op));
+    if ((wp->method = websArenaClone(wp, op)) == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate request");
+        return;
+    }
+    supper(wp->method);
 
     url = getToken(wp, 0);
     if (url == NULL || *url == '\0') {
@@ -979,23 +1340,32 @@ static void parseFirstLine(Webs *wp)
         wfree(buf);
         return;
     }
-    wp->url = sclone(url);
+    wp->url = websArenaClone(wp, url);
     if (ext) {
-        wp->ext = sclone(slower(ext));
+        wp->ext = websArenaClone(wp, slower(ext));
     }
     wp->filename = sfmt("%s%s", websGetDocuments(), wp->path);
-    wp->query = sclone(query);
-    wp->host = sclone(host);
+    wp->query = websArenaClone(wp, query);
+    wp->host = websArenaClone(wp, host);
+    if (!wp->url || (ext && !wp->ext) || !wp->query || !wp->host) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate request");
+        wfree(buf);
+        return;
+    }
     wp->protocol = wp->flags & WEBS_SECURE ? "https" : "http";
     if (smatch(protoVer, "HTTP/1.1")) {
         wp->flags |= WEBS_KEEP_ALIVE | WEBS_HTTP11;
     } else if (smatch(protoVer, "HTTP/1.0")) {
         wp->flags &= ~(WEBS_HTTP11);
     } else {
-        protoVer = sclone("HTTP/1.1");
+        protoVer = "HTTP/1.1";
         websError(wp, WEBS_CLOSE | HTTP_CODE_NOT_ACCEPTABLE, "Unsupported HTTP protocol");
     }
-    wp->protoVersion = sclone(protoVer);
+    if ((wp->protoVersion = websArenaClone(wp, protoVer)) == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate request");
+        wfree(buf);
+        return;
+    }
     if ((listenPort = socketGetPort(wp->listenSid)) >= 0) {
         wp->port = listenPort;
     } else {
@@ -1006,130 +1376,171 @@ static void parseFirstLine(Webs *wp)
 
 
 /*
-    Parse a full request
+    Parse the request headers. The header lines are copied into a single arena block that lives for the duration of
+    the request as the rxbuf is reused for body content. Each line is tokenized in place and the header names and values
+    are referenced, not copied. The HTTP_* request variables are created on demand by websSetHeaderVars.
  */
-static void parseHeaders(Webs *wp)
+static void parseHeaders(Webs *wp, char *end)
 {
-    char    *upperKey, *cp, *key, *value, *tok;
-    int     count;
+    WebsHeader  *hp;
+    char        *start, *block, *cp, *next, *key, *value, *tok;
+    ssize       len;
+    int         count;
 
     assert(websValid(wp));
 
-    /* 
-        Parse the header and create the Http header keyword variables
-        We rewrite the header as we go for non-local requests.  NOTE: this
-        modifies the header string directly and tokenizes each line with '\0'.
-    */
-    for (count = 0; wp->rxbuf.servp[0] != '\r'; count++) {
-        if (count >= ME_GOAHEAD_LIMIT_NUM_HEADERS) {
-            websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too many headers");
-            return;
+    /*
+        The headers span from the current position to the "\r\n" preceding the blank line at the end
+     */
+    start = (char*) wp->rxbuf.servp;
+    end += 2;
+    if (end < start) {
+        websError(wp, HTTP_CODE_BAD_REQUEST | WEBS_CLOSE, "Bad header format");
+        return;
+    }
+    len = end - start;
+    for (count = 0, cp = start; (cp = memchr(cp, '\n', end - cp)) != 0; cp++) {
+        count++;
+    }
+    if (count > ME_GOAHEAD_LIMIT_NUM_HEADERS) {
+        websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too many headers");
+        return;
+    }
+    if ((wp->headers = websArenaAlloc(wp, count * sizeof(WebsHeader) + len + 1)) == 0) {
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate headers");
+        return;
+    }
+    block = (char*) &wp->headers[count];
+    memcpy(block, start, len);
+    block[len] = '\0';
+    wp->rxbuf.servp = end;
+
+    for (cp = block; *cp; cp = next) {
+        if ((next = strchr(cp, '\n')) != 0) {
+            *next++ = '\0';
+        } else {
+            next = &cp[slen(cp)];
         }
-        if ((key = getToken(wp, ":")) == NULL) {
-            continue;
+        if ((len = slen(cp)) > 0 && cp[len - 1] == '\r') {
+            cp[len - 1] = '\0';
         }
-        if ((value = getToken(wp, "\r\n")) == NULL) {
-            value = "";
+        for (key = cp; *key == ' ' || *key == '\t'; key++) ;
+        if (*key == '\0') {
+            continue;
         }
-        if (!key || !value) {
+        if ((value = strchr(key, ':')) == 0 || value == key) {
             websError(wp, HTTP_CODE_BAD_REQUEST | WEBS_CLOSE, "Bad header format");
             return;
         }
+        *value++ = '\0';
         while (isspace((uchar) *value)) {
             value++;
         }
         slower(key);
-
-        /*
-            Create a variable (CGI) for each line in the header
-         */
-        upperKey = sfmt("HTTP_%s", key);
-        for (cp = upperKey; *cp; cp++) {
-            if (*cp == '-') {
-                *cp = '_';
-            }
-        }
-        supper(upperKey);
-        websSetVar(wp, upperKey, value);
-        wfree(upperKey);
+        hp = &wp->headers[wp->headerCount++];
+        hp->name = key;
+        hp->value = value;
 
         /*
             Track the requesting agent (browser) type
          */
-        if (strcmp(key, "user-agent") == 0) {
-            wp->userAgent = sclone(value);
-
-        } else if (scaselesscmp(key, "authorization") == 0) {
-            wp->authType = sclone(value);
-            ssplit(wp->authType, " \t", &tok);
-            wp->authDetails = sclone(tok);
-            slower(wp->authType);
-
-        } else if (strcmp(key, "connection") == 0) {
-            slower(value);
-            if (strcmp(value, "keep-alive") == 0) {
-                wp->flags |= WEBS_KEEP_ALIVE;
-            } else if (strcmp(value, "close") == 0) {
-                wp->flags &= ~WEBS_KEEP_ALIVE;
-            }
-
-        } else if (strcmp(key, "content-length") == 0) {
-            wp->rxLen = atoi(value);
-            if (smatch(wp->method, "PUT")) {
-                if (wp->rxLen > ME_GOAHEAD_LIMIT_PUT) {
-                    websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too big");
-                    return;
+        switch (key[0]) {
+        case 'a':
+            if (strcmp(key, "accept-encoding") == 0) {
+                if (acceptGzip(value)) {
+                    wp->flags |= WEBS_ACCEPT_GZIP;
                 }
-            } else {
-                if (wp->rxLen > ME_GOAHEAD_LIMIT_POST) {
-                    websError(wp, HTTP_CODE_REQUEST_TOO_LARGE | WEBS_CLOSE, "Too big");
+            } else if (strcmp(key, "authorization") == 0) {
+                if ((wp->authType = websArenaClone(wp, value)) == 0) {
+                    websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR | WEBS_CLOSE, "Cannot allocate headers");
                     return;
                 }
+                ssplit(wp->authType, " \t", &tok);
+                wp->authDetails = tok;
+                slower(wp->authType);
             }
-            if (wp->rxLen > 0 && !smatch(wp->method, "HEAD")) {
-                wp->rxRemaining = wp->rxLen;
+            break;
+
+        case 'c':
+            if (strcmp(key, "connection") == 0) {
+                if (scaselessmatch(value, "keep-alive")) {
+                    wp->flags |= WEBS_KEEP_ALIVE;
+                } else if (scaselessmatch(value, "close")) {
+                    wp->flags &= ~WEBS_KEEP_ALIVE;
+                }
+
+            } else if (strcmp(key, "content-length") == 0) {
+                wp->rxLen = atoi(value);
+                if (wp->rxLen > 0 && !smatch(wp->method, "HEAD")) {
+                    wp->rxRemaining = wp->rxLen;
+                }
+
+            } else if (strcmp(key, "content-type") == 0) {
+                wp->contentType = value;
+                if (strstr(value, "application/x-www-form-urlencoded")) {
+                    wp->flags |= WEBS_FORM;
+                } else if (strstr(value, "application/json")) {
+                    wp->flags |= WEBS_JSON;
+                } else if (strstr(value, "multipart/form-data")) {
+                    wp->flags |= WEBS_UPLOAD;
+                }
+
+            } else if (strcmp(key, "cookie") == 0) {
+                wp->flags |= WEBS_COOKIE;
+                wp->cookie = value;
             }
+            break;
 
-        } else if (strcmp(key, "content-type") == 0) {
-            wp->contentType = sclone(value);
-            if (strstr(value, "application/x-www-form-urlencoded")) {
-                wp->flags |= WEBS_FORM;
-            } else if (strstr(value, "application/json")) {
-                wp->flags |= WEBS_JSON;
-            } else if (strstr(value, "multipart/form-data")) {
-                wp->flags |= WEBS_UPLOAD;
+        case 'h':
+            if (strcmp(key, "host") == 0) {
+                wp->host = value;
             }
+            break;
+
+        case 'i':
+            if (strcmp(key, "if-modified-since") == 0) {
+                /*
+                    The date is only parsed if required by the file handler
+                 */
+                if ((tok = strchr(value, ';')) != NULL) {
+                    *tok = '\0';
+                }
+                wp->ifModifiedSince = value;
 
-        } else if (strcmp(key, "cookie") == 0) {
-            wp->flags |= WEBS_COOKIE;
-            wp->cookie = sclone(value);
+            } else if (strcmp(key, "if-none-match") == 0) {
+                wp->ifNoneMatch = value;
 
-        } else if (strcmp(key, "host") == 0) {
-            wfree(wp->host);
-            wp->host = sclone(value);
+            } else if (strcmp(key, "if-range") == 0) {
+                wp->ifRange = value;
+            }
+            break;
 
-        } else if (strcmp(key, "if-modified-since") == 0) {
-            char     *cmd;
-            WebsTime tip = 0;
+        case 'r':
+            if (strcmp(key, "range") == 0) {
+                wp->range = value;
 
-            if ((cp = strchr(value, ';')) != NULL) {
-                *cp = '\0';
+            /*
+                Yes Veronica, the HTTP spec does misspell Referrer
+             */
+            } else if (strcmp(key, "referer") == 0) {
+                wp->referrer = value;
             }
-            cmd = sfmt("%s", value);
-            wp->since = dateParse(tip, cmd);
-            wfree(cmd);
+            break;
 
-        /*
-            Yes Veronica, the HTTP spec does misspell Referrer
-         */
-        } else if (strcmp(key, "referer") == 0) {
-            wp->referrer = sclone(value);
+        case 't':
+            if (strcmp(key, "transfer-encoding") == 0) {
+                if (scaselesscmp(value, "chunked") == 0) {
+                    wp->rxChunkState = WEBS_CHUNK_START;
+                    wp->rxRemaining = MAXINT;
+                }
+            }
+            break;
 
-        } else if (strcmp(key, "transfer-encoding") == 0) {
-            if (scaselesscmp(value, "chunked") == 0) {
-                wp->rxChunkState = WEBS_CHUNK_START;
-                wp->rxRemaining = MAXINT;
+        case 'u':
+            if (strcmp(key, "user-agent") == 0) {
+                wp->userAgent = value;
             }
+            break;
         }
     }
     if (!wp->rxChunkState) {
@@ -1266,7 +1677,7 @@ static bool filterChunkData(Webs *wp)
             wp->rxRemaining = chunkSize;
             if (chunkSize == 0) {
 #if ME_GOAHEAD_LEGACY
-                wp->query = sclone(bufStart(&wp->input));
+                wp->query = websArenaClone(wp, bufStart(&wp->input));
 #endif
                 wp->eof = 1;
                 return 1;
@@ -1311,6 +1722,7 @@ PUBLIC void websServiceEvents(int *finished)
     delay = 0;
     while (!finished || !*finished) {
         if (socketSelect(-1, delay)) {
+            websUpdateTicks();
             socketProcess();
         }
 #if ME_GOAHEAD_CGI && !ME_ROM
@@ -1324,23 +1736,124 @@ PUBLIC void websServiceEvents(int *finished)
 }
 
 
+#if ME_UNIX_LIKE
+static pid_t startWorker()
+{
+    pid_t   pid;
+
+    if ((pid = fork()) < 0) {
+        error("Cannot fork worker, errno %d", errno);
+    }
+    return pid;
+}
+
+
 /*
-    NOTE: the vars variable is modified
+    Start worker processes. Each worker runs its own event loop with its own sockets, requests and sessions, and 
+    listens via SO_REUSEPORT on the same endpoints so the kernel spreads connections across workers. This must be 
+    called before websOpen. Returns zero in each worker. The calling process supervises the workers, restarting any 
+    that die from a signal, and returns 1 when all have exited or -1 if no workers could be started or workers 
+    failed. Sessions are private to each worker, so form authentication is refused when workers are used.
  */
-static void addFormVars(Webs *wp, char *vars)
+PUBLIC int websStartWorkers(int *finished)
 {
-    char  *keyword, *value, *prior, *tok;
-
-    assert(wp);
-    assert(vars);
+    pid_t   pids[WEBS_MAX_WORKERS], pid;
+    int     i, count, alive, failed, status, stopping;
 
-    keyword = stok(vars, "&", &tok);
-    while (keyword != NULL) {
-        if ((value = strchr(keyword, '=')) != NULL) {
-            *value++ = '\0';
-            websDecodeUrl(keyword, keyword, strlen(keyword));
-            websDecodeUrl(value, value, strlen(value));
-        } else {
+    if (websWorkers <= 1) {
+        return 0;
+    }
+#ifndef SO_REUSEPORT
+    error("Worker processes require SO_REUSEPORT support");
+    return -1;
+#endif
+    /*
+        Open the log here so the workers share it
+     */
+    if (logOpen() < 0) {
+        return -1;
+    }
+    count = min(websWorkers, WEBS_MAX_WORKERS);
+    for (alive = i = 0; i < count; i++) {
+        if ((pid = startWorker()) == 0) {
+            return 0;
+        }
+        pids[i] = pid;
+        if (pid > 0) {
+            alive++;
+        }
+    }
+    if (alive == 0) {
+        return -1;
+    }
+    logmsg(2, "Started %d worker processes", alive);
+
+    /*
+        The sleep is interrupted by termination signals. Workers get SIGTERM when the supervisor is instructed to exit.
+     */
+    failed = stopping = 0;
+    while (alive > 0) {
+        if (!stopping && finished && *finished) {
+            for (i = 0; i < count; i++) {
+                if (pids[i] > 0) {
+                    kill(pids[i], SIGTERM);
+                }
+            }
+            stopping = 1;
+        }
+        if ((pid = waitpid(-1, &status, WNOHANG)) <= 0) {
+            if (pid < 0 && errno != EINTR) {
+                break;
+            }
+            sleep(1);
+            continue;
+        }
+        for (i = 0; i < count; i++) {
+            if (pids[i] == pid) {
+                break;
+            }
+        }
+        if (i >= count) {
+            continue;
+        }
+        pids[i] = 0;
+        alive--;
+        if (WIFSIGNALED(status) && !stopping) {
+            error("Worker %d died from signal %d, restarting", pid, WTERMSIG(status));
+            if ((pid = startWorker()) == 0) {
+                return 0;
+            }
+            if (pid > 0) {
+                pids[i] = pid;
+                alive++;
+            }
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            error("Worker %d exited with status %d", pid, WEXITSTATUS(status));
+            failed++;
+        }
+    }
+    return failed ? -1 : 1;
+}
+#endif
+
+
+/*
+    NOTE: the vars variable is modified
+ */
+static void addFormVars(Webs *wp, char *vars)
+{
+    char  *keyword, *value, *prior, *tok;
+
+    assert(wp);
+    assert(vars);
+
+    keyword = stok(vars, "&", &tok);
+    while (keyword != NULL) {
+        if ((value = strchr(keyword, '=')) != NULL) {
+            *value++ = '\0';
+            websDecodeUrl(keyword, keyword, strlen(keyword));
+            websDecodeUrl(value, value, strlen(value));
+        } else {
             value = "";
         }
         if (*keyword) {
@@ -1390,6 +1903,56 @@ PUBLIC void websSetEnv(Webs *wp)
     websSetVar(wp, "SERVER_PROTOCOL", wp->protoVersion);
     websSetVar(wp, "SERVER_URL", websHostUrl);
     websSetVarFmt(wp, "SERVER_SOFTWARE", "GoAhead/%s", ME_VERSION);
+    websSetHeaderVars(wp);
+}
+
+
+/*
+    Create a variable (CGI) for each line in the header. This is deferred until a handler requires the variables.
+    Headers are visited in reverse so the last of repeated headers is used and variables already defined by the
+    request are preserved.
+ */
+PUBLIC void websSetHeaderVars(Webs *wp)
+{
+    WebsHeader  *hp;
+    char        name[ME_GOAHEAD_LIMIT_HEADER + 6], *cp, *dp;
+    int         i;
+
+    assert(websValid(wp));
+
+    if (wp->flags & WEBS_HEADER_VARS) {
+        return;
+    }
+    wp->flags |= WEBS_HEADER_VARS;
+    scopy(name, sizeof(name), "HTTP_");
+    for (i = wp->headerCount - 1; i >= 0; i--) {
+        hp = &wp->headers[i];
+        for (cp = hp->name, dp = &name[5]; *cp && dp < &name[sizeof(name) - 1]; cp++) {
+            *dp++ = (*cp == '-') ? '_' : toupper((uchar) *cp);
+        }
+        *dp = '\0';
+        if (!hashLookup(wp->vars, name)) {
+            websSetVar(wp, name, hp->value);
+        }
+    }
+}
+
+
+PUBLIC char *websGetHeader(Webs *wp, char *name)
+{
+    WebsHeader  *hp;
+    int         i;
+
+    assert(websValid(wp));
+    assert(name && *name);
+
+    for (i = wp->headerCount - 1; i >= 0; i--) {
+        hp = &wp->headers[i];
+        if (scaselessmatch(hp->name, name)) {
+            return hp->value;
+        }
+    }
+    return 0;
 }
 
 
@@ -1413,8 +1976,7 @@ PUBLIC void websSetQueryVars(Webs *wp)
         Decode and create an environment query variable for each query keyword. We split into pairs at each '&', then
         split pairs at the '='.  Note: we rely on wp->decodedQuery preserving the decoded values in the symbol table.
      */
-    if (wp->query && *wp->query) {
-        wp->decodedQuery = sclone(wp->query);
+    if (wp->query && *wp->query && (wp->decodedQuery = websArenaClone(wp, wp->query)) != 0) {
         addFormVars(wp, wp->decodedQuery);
     }
 }
@@ -1474,7 +2036,11 @@ PUBLIC bool websTestVar(Webs *wp, char *var)
         return 0;
     }
     if ((sp = hashLookup(wp->vars, var)) == NULL) {
-        return 0;
+        if (sncmp(var, "HTTP_", 5) != 0 || (wp->flags & WEBS_HEADER_VARS)) {
+            return 0;
+        }
+        websSetHeaderVars(wp);
+        return hashLookup(wp->vars, var) != 0;
     }
     return 1;
 }
@@ -1491,7 +2057,11 @@ PUBLIC char *websGetVar(Webs *wp, char *var, char *defaultGetValue)
     assert(websValid(wp));
     assert(var && *var);
  
-    if ((sp = hashLookup(wp->vars, var)) != NULL) {
+    if ((sp = hashLookup(wp->vars, var)) == NULL && sncmp(var, "HTTP_", 5) == 0 && !(wp->flags & WEBS_HEADER_VARS)) {
+        websSetHeaderVars(wp);
+        sp = hashLookup(wp->vars, var);
+    }
+    if (sp != NULL) {
         assert(sp->content.type == string);
         if (sp->content.value.string) {
             return sp->content.value.string;
@@ -1752,8 +2322,11 @@ PUBLIC void websError(Webs *wp, int code, char *fmt, ...)
         wp->flags &= ~WEBS_KEEP_ALIVE;
     }
     encoded = websEscapeHtml(wp->url);
-    wfree(wp->url);
-    wp->url = encoded;
+    if ((wp->url = websArenaClone(wp, encoded)) == 0) {
+        /* Never fall back to the unescaped URL */
+        wp->url = "";
+    }
+    wfree(encoded);
     if (fmt) {
         va_start(args, fmt);
         msg = sfmtv(fmt, args);
@@ -1844,273 +2417,749 @@ PUBLIC void websSetStatus(Webs *wp, int code)
 }
 
 
+/*
+    Response header assembly buffer. Header fragments of known length are copied into the buffer which is then
+    written to the output as a single block.
+ */
+typedef struct HeaderBuf {
+    Webs    *wp;
+    char    *pos;
+    char    buf[ME_GOAHEAD_LIMIT_HEADER + 1];
+} HeaderBuf;
+
+/*
+    Cached "Date" header line. Refreshed at most once per second.
+ */
+static char     dateHeader[64];
+static ssize    dateHeaderLen;
+static time_t   dateHeaderTime;
+
+#define HDR(s) s, sizeof(s) - 1
+
+static void flushHeaders(HeaderBuf *hb)
+{
+    *hb->pos = '\0';
+    trace(3 | WEBS_RAW_MSG, "%s", hb->buf);
+    websWriteBlock(hb->wp, hb->buf, hb->pos - hb->buf);
+    hb->pos = hb->buf;
+}
+
+
+static void putHeaderData(HeaderBuf *hb, char *data, ssize len)
+{
+    if (len > ME_GOAHEAD_LIMIT_HEADER - (hb->pos - hb->buf)) {
+        flushHeaders(hb);
+        if (len > ME_GOAHEAD_LIMIT_HEADER) {
+            trace(3 | WEBS_RAW_MSG, "%s", data);
+            websWriteBlock(hb->wp, data, len);
+            return;
+        }
+    }
+    memcpy(hb->pos, data, len);
+    hb->pos += len;
+}
+
+
+static void putHeader(HeaderBuf *hb, char *key, ssize klen, char *value)
+{
+    putHeaderData(hb, key, klen);
+    putHeaderData(hb, ": ", 2);
+    putHeaderData(hb, value, slen(value));
+    putHeaderData(hb, "\r\n", 2);
+}
+
+
+static void putHeaderNum(HeaderBuf *hb, char *key, ssize klen, int64 value)
+{
+    char    num[32];
+
+    putHeader(hb, key, klen, itosbuf(num, sizeof(num), value, 10));
+}
+
+
+static void putDateHeader(HeaderBuf *hb)
+{
+    time_t  now;
+    char    *date;
+
+    now = time(0);
+    if (now != dateHeaderTime || dateHeaderLen == 0) {
+        if ((date = websGetDateString(NULL)) == NULL) {
+            return;
+        }
+        fmt(dateHeader, sizeof(dateHeader), "Date: %s\r\n", date);
+        dateHeaderLen = slen(dateHeader);
+        dateHeaderTime = now;
+        wfree(date);
+    }
+    putHeaderData(hb, dateHeader, dateHeaderLen);
+}
+
+
 /*
     Write a set of headers. Does not write the trailing blank line so callers can add more headers.
     Set length to -1 if unknown and transfer-chunk-encoding will be employed.
  */
 PUBLIC void websWriteHeaders(Webs *wp, ssize length, char *location)
 {
+    HeaderBuf   hb;
     WebsKey     *key;
-    char        *date;
+    char        code[16], *msg;
 
     assert(websValid(wp));
 
     if (!(wp->flags & WEBS_HEADERS_CREATED)) {
         if (!wp->protoVersion) {
-            wp->protoVersion = sclone("HTTP/1.0");
+            wp->protoVersion = "HTTP/1.0";
             wp->flags &= ~WEBS_KEEP_ALIVE;
         }
-        websWriteHeader(wp, NULL, "%s %d %s", wp->protoVersion, wp->code, websErrorMsg(wp->code));
+        if (!(wp->flags & WEBS_RESPONSE_TRACED)) {
+            wp->flags |= WEBS_RESPONSE_TRACED;
+            trace(3 | WEBS_RAW_MSG, "\n>>> Response\n");
+        }
+        hb.wp = wp;
+        hb.pos = hb.buf;
+        itosbuf(code, sizeof(code), wp->code, 10);
+        msg = websErrorMsg(wp->code);
+        putHeaderData(&hb, wp->protoVersion, slen(wp->protoVersion));
+        putHeaderData(&hb, " ", 1);
+        putHeaderData(&hb, code, slen(code));
+        putHeaderData(&hb, " ", 1);
+        putHeaderData(&hb, msg, slen(msg));
         /*
             The Embedthis Open Source license does not permit modification of the Server header
          */
-        websWriteHeader(wp, "Server", "GoAhead-http");
+        putHeaderData(&hb, HDR("\r\nServer: GoAhead-http\r\n"));
+        putDateHeader(&hb);
 
-        if ((date = websGetDateString(NULL)) != NULL) {
-            websWriteHeader(wp, "Date", "%s", date);
-            wfree(date);
-        }
         if (wp->authResponse) {
-            websWriteHeader(wp, "WWW-Authenticate", "%s", wp->authResponse);
+            putHeader(&hb, HDR("WWW-Authenticate"), wp->authResponse);
+        }
+        if (smatch(wp->method, "HEAD")) {
+            putHeaderNum(&hb, HDR("Content-Length"), length);
+        } else if (length >= 0) {
+            if (!((100 <= wp->code && wp->code <= 199) || wp->code == 204 || wp->code == 304)) {
+                putHeaderNum(&hb, HDR("Content-Length"), length);
+            }
+        }
+        wp->txLen = length;
+        if (wp->txLen < 0) {
+            putHeaderData(&hb, HDR("Transfer-Encoding: chunked\r\n"));
+        }
+        if (wp->flags & WEBS_KEEP_ALIVE) {
+            putHeaderData(&hb, HDR("Connection: keep-alive\r\n"));
+        } else {
+            putHeaderData(&hb, HDR("Connection: close\r\n"));
+        }
+        key = wp->ext ? hashLookup(websMime, wp->ext) : 0;
+        if (location) {
+            putHeader(&hb, HDR("Location"), location);
+        } else if (wp->rangeBoundary) {
+            putHeaderData(&hb, HDR("Content-Type: multipart/byteranges; boundary="));
+            putHeaderData(&hb, wp->rangeBoundary, slen(wp->rangeBoundary));
+            putHeaderData(&hb, "\r\n", 2);
+        } else if (key && key->content.type == string) {
+            putHeader(&hb, HDR("Content-Type"), key->content.value.string);
+        }
+        if (wp->responseCookie) {
+            putHeader(&hb, HDR("Set-Cookie"), wp->responseCookie);
+            putHeaderData(&hb, HDR("Cache-Control: no-cache=\"set-cookie\"\r\n"));
+        }
+#if defined(ME_GOAHEAD_CLIENT_CACHE)
+        if (key && key->arg) {
+            putHeaderData(&hb, clientCacheHeader, clientCacheHeaderLen);
+        }
+#endif
+#ifdef UNUSED_ME_GOAHEAD_XFRAME_HEADER
+        if (*ME_GOAHEAD_XFRAME_HEADER) {
+            putHeader(&hb, HDR("X-Frame-Options"), ME_GOAHEAD_XFRAME_HEADER);
+        }
+#endif
+        flushHeaders(&hb);
+    }
+}
+
+
+PUBLIC void websWriteEndHeaders(Webs *wp)
+{
+    assert(wp);
+#if WEBS_COMPRESS
+    if (wp->txLen < 0 && wp->code == HTTP_CODE_OK) {
+        char    *mimeType, *mtok;
+
+        /*
+            Dynamic responses without a mime type are treated as text/html
+         */
+        if ((mimeType = websGetMimeType(wp)) == 0) {
+            mimeType = "text/html";
+        }
+        mtok = sfmt(",%s,", mimeType);
+        if (strstr("," ME_GOAHEAD_COMPRESS_TYPES ",", mtok)) {
+            /*
+                The encoding depends on Accept-Encoding even if this response is sent uncompressed
+             */
+            wp->flags |= WEBS_VARY_ENCODING;
+            websWriteHeader(wp, "Vary", "Accept-Encoding");
+            if ((wp->flags & WEBS_ACCEPT_GZIP) && !smatch(wp->method, "HEAD")) {
+                wp->flags |= WEBS_GZIP_PENDING;
+            }
+        }
+        wfree(mtok);
+    }
+#endif
+    /*
+        By omitting the "\r\n" delimiter after the headers, chunks can emit "\r\nSize\r\n" as a single chunk delimiter
+     */
+    if (wp->txLen >= 0) {
+        websWriteBlock(wp, "\r\n", 2);
+    }
+    wp->flags |= WEBS_HEADERS_CREATED;
+    if (wp->txLen < 0) {
+        wp->flags |= WEBS_CHUNKING;
+    }
+}
+
+
+PUBLIC void websSetTxLength(Webs *wp, ssize length)
+{
+    assert(wp);
+    wp->txLen = length;
+}
+
+
+/*
+    Do formatted output to the browser. This is the public Javascript and form write procedure.
+ */
+PUBLIC ssize websWrite(Webs *wp, char *fmt, ...)
+{
+    va_list     vargs;
+    char        *buf;
+    ssize       rc;
+    
+    assert(websValid(wp));
+    assert(fmt && *fmt);
+
+    va_start(vargs, fmt);
+
+    buf = NULL;
+    rc = 0;
+    if ((buf = sfmtv(fmt, vargs)) == 0) {
+        error("websWrite lost data, buffer overflow");
+    }
+    va_end(vargs);
+    assert(buf);
+    if (buf) {
+        rc = websWriteBlock(wp, buf, strlen(buf));
+        wfree(buf);
+    }
+    return rc;
+}
+
+
+/*
+    Write to the socket or TLS connection. Returns the number of bytes written which may be short. Returns < 0 on errors.
+ */
+static ssize writeSocket(Webs *wp, char *buf, ssize len)
+{
+#if ME_COM_SSL
+    if (wp->flags & WEBS_SECURE) {
+        return sslWrite(wp, buf, len);
+    }
+#endif
+    return socketWrite(wp->sid, buf, len);
+}
+
+
+/*
+    Non-blocking write to socket.
+    Returns number of bytes written. Returns -1 on errors. May return short.
+ */
+PUBLIC ssize websWriteSocket(Webs *wp, char *buf, ssize size)
+{
+    ssize   written;
+
+    assert(wp);
+    assert(buf);
+    assert(size >= 0);
+
+    if (wp->flags & WEBS_CLOSED) {
+        return -1;
+    }
+    if ((written = writeSocket(wp, buf, size)) < 0) {
+        return -1;
+    }
+    wp->written += written;
+    websNoteRequestActivity(wp);
+    return written;
+}
+
+
+/*
+    Allocate an output segment with room for size bytes of data
+ */
+static WebsBlock *allocBlock(ssize size)
+{
+    WebsBlock   *bp;
+
+    if ((bp = walloc(sizeof(WebsBlock) + size)) == 0) {
+        error("Cannot allocate output");
+        return 0;
+    }
+    memset(bp, 0, sizeof(WebsBlock));
+    bp->start = bp->end = (char*) &bp[1];
+    bp->limit = bp->start + size;
+    bp->fd = -1;
+    return bp;
+}
+
+
+static void appendBlock(Webs *wp, WebsBlock *bp)
+{
+    bp->next = 0;
+    if (wp->txqTail) {
+        wp->txqTail->next = bp;
+    } else {
+        wp->txq = bp;
+    }
+    wp->txqTail = bp;
+}
+
+
+/*
+    Free a segment and release the memory or file it references
+ */
+static void freeBlock(WebsBlock *bp)
+{
+    if (bp->release) {
+        (bp->release)(bp->arg);
+    }
+    if (bp->fd >= 0 && bp->close) {
+        websCloseFile(bp->fd);
+    }
+    wfree(bp);
+}
+
+
+static void freeQueue(Webs *wp)
+{
+    WebsBlock   *bp, *next;
+
+    for (bp = wp->txq; bp; bp = next) {
+        next = bp->next;
+        freeBlock(bp);
+    }
+    wp->txq = wp->txqTail = 0;
+    wp->txqLen = 0;
+    wp->txChunk = 0;
+    wp->txPending = 0;
+}
+
+
+/*
+    Copy data to the output. Data is appended to the last data block while it has room. Other data is added in
+    new blocks so the caller never blocks. The event loop drains the output via writable events.
+ */
+static int putOutput(Webs *wp, char *buf, ssize size)
+{
+    WebsBlock   *bp;
+    ssize       len;
+
+    while (size > 0) {
+        if ((bp = wp->txqTail) == 0 || bp->end >= bp->limit) {
+            if ((bp = allocBlock(max(size, WEBS_TX_BLOCK))) == 0) {
+                return -1;
+            }
+            appendBlock(wp, bp);
+        }
+        len = min(bp->limit - bp->end, size);
+        memcpy(bp->end, buf, len);
+        bp->end += len;
+        buf += len;
+        size -= len;
+        wp->txqLen += len;
+    }
+    return 0;
+}
+
+
+/*
+    Start a transmit chunk. The prefix segment is formatted when the chunk is closed and its length is known.
+    When the response may yet be compressed, the segment has room to also add the Content-Encoding headers.
+ */
+static int openChunk(Webs *wp)
+{
+    WebsBlock   *bp;
+    ssize       size;
+
+    size = WEBS_CHUNK_PREFIX;
+#if WEBS_COMPRESS
+    if (wp->flags & WEBS_GZIP_PENDING) {
+        size += sizeof(gzipHeaders);
+    }
+#endif
+    if ((bp = allocBlock(size)) == 0) {
+        return -1;
+    }
+    /*
+        Chunk data must follow the prefix, so nothing may be appended to this segment
+     */
+    bp->limit = bp->end;
+    appendBlock(wp, bp);
+    wp->txChunk = bp;
+    wp->txPending = 0;
+    return 0;
+}
+
+
+/*
+    Close the open transmit chunk by formatting its prefix. The chunk prefix also terminates the headers or
+    the prior chunk.
+ */
+static void closeChunk(Webs *wp)
+{
+    WebsBlock   *bp;
+    ssize       len;
+
+    if ((bp = wp->txChunk) == 0) {
+        return;
+    }
+    if (wp->txPending > 0) {
+        fmt(bp->end, WEBS_CHUNK_PREFIX, "\r\n%x\r\n", (int) wp->txPending);
+        len = slen(bp->end);
+        bp->end += len;
+        bp->limit = bp->end;
+        wp->txqLen += len;
+    }
+    wp->txChunk = 0;
+    wp->txPending = 0;
+}
+
+
+#if WEBS_COMPRESS
+/*
+    Decide whether to compress a dynamic response. This is deferred until the body is first flushed so that small
+    responses can be sent uncompressed. The chunked response headers are not terminated until the first chunk prefix
+    is written, so the Content-Encoding header can still be added.
+ */
+static void startCompress(Webs *wp)
+{
+    z_stream    *zs;
+    WebsBlock   *bp, *data, *next;
+    ssize       len;
+
+    wp->flags &= ~WEBS_GZIP_PENDING;
+    if ((wp->flags & WEBS_FINALIZED) && wp->txPending < ME_GOAHEAD_LIMIT_COMPRESS) {
+        return;
+    }
+    if ((zs = walloc(sizeof(z_stream))) == 0) {
+        return;
+    }
+    memset(zs, 0, sizeof(z_stream));
+    /*
+        A window of 15 bits plus 16 selects the gzip format
+     */
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        wfree(zs);
+        return;
+    }
+    wp->zstream = zs;
+    wp->flags |= WEBS_GZIP;
+    trace(3 | WEBS_RAW_MSG, "%s", gzipHeaders);
+
+    if ((bp = wp->txChunk) == 0) {
+        putOutput(wp, gzipHeaders, sizeof(gzipHeaders) - 1);
+        return;
+    }
+    /*
+        Add the headers to the open chunk prefix segment (which has room reserved) and replace the chunk data
+        with its compressed form
+     */
+    len = sizeof(gzipHeaders) - 1;
+    memcpy(bp->end, gzipHeaders, len);
+    bp->end += len;
+    bp->limit = bp->end;
+    wp->txqLen += len;
+
+    data = bp->next;
+    bp->next = 0;
+    wp->txqTail = bp;
+    wp->txPending = 0;
+    for (; data; data = next) {
+        next = data->next;
+        len = data->end - data->start;
+        wp->txqLen -= len;
+        compressData(wp, data->start, len, Z_NO_FLUSH);
+        freeBlock(data);
+    }
+}
+
+
+/*
+    Compress data into the open chunk. The stream is finished if flush is Z_FINISH.
+ */
+static int compressData(Webs *wp, char *buf, ssize len, int flush)
+{
+    z_stream    *zs;
+    WebsBlock   *bp;
+    ssize       room, count;
+    int         rc;
+
+    if ((zs = wp->zstream) == 0) {
+        return 0;
+    }
+    zs->next_in = (Bytef*) buf;
+    zs->avail_in = (uInt) len;
+    do {
+        if (!wp->txChunk && openChunk(wp) < 0) {
+            return -1;
         }
-        if (smatch(wp->method, "HEAD")) {
-            websWriteHeader(wp, "Content-Length", "%d", (int) length);                                           
-        } else if (length >= 0) {                                                                                    
-            if (!((100 <= wp->code && wp->code <= 199) || wp->code == 204 || wp->code == 304)) {
-                websWriteHeader(wp, "Content-Length", "%d", (int) length);                                           
+        bp = wp->txqTail;
+        if (bp->end >= bp->limit) {
+            if ((bp = allocBlock(WEBS_TX_BLOCK)) == 0) {
+                return -1;
             }
+            appendBlock(wp, bp);
         }
-        wp->txLen = length;
-        if (wp->txLen < 0) {
-            websWriteHeader(wp, "Transfer-Encoding", "chunked");
-        }
-        if (wp->flags & WEBS_KEEP_ALIVE) {
-            websWriteHeader(wp, "Connection", "keep-alive");
-        } else {
-            websWriteHeader(wp, "Connection", "close");   
-        }
-        if (location) {
-            websWriteHeader(wp, "Location", "%s", location);
-        } else if ((key = hashLookup(websMime, wp->ext)) != 0) {
-            websWriteHeader(wp, "Content-Type", "%s", key->content.value.string);
-        }
-        if (wp->responseCookie) {
-            websWriteHeader(wp, "Set-Cookie", "%s", wp->responseCookie);
-            websWriteHeader(wp, "Cache-Control", "%s", "no-cache=\"set-cookie\"");
-        }
-#if defined(ME_GOAHEAD_CLIENT_CACHE)
-        if (wp->ext) {
-            char *etok = sfmt("%s,", &wp->ext[1]);
-            if (strstr(ME_GOAHEAD_CLIENT_CACHE ",", etok)) {
-                websWriteHeader(wp, "Cache-Control", "public, max-age=%d", ME_GOAHEAD_CLIENT_CACHE_LIFESPAN);
+        room = bp->limit - bp->end;
+        zs->next_out = (Bytef*) bp->end;
+        zs->avail_out = (uInt) room;
+        rc = deflate(zs, flush);
+        count = room - zs->avail_out;
+        bp->end += count;
+        wp->txqLen += count;
+        wp->txPending += count;
+
+        if (rc == Z_STREAM_END || (rc != Z_OK && rc != Z_BUF_ERROR)) {
+            deflateEnd(zs);
+            wfree(zs);
+            wp->zstream = 0;
+            if (rc != Z_STREAM_END) {
+                error("Cannot compress response, deflate error %d", rc);
+                return -1;
             }
-            wfree(etok);
-        }
-#endif
-#ifdef UNUSED_ME_GOAHEAD_XFRAME_HEADER
-        if (*ME_GOAHEAD_XFRAME_HEADER) {
-            websWriteHeader(wp, "X-Frame-Options", "%s", ME_GOAHEAD_XFRAME_HEADER);
+            break;
         }
-#endif
-    }
+    } while (rc != Z_BUF_ERROR && (zs->avail_in > 0 || zs->avail_out == 0 || flush == Z_FINISH));
+    return 0;
 }
+#endif
 
 
-PUBLIC void websWriteEndHeaders(Webs *wp)
+/*
+    Close the open chunk so it can be written. Once finalized, append the chunk trailer.
+ */
+static void finishChunks(Webs *wp)
 {
-    assert(wp);
-    /*
-        By omitting the "\r\n" delimiter after the headers, chunks can emit "\r\nSize\r\n" as a single chunk delimiter
-     */
-    if (wp->txLen >= 0) {
-        websWriteBlock(wp, "\r\n", 2);
+    trace(6, "websFlush chunking finalized %d", wp->flags & WEBS_FINALIZED);
+#if WEBS_COMPRESS
+    if (wp->flags & WEBS_GZIP_PENDING) {
+        startCompress(wp);
     }
-    wp->flags |= WEBS_HEADERS_CREATED;
-    if (wp->txLen < 0) {
-        wp->flags |= WEBS_CHUNKING;
+    if (wp->zstream && (wp->flags & WEBS_FINALIZED)) {
+        compressData(wp, 0, 0, Z_FINISH);
+    }
+#endif
+    closeChunk(wp);
+    if (wp->flags & WEBS_FINALIZED) {
+        trace(6, "websFlush: write chunk trailer");
+        putOutput(wp, "\r\n0\r\n\r\n", 7);
+        wp->flags &= ~WEBS_CHUNKING;
     }
 }
 
 
-PUBLIC void websSetTxLength(Webs *wp, ssize length)
+/*
+    Advance the output chain past written data and free the segments that have been fully written
+ */
+static void consumeOutput(Webs *wp, ssize written)
 {
-    assert(wp);
-    wp->txLen = length;
+    WebsBlock   *bp;
+    ssize       len;
+
+    while ((bp = wp->txq) != 0) {
+        if (bp->fd >= 0) {
+            len = min(written, bp->count);
+            bp->pos += len;
+            bp->count -= len;
+            written -= len;
+            if (bp->count > 0) {
+                break;
+            }
+        } else {
+            len = min(written, bp->end - bp->start);
+            bp->start += len;
+            wp->txqLen -= len;
+            written -= len;
+            if (bp->start < bp->end) {
+                break;
+            }
+        }
+        if ((wp->txq = bp->next) == 0) {
+            wp->txqTail = 0;
+        }
+        freeBlock(bp);
+    }
 }
 
 
 /*
-    Do formatted output to the browser. This is the public Javascript and form write procedure.
+    Write a file segment. This uses sendfile if possible, otherwise the file is read via the staging buffer.
  */
-PUBLIC ssize websWrite(Webs *wp, char *fmt, ...)
+static ssize writeFileSegment(Webs *wp, WebsBlock *bp)
 {
-    va_list     vargs;
-    char        *buf;
-    ssize       rc;
-    
-    assert(websValid(wp));
-    assert(fmt && *fmt);
-
-    va_start(vargs, fmt);
+    ssize   len;
 
-    buf = NULL;
-    rc = 0;
-    if ((buf = sfmtv(fmt, vargs)) == 0) {
-        error("websWrite lost data, buffer overflow");
+#if WEBS_SENDFILE
+    if (!(wp->flags & WEBS_SECURE)) {
+        return socketSendFile(wp->sid, bp->fd, bp->pos, bp->count);
     }
-    va_end(vargs);
-    assert(buf);
-    if (buf) {
-        rc = websWriteBlock(wp, buf, strlen(buf));
-        wfree(buf);
+#endif
+    len = min(bp->count, WEBS_TX_STAGE);
+    if (websSeekFile(bp->fd, bp->pos, SEEK_SET) != bp->pos || websReadFile(bp->fd, txStage, len) != len) {
+        error("Cannot read document data");
+        return -1;
     }
-    return rc;
+    return writeSocket(wp, txStage, len);
 }
 
 
 /*
-    Non-blocking write to socket. 
-    Returns number of bytes written. Returns -1 on errors. May return short.
+    Write the leading output segments with a single write. Data segments are written with a gathering write.
+    For TLS, small segments are batched into a single record. Returns the number of bytes written, zero if the
+    socket is full or < 0 on errors.
  */
-PUBLIC ssize websWriteSocket(Webs *wp, char *buf, ssize size)
+static ssize writeSegments(Webs *wp)
 {
-    ssize   written;
-
-    assert(wp);
-    assert(buf);
-    assert(size >= 0);
+    WebsBlock       *bp;
+    ssize           written, len;
+#if ME_UNIX_LIKE
+    struct iovec    iov[WEBS_TX_IOVEC];
+    int             count;
+#endif
 
     if (wp->flags & WEBS_CLOSED) {
         return -1;
     }
+    /*
+        Skip empty segments
+     */
+    consumeOutput(wp, 0);
+    if ((bp = wp->txq) == 0) {
+        return 0;
+    }
+    if (bp->fd >= 0) {
+        written = writeFileSegment(wp, bp);
 #if ME_COM_SSL
-    if (wp->flags & WEBS_SECURE) {
-        if ((written = sslWrite(wp, buf, size)) < 0) {
-            return -1;
+    } else if ((wp->flags & WEBS_SECURE) && (bp->end - bp->start) < WEBS_TX_STAGE && bp->next && bp->next->fd < 0) {
+        for (len = 0; bp && bp->fd < 0 && len < WEBS_TX_STAGE; bp = bp->next) {
+            memcpy(&txStage[len], bp->start, min(bp->end - bp->start, WEBS_TX_STAGE - len));
+            len += min(bp->end - bp->start, WEBS_TX_STAGE - len);
         }
-    } else 
+        written = writeSocket(wp, txStage, len);
+    } else if (wp->flags & WEBS_SECURE) {
+        written = writeSocket(wp, bp->start, bp->end - bp->start);
+#endif
+    } else {
+#if ME_UNIX_LIKE
+        for (count = 0; bp && bp->fd < 0 && count < WEBS_TX_IOVEC; bp = bp->next) {
+            if ((len = bp->end - bp->start) > 0) {
+                iov[count].iov_base = bp->start;
+                iov[count].iov_len = len;
+                count++;
+            }
+        }
+        written = socketWritev(wp->sid, iov, count);
+#else
+        written = writeSocket(wp, bp->start, bp->end - bp->start);
 #endif
-    if ((written = socketWrite(wp->sid, buf, size)) < 0) {
-        return -1;
     }
-    wp->written += written;
-    websNoteRequestActivity(wp);
+    if (written > 0) {
+        wp->written += written;
+        websNoteRequestActivity(wp);
+        consumeOutput(wp, written);
+    }
     return written;
 }
 
 
 /*
-    Write some output using transfer chunk encoding if required.
-    Returns true if all the data was written. Otherwise return zero.
+    Start writing output once enough has been written. If the socket did not absorb the prior output, wait until
+    as much again has been written before retrying so a slow client does not cost a write per call.
  */
-static bool flushChunkData(Webs *wp)
+static int autoFlush(Webs *wp)
 {
-    ssize   len, written, room;
-
-    assert(wp);
-
-    while (bufLen(&wp->chunkbuf) > 0) {
-        /*
-            Stop if there is not room for a reasonable size chunk.
-            Subtract 16 to allow for the final trailer.
-         */
-        if ((room = bufRoom(&wp->output) - 16) <= CHUNK_LOW) {
-            bufGrow(&wp->output, CHUNK_LOW - room + 1);
-            if ((room = bufRoom(&wp->output) - 16) <= CHUNK_LOW) {
-                return 0;
-            }
+    if (!(wp->flags & WEBS_HEADERS_CREATED)) {
+        return 0;
+    }
+    if (wp->txPending >= ME_GOAHEAD_LIMIT_BUFFER && wp->txPending >= (wp->txqLen - wp->txPending)) {
+        if (websFlush(wp, 0) < 0) {
+            return -1;
         }
-        switch (wp->txChunkState) {
-        default:
-        case WEBS_CHUNK_START:
-            /* Select the chunk size so that both the prefix and data will fit */
-            wp->txChunkLen = min(bufLen(&wp->chunkbuf), room - 16);
-            fmt(wp->txChunkPrefix, sizeof(wp->txChunkPrefix), "\r\n%x\r\n", wp->txChunkLen);
-            wp->txChunkPrefixLen = slen(wp->txChunkPrefix);
-            wp->txChunkPrefixNext = wp->txChunkPrefix;
-            wp->txChunkState = WEBS_CHUNK_HEADER;
-            break;
-
-        case WEBS_CHUNK_HEADER:
-            if ((written = bufPutBlk(&wp->output, wp->txChunkPrefixNext, wp->txChunkPrefixLen)) < 0) {
-                return 0;
-            } else {
-                wp->txChunkPrefixNext += written;
-                wp->txChunkPrefixLen -= written;
-                if (wp->txChunkPrefixLen <= 0) {
-                    wp->txChunkState = WEBS_CHUNK_DATA;
-                } else {
-                    return 0;
-                }
-            }
-            break;
-
-        case WEBS_CHUNK_DATA:
-            if (wp->txChunkLen > 0) {
-                len = min(room, wp->txChunkLen);
-                if ((written = bufPutBlk(&wp->output, wp->chunkbuf.servp, len)) != len) {
-                    assert(0);
-                    return -1;
-                }
-                bufAdjustStart(&wp->chunkbuf, written);
-                wp->txChunkLen -= written;
-                if (wp->txChunkLen <= 0) {
-                    wp->txChunkState = WEBS_CHUNK_START;
-                    bufCompact(&wp->chunkbuf);
-                }
-                bufAddNull(&wp->output);
-            }
+    }
+    if (wp->txqLen >= ME_GOAHEAD_LIMIT_TX_QUEUE) {
+        if (websFlush(wp, 0) < 0) {
+            return -1;
+        }
+        if (wp->txqLen >= ME_GOAHEAD_LIMIT_TX_QUEUE) {
+            /*
+                The handler is not heeding websWouldBlock and the client is not absorbing the output. Waiting for the
+                client would stall all other requests, so fail this request and close the connection.
+             */
+            error("Response exceeds the output queue limit of %d bytes, closing connection", ME_GOAHEAD_LIMIT_TX_QUEUE);
+            wp->flags &= ~WEBS_KEEP_ALIVE;
+            freeQueue(wp);
+            wp->state = WEBS_COMPLETE;
+            return -1;
         }
     }
-    return bufLen(&wp->chunkbuf) == 0;
+    return 0;
 }
 
 
 /*
-    Initiate flushing output buffer. Returns true if all data is written to the socket and the buffer is empty.
+    Initiate flushing the output. Returns true if all data is written to the socket and the output is empty.
     Returns <  0 for errors
             == 0 if there is output remaining to be flushed
             == 1 if the output was fully written to the socket
  */
 PUBLIC int websFlush(Webs *wp, bool block)
 {
-    WebsBuf     *op;
-    ssize       nbytes, written;
+    WebsSocket  *sp;
+    ssize       written;
     int         wasBlocking;
 
     if (block) {
         wasBlocking = socketSetBlock(wp->sid, 1);
     }
-    op = &wp->output;
     if (wp->flags & WEBS_CHUNKING) {
-        trace(6, "websFlush chunking finalized %d", wp->flags & WEBS_FINALIZED);
-        if (flushChunkData(wp) && wp->flags & WEBS_FINALIZED) {
-            trace(6, "websFlush: write chunk trailer");
-            bufPutStr(op, "\r\n0\r\n\r\n");
-            bufAddNull(op);
-            wp->flags &= ~WEBS_CHUNKING;
-        }
+        finishChunks(wp);
     }
-    trace(6, "websFlush: buflen %d", bufLen(op));
+    wp->txPending = 0;
+    trace(6, "websFlush: queued %d", wp->txqLen);
     written = 0;
-    while ((nbytes = bufLen(op)) > 0) {
-        if ((written = websWriteSocket(wp, op->servp, nbytes)) < 0) {
-            wp->flags &= ~WEBS_KEEP_ALIVE;
-            bufFlush(op);
-            wp->state = WEBS_COMPLETE;
-            break;
-        } else if (written == 0) {
-            break;
-        }
+    while (wp->txq && (written = writeSegments(wp)) > 0) {
         trace(6, "websFlush: wrote %d to socket", written);
-        bufAdjustStart(op, written);
-        bufCompact(op);
-        nbytes = bufLen(op);
+    }
+    if (written < 0) {
+        wp->flags &= ~WEBS_KEEP_ALIVE;
+        freeQueue(wp);
+        wp->state = WEBS_COMPLETE;
     }
     assert(websValid(wp));
 
-    if (bufLen(op) == 0 && wp->flags & WEBS_FINALIZED) {
-        wp->state = WEBS_COMPLETE;
+    if (!wp->txq) {
+        wp->pipelined = 0;
+        if (wp->flags & WEBS_FINALIZED) {
+            wp->state = WEBS_COMPLETE;
+        }
+    } else if (!block && wp->sid >= 0) {
+        /*
+            Drain the remaining output via writable events
+         */
+        sp = socketPtr(wp->sid);
+        if (!(sp->handlerMask & SOCKET_WRITABLE)) {
+            socketCreateHandler(wp->sid, sp->handlerMask | SOCKET_WRITABLE, socketEvent, wp);
+        }
     }
     if (block) {
         socketSetBlock(wp->sid, wasBlocking);
@@ -2118,7 +3167,7 @@ PUBLIC int websFlush(Webs *wp, bool block)
     if (written < 0) {
         return -1;
     }
-    return bufLen(op) == 0;
+    return wp->txq == 0;
 }
 
 
@@ -2129,13 +3178,24 @@ PUBLIC int websFlush(Webs *wp, bool block)
  */
 static void writeEvent(Webs *wp)
 {
-    WebsBuf     *op;
+    WebsSocket  *sp;
+    int         mask;
 
-    op = &wp->output;
-    if (bufLen(op) > 0) {
+    if (wp->txq) {
         websFlush(wp, 0);
+        if (!wp->txq && !wp->writeData && wp->state < WEBS_COMPLETE && wp->sid >= 0) {
+            /*
+                The output has drained. Stop writable events and resume reading if paused by the pipeline limit.
+             */
+            sp = socketPtr(wp->sid);
+            mask = sp->handlerMask & ~SOCKET_WRITABLE;
+            if (wp->state == WEBS_BEGIN) {
+                mask |= SOCKET_READABLE;
+            }
+            socketCreateHandler(wp->sid, mask, socketEvent, wp);
+        }
     }
-    if (bufLen(op) == 0 && wp->writeData) {
+    if (!wp->txq && wp->writeData) {
         (wp->writeData)(wp);
     }
     if (wp->state != WEBS_RUNNING) {
@@ -2147,17 +3207,14 @@ static void writeEvent(Webs *wp)
 PUBLIC void websSetBackgroundWriter(Webs *wp, WebsWriteProc proc)
 {
     WebsSocket  *sp;
-    WebsBuf     *op;
 
     assert(proc);
 
     wp->writeData = proc;
-    op = &wp->output;
-
-    if (bufLen(op) > 0) {
+    if (wp->txq) {
         websFlush(wp, 0);
     }
-    if (bufLen(op) == 0) {
+    if (!wp->txq) {
         (wp->writeData)(wp);
     }
     if (wp->sid >= 0 && wp->state < WEBS_COMPLETE) {
@@ -2199,9 +3256,6 @@ PUBLIC char *websGetUsername(Webs *wp) { return wp->username; }
  */
 PUBLIC ssize websWriteBlock(Webs *wp, char *buf, ssize size)
 {
-    WebsBuf     *op;
-    ssize       written, thisWrite, len, room;
-
     assert(wp);
     assert(websValid(wp));
     assert(buf);
@@ -2210,32 +3264,125 @@ PUBLIC ssize websWriteBlock(Webs *wp, char *buf, ssize size)
     if (wp->state >= WEBS_COMPLETE) {
         return -1;
     }
-    op = (wp->flags & WEBS_CHUNKING) ? &wp->chunkbuf : &wp->output;
-    written = len = 0;
-
-    while (size > 0 && wp->state < WEBS_COMPLETE) {  
-        if (bufRoom(op) < size) {
-            /*
-                This will do a blocking I/O write. Will only ever fail for I/O errors.
-             */
-            if (websFlush(wp, 1) < 0) {
+    if (size > 0) {
+#if WEBS_COMPRESS
+        if (wp->zstream) {
+            if (compressData(wp, buf, size, Z_NO_FLUSH) < 0) {
                 return -1;
             }
+        } else
+#endif
+        {
+            if ((wp->flags & WEBS_CHUNKING) && !wp->txChunk && openChunk(wp) < 0) {
+                return -1;
+            }
+            if (putOutput(wp, buf, size) < 0) {
+                return -1;
+            }
+            wp->txPending += size;
         }
-        if ((room = bufRoom(op)) == 0) {
-            break;
-        }
-        thisWrite = min(room, size);
-        bufPutBlk(op, buf, thisWrite);
-        size -= thisWrite;
-        buf += thisWrite;
-        written += thisWrite;
     }
-    bufAddNull(op);
-    if (wp->state >= WEBS_COMPLETE && written == 0) {
+    if (autoFlush(wp) < 0) {
         return -1;
     }
-    return written;
+    return size;
+}
+
+
+PUBLIC ssize websWriteReference(Webs *wp, char *buf, ssize size, WebsReleaseProc release, void *arg)
+{
+    WebsBlock   *bp;
+    ssize       rc;
+
+    assert(wp);
+    assert(websValid(wp));
+    assert(buf);
+    assert(size >= 0);
+
+    if (wp->state >= WEBS_COMPLETE) {
+        rc = -1;
+
+    } else if (size < WEBS_TX_COPY || COMPRESSING(wp)) {
+        /*
+            Small blocks are cheaper to copy. Compressed output cannot reference the data.
+         */
+        rc = websWriteBlock(wp, buf, size);
+
+    } else {
+        if ((wp->flags & WEBS_CHUNKING) && !wp->txChunk && openChunk(wp) < 0) {
+            rc = -1;
+        } else if ((bp = allocBlock(0)) == 0) {
+            rc = -1;
+        } else {
+            bp->start = buf;
+            bp->end = bp->limit = buf + size;
+            bp->release = release;
+            bp->arg = arg;
+            appendBlock(wp, bp);
+            wp->txqLen += size;
+            wp->txPending += size;
+            return autoFlush(wp) < 0 ? -1 : size;
+        }
+    }
+    if (release) {
+        (release)(arg);
+    }
+    return rc;
+}
+
+
+PUBLIC ssize websSendFile(Webs *wp, int fd, Offset pos, ssize len, bool close)
+{
+    WebsBlock   *bp;
+    ssize       rc, nbytes;
+
+    assert(wp);
+    assert(websValid(wp));
+    assert(fd >= 0);
+    assert(len >= 0);
+
+    if (wp->state >= WEBS_COMPLETE) {
+        rc = -1;
+
+    } else if ((wp->flags & WEBS_GZIP_PENDING) || COMPRESSING(wp)) {
+        /*
+            Compressed output must read the file data
+         */
+        for (rc = 0; rc < len; rc += nbytes) {
+            nbytes = min(len - rc, WEBS_TX_STAGE);
+            if (websSeekFile(fd, pos + rc, SEEK_SET) != pos + rc || websReadFile(fd, txStage, nbytes) != nbytes ||
+                    websWriteBlock(wp, txStage, nbytes) < 0) {
+                rc = -1;
+                break;
+            }
+        }
+
+    } else {
+        if ((wp->flags & WEBS_CHUNKING) && !wp->txChunk && openChunk(wp) < 0) {
+            rc = -1;
+        } else if ((bp = allocBlock(0)) == 0) {
+            rc = -1;
+        } else {
+            bp->fd = fd;
+            bp->pos = pos;
+            bp->count = len;
+            bp->close = close;
+            appendBlock(wp, bp);
+            wp->txPending += len;
+            return autoFlush(wp) < 0 ? -1 : len;
+        }
+    }
+    if (close) {
+        websCloseFile(fd);
+    }
+    return rc;
+}
+
+
+PUBLIC bool websWouldBlock(Webs *wp)
+{
+    assert(wp);
+    return wp->txqLen >= ME_GOAHEAD_LIMIT_TX_HIGH_WATER;
 }
 
 
@@ -2344,7 +3491,7 @@ static void checkTimeout(void *arg, int id)
     wp = (Webs*) arg;
     assert(websValid(wp));
 
-    elapsed = getTimeSinceMark(wp) * 1000;
+    elapsed = getTimeSinceMark(wp);
     if (websDebug) {
         websRestartEvent(id, (int) WEBS_TIMEOUT);
         return;
@@ -2478,10 +3625,12 @@ PUBLIC void websSetRequestFilename(Webs *wp, char *filename)
 
 PUBLIC int websRewriteRequest(Webs *wp, char *url)
 {
-    char    *buf, *path;
+    char    *buf, *path, *clone;
 
-    wfree(wp->url);
-    wp->url = sclone(url);
+    if ((clone = websArenaClone(wp, url)) == 0) {
+        return -1;
+    }
+    wp->url = clone;
     wfree(wp->path);
     wp->path = 0;
 
@@ -2510,6 +3659,17 @@ PUBLIC bool websValid(Webs *wp)
 }
 
 
+PUBLIC char *websGetMimeType(Webs *wp)
+{
+    WebsKey     *key;
+
+    if (wp->ext && (key = hashLookup(websMime, wp->ext)) != 0 && key->content.type == string) {
+        return key->content.value.string;
+    }
+    return 0;
+}
+
+
 /*
     Build an ASCII time string.  If sbuf is NULL we use the current time, else we use the last modified time of sbuf;
  */
@@ -2542,21 +3702,22 @@ PUBLIC char *websGetDateString(WebsFileInfo *sbuf)
 
 
 /*
-    Take not of the request activity and mark the time. Set a timestamp so that, later, we can return the number of seconds
-    since we made the mark.
+    Take note of the request activity and mark the time. Set a timestamp so that, later, we can return the number of
+    milliseconds since we made the mark. This uses the event loop's cached time and does not need a system call. 
+    The request timeout event is not rescheduled here. Rather, checkTimeout uses the mark when it runs.
  */
 PUBLIC void websNoteRequestActivity(Webs *wp)
 {
-    wp->timestamp = time(0);
+    wp->timestamp = websGetTicks();
 }
 
 
 /*
-    Get the number of seconds since the last mark.
+    Get the number of milliseconds since the last mark.
  */
 static WebsTime getTimeSinceMark(Webs *wp)
 {
-    return time(0) - wp->timestamp;
+    return (WebsTime) (websGetTicks() - wp->timestamp);
 }
 
 
@@ -3079,6 +4240,21 @@ static WebsTime dateParse(WebsTime tip, char *cmd)
 }
 
 
+PUBLIC WebsTime websParseDate(char *value)
+{
+    WebsTime    when;
+    char        *cmd;
+
+    if (value == 0 || *value == '\0') {
+        return 0;
+    }
+    cmd = sclone(value);
+    when = dateParse(0, cmd);
+    wfree(cmd);
+    return when;
+}
+
+
 PUBLIC bool websValidUriChars(char *uri)
 {
     ssize   pos;
@@ -3387,6 +4563,9 @@ PUBLIC void websPageClose(Webs *wp)
         websCloseFile(wp->docfd);
         wp->docfd = -1;
     }
+#if WEBS_FILE_CACHE
+    websReleaseCachedFile(wp);
+#endif
 }
 
 
@@ -3550,6 +4729,18 @@ PUBLIC void websSetDebug(int on)
 }
 
 
+PUBLIC int websGetWorkers() 
+{
+    return websWorkers;
+}
+
+
+PUBLIC void websSetWorkers(int count) 
+{
+    websWorkers = max(count, 0);
+}
+
+
 static char *makeSessionID(Webs *wp)
 {
     char        idBuf[64];
@@ -3615,6 +4806,9 @@ WebsSession *websGetSession(Webs *wp, int create)
                 wfree(id);
                 return 0;
             }
+            if (websWorkers > 1 && sessionCount == 0) {
+                error("Sessions are not shared by worker processes. Clients may lose their session state.");
+            }
             sessionCount++;
             if ((wp->session = websAllocSession(wp, id, ME_GOAHEAD_LIMIT_SESSION_LIFE)) == 0) {
                 wfree(id);
@@ -10,78 +10,343 @@
 #include    "js.h"
 
 #if ME_GOAHEAD_JAVASCRIPT
+/*********************************** Defines **********************************/
+/*
+    Compiled template node types
+ */
+#define JST_TEXT            1           /* Literal page text */
+#define JST_CALL            2           /* Pre-parsed function call: fn(arg, ...); */
+#define JST_SCRIPT          3           /* Script evaluated by the Javascript interpreter */
+#define JST_UNTERMINATED    4           /* Script missing the closing "%>" */
+
+#define JST_MAX_ARGS        16          /* Maximum arguments for a pre-parsed call */
+
+/*
+    A template is compiled into a list of nodes. Text and script nodes reference the page buffer. Call nodes own their
+    function name and decoded argument values. Their script is retained to report errors via the interpreter.
+ */
+typedef struct JstNode {
+    int             type;               /* Node type */
+    char            *text;              /* Literal text or script source */
+    ssize           len;                /* Length of literal text */
+    char            *name;              /* Function name for calls */
+    char            **argv;             /* Literal argument values or variable names for calls */
+    int             argc;               /* Count of call arguments */
+    int             vars;               /* Bit mask of call arguments that are variable names */
+} JstNode;
+
+/*
+    Compiled template. Pages are cached by filename and recompiled when the file modification time, size or inode 
+    changes. A page compiled in the same second the file was modified may miss a later change in that second and is
+    always recompiled. Rendered text is written by reference, so a page replaced while its text is still being 
+    written is freed when the last reference is released.
+ */
+typedef struct JstPage {
+    char            *filename;          /* Page filename (cache key) */
+    char            *buf;               /* Page content */
+    JstNode         *nodes;             /* Compiled nodes */
+    int             count;              /* Count of nodes */
+    int             max;                /* Size of nodes */
+    int             refs;               /* Count of requests and output segments using the page */
+    int             removed;            /* Not in the cache. Free when refs reaches zero */
+    WebsFileInfo    info;               /* File status when compiled */
+    WebsTime        compiled;           /* When the page was compiled */
+} JstPage;
+
+/*
+    Rendering state for a request. Rendering is suspended between nodes while the client is not absorbing the output
+    and resumed by a background writer once the output has drained.
+ */
+typedef struct JstRender {
+    JstPage         *page;              /* Page being rendered */
+    JstNode         *np;                /* Next node to render */
+    int             jid;                /* Javascript engine or -1 if not yet created */
+} JstRender;
+
 /********************************** Locals ************************************/
 
 static WebsHash websJstFunctions = -1;  /* Symbol table of functions */
+#if ME_GOAHEAD_JST_CACHE
+static WebsHash jstCache = -1;          /* Compiled pages by filename */
+#endif
 
 /***************************** Forward Declarations ***************************/
 
+static JstNode *addNode(JstPage *page, int type, char *text, ssize len);
+static int callFunction(Webs *wp, int jid, JstNode *np, char **emsg);
+static JstPage *compilePage(Webs *wp, WebsFileInfo *info);
+static void freePage(JstPage *page);
+static JstPage *getPage(Webs *wp, WebsFileInfo *info);
+static ssize nameLength(char *s);
+static char *parseArg(char *cp, char **value, bool *isVar);
+static bool parseCall(JstNode *np, char *script);
+static void releasePage(void *arg);
+#if ME_GOAHEAD_JST_CACHE
+static void removePage(JstPage *page);
+#endif
+static int renderPage(Webs *wp, JstRender *rp);
+static void resumePage(Webs *wp);
 static char *strtokcmp(char *s1, char *s2);
 static char *skipWhite(char *s);
 
 /************************************* Code ***********************************/
 /*
-    Process requests and expand all scripting commands. We read the entire web page into memory and then process. If
-    you have really big documents, it is better to make them plain HTML files rather than Javascript web pages.
+    Process requests and expand all scripting commands. Pages are compiled once into literal text and script nodes
+    and cached. Literal text is written by reference to the cached page and simple function calls are invoked 
+    without the interpreter. If you have really big documents, it is better to make them plain HTML files rather 
+    than Javascript web pages.
  */
 static bool jstHandler(Webs *wp)
 {
     WebsFileInfo    sbuf;
-    char            *token, *lang, *result, *ep, *cp, *buf, *nextp, *last;
-    ssize           len;
-    int             rc, jid;
+    JstPage         *page;
+    JstRender       *rp;
 
     assert(websValid(wp));
     assert(wp->filename && *wp->filename);
     assert(wp->ext && *wp->ext);
 
-    buf = 0;
-    if ((jid = jsOpenEngine(wp->vars, websJstFunctions)) < 0) {
-        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot create JavaScript engine");
-        goto done;
-    }
-    jsSetUserHandle(jid, wp);
-
     if (websPageStat(wp, &sbuf) < 0) {
         websError(wp, HTTP_CODE_NOT_FOUND, "Cannot stat %s", wp->filename);
-        goto done;
+
+    } else if ((page = getPage(wp, &sbuf)) != 0) {
+        if ((rp = walloc(sizeof(JstRender))) == 0) {
+            websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot allocate render state");
+        } else {
+            /*
+                Hold a reference so the page survives recompilation while it is being rendered
+             */
+            page->refs++;
+            rp->page = page;
+            rp->np = page->nodes;
+            rp->jid = -1;
+            wp->jst = rp;
+            websWriteHeaders(wp, (ssize) -1, 0);
+            websWriteHeader(wp, "Pragma", "no-cache");
+            websWriteHeader(wp, "Cache-Control", "no-cache");
+            websWriteEndHeaders(wp);
+            resumePage(wp);
+            return 1;
+        }
+    }
+    websDone(wp);
+    return 1;
+}
+
+
+/*
+    Render the page until it is complete or the client is not keeping up. Also called as a background writer once
+    the output has drained.
+ */
+static void resumePage(Webs *wp)
+{
+    WebsSocket  *sp;
+
+    if (wp->writeData) {
+        wp->writeData = 0;
+        if (wp->sid >= 0) {
+            sp = socketPtr(wp->sid);
+            socketRegisterInterest(wp->sid, sp->handlerMask & ~SOCKET_WRITABLE);
+        }
+    }
+    if (renderPage(wp, wp->jst)) {
+        wp->writeData = resumePage;
+        return;
+    }
+    websJstAbort(wp);
+    websDone(wp);
+}
+
+
+/*
+    Render a compiled page from the next node. The Javascript engine is only created if the page contains scripts.
+    Return 1 if rendering is suspended until the output drains, or 0 if rendering is complete.
+ */
+static int renderPage(Webs *wp, JstRender *rp)
+{
+    JstPage     *page;
+    JstNode     *np;
+    char        *result;
+    int         rc;
+
+    page = rp->page;
+    for (; rp->np < &page->nodes[page->count]; rp->np++) {
+        np = rp->np;
+        if (websWouldBlock(wp) && websFlush(wp, 0) == 0 && websWouldBlock(wp)) {
+            return 1;
+        }
+        if (wp->state >= WEBS_COMPLETE) {
+            /* Writing failed */
+            break;
+        }
+        if (np->type == JST_TEXT) {
+            page->refs++;
+            websWriteReference(wp, np->text, np->len, releasePage, page);
+            continue;
+        }
+        if (np->type == JST_UNTERMINATED) {
+            websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Unterminated script in %s: \n", wp->filename);
+            break;
+        }
+        if (rp->jid < 0) {
+            websSetHeaderVars(wp);
+            if ((rp->jid = jsOpenEngine(wp->vars, websJstFunctions)) < 0) {
+                websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot create JavaScript engine");
+                break;
+            }
+            jsSetUserHandle(rp->jid, wp);
+        }
+        result = NULL;
+        rc = (np->type == JST_CALL) ? callFunction(wp, rp->jid, np, &result) : 0;
+        if (rc == 0 && jsEval(rp->jid, np->text, &result) == 0) {
+            rc = -1;
+        }
+        if (rc < 0) {
+            /*
+                On an error, discard all output accumulated so far and store the error in the result buffer. 
+                Be careful if the user has called websError() already.
+             */
+            if (websValid(wp)) {
+                if (result) {
+                    websWrite(wp, "<h2><b>Javascript Error: %s</b></h2>\n", result);
+                    websWrite(wp, "<pre>%s</pre>", np->text);
+                    wfree(result);
+                } else {
+                    websWrite(wp, "<h2><b>Javascript Error</b></h2>\n%s\n", np->text);
+                }
+                websWrite(wp, "</body></html>\n");
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+
+/*
+    Invoke a pre-parsed function call. Return 1 if the function was called, or 0 if the function or a variable is not
+    defined and the script must be evaluated to report the error. Return -1 if the function fails.
+ */
+static int callFunction(Webs *wp, int jid, JstNode *np, char **emsg)
+{
+    WebsKey     *sp;
+    JsProc      fn;
+    char        *argv[JST_MAX_ARGS + 1];
+    int         i, rc;
+
+    if ((sp = hashLookup(websJstFunctions, np->name)) == NULL || (fn = (JsProc) sp->content.value.symbol) == NULL) {
+        return 0;
+    }
+    for (i = 0; i < np->argc; i++) {
+        argv[i] = np->argv[i];
+        if ((np->vars & (1 << i)) && (jsGetVar(jid, np->argv[i], &argv[i]) < 0 || argv[i] == NULL)) {
+            return 0;
+        }
+    }
+    /*
+        Functions receive their own null terminated copy of the arguments as they do from the interpreter
+     */
+    for (i = 0; i < np->argc; i++) {
+        argv[i] = sclone(argv[i]);
+    }
+    argv[i] = NULL;
+    rc = (*fn)(jid, wp, np->argc, argv);
+    for (i = 0; i < np->argc; i++) {
+        wfree(argv[i]);
+    }
+    if (rc < 0) {
+        /* The interpreter reports a failed function with an empty message */
+        *emsg = sclone(NULL);
+        return -1;
+    }
+    return 1;
+}
+
+
+/*
+    Get the compiled page for the request filename. Cached pages are used while the file is unchanged.
+ */
+static JstPage *getPage(Webs *wp, WebsFileInfo *info)
+{
+    JstPage     *page;
+#if ME_GOAHEAD_JST_CACHE
+    WebsKey     *key;
+
+    if ((key = hashLookup(jstCache, wp->filename)) != 0) {
+        page = (JstPage*) key->content.value.symbol;
+        if (page->info.mtime == info->mtime && page->info.size == info->size && page->info.inode == info->inode &&
+                page->compiled > info->mtime) {
+            return page;
+        }
+        removePage(page);
+    }
+#endif
+    if ((page = compilePage(wp, info)) == 0) {
+        return 0;
     }
+#if ME_GOAHEAD_JST_CACHE
+    hashEnter(jstCache, page->filename, valueSymbol(page), 0);
+#else
+    page->removed = 1;
+#endif
+    return page;
+}
+
+
+/*
+    Read and compile a page. The page is scanned for "<% script %>" sections once. Script text is terminated in place 
+    in the page buffer and scripts that are a single function call are pre-parsed.
+ */
+static JstPage *compilePage(Webs *wp, WebsFileInfo *info)
+{
+    JstPage     *page;
+    JstNode     *np;
+    char        *lang, *ep, *cp, *buf, *nextp, *last;
+    ssize       len;
+    int         rc;
+
     if (websPageOpen(wp, O_RDONLY | O_BINARY, 0666) < 0) {
         websError(wp, HTTP_CODE_NOT_FOUND, "Cannot open URL: %s", wp->filename);
-        goto done;
+        return 0;
     }
     /*
         Create a buffer to hold the web page in-memory
      */
-    len = sbuf.size;
-    if ((buf = walloc(len + 1)) == NULL) {
+    len = info->size;
+    if ((page = walloc(sizeof(JstPage))) == NULL || (buf = walloc(len + 1)) == NULL) {
+        websPageClose(wp);
+        wfree(page);
         websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot get memory");
-        goto done;
+        return 0;
     }
+    memset(page, 0, sizeof(JstPage));
+    page->buf = buf;
+    page->info = *info;
+    page->compiled = time(0);
+    page->filename = sclone(wp->filename);
     buf[len] = '\0';
 
     if (websPageReadData(wp, buf, len) != len) {
+        websPageClose(wp);
+        freePage(page);
         websError(wp, HTTP_CODE_NOT_FOUND, "Cant read %s", wp->filename);
-        goto done;
+        return 0;
     }
     websPageClose(wp);
-    websWriteHeaders(wp, (ssize) -1, 0);
-    websWriteHeader(wp, "Pragma", "no-cache");
-    websWriteHeader(wp, "Cache-Control", "no-cache");
-    websWriteEndHeaders(wp);
 
     /*
         Scan for the next "<%"
      */
-    last = buf;
-    for (rc = 0; rc == 0 && *last && ((nextp = strstr(last, "<%")) != NULL); ) {
-        websWriteBlock(wp, last, (nextp - last));
+    for (rc = 0, last = buf; rc == 0 && *last && ((nextp = strstr(last, "<%")) != NULL); ) {
+        if (nextp > last && addNode(page, JST_TEXT, last, nextp - last) == 0) {
+            rc = -1;
+            break;
+        }
         nextp = skipWhite(nextp + 2);
         /*
             Decode the language
          */
-        token = "language";
-        if ((lang = strtokcmp(nextp, token)) != NULL) {
+        if ((lang = strtokcmp(nextp, "language")) != NULL) {
             if ((cp = strtokcmp(lang, "=javascript")) != NULL) {
                 /* Ignore */;
             } else {
@@ -89,82 +354,276 @@ static bool jstHandler(Webs *wp)
             }
             nextp = cp;
         }
-
         /*
-            Find tailing bracket and then evaluate the script
+            Find the trailing bracket
          */
-        if ((ep = strstr(nextp, "%>")) != NULL) {
-
-            *ep = '\0';
-            last = ep + 2;
-            nextp = skipWhite(nextp);
-            /*
-                Handle backquoted newlines
-             */
-            for (cp = nextp; *cp; ) {
-                if (*cp == '\\' && (cp[1] == '\r' || cp[1] == '\n')) {
+        if ((ep = strstr(nextp, "%>")) == NULL) {
+            rc = addNode(page, JST_UNTERMINATED, 0, 0) ? 1 : -1;
+            break;
+        }
+        *ep = '\0';
+        last = ep + 2;
+        nextp = skipWhite(nextp);
+        /*
+            Handle backquoted newlines
+         */
+        for (cp = nextp; *cp; ) {
+            if (*cp == '\\' && (cp[1] == '\r' || cp[1] == '\n')) {
+                *cp++ = ' ';
+                while (*cp == '\r' || *cp == '\n') {
                     *cp++ = ' ';
-                    while (*cp == '\r' || *cp == '\n') {
-                        *cp++ = ' ';
-                    }
-                } else {
-                    cp++;
                 }
+            } else {
+                cp++;
             }
-            if (*nextp) {
-                result = NULL;
-
-                if (jsEval(jid, nextp, &result) == 0) {
-                    /*
-                         On an error, discard all output accumulated so far and store the error in the result buffer. 
-                         Be careful if the user has called websError() already.
-                     */
-                    rc = -1;
-                    if (websValid(wp)) {
-                        if (result) {
-                            websWrite(wp, "<h2><b>Javascript Error: %s</b></h2>\n", result);
-                            websWrite(wp, "<pre>%s</pre>", nextp);
-                            wfree(result);
-                        } else {
-                            websWrite(wp, "<h2><b>Javascript Error</b></h2>\n%s\n", nextp);
-                        }
-                        websWrite(wp, "</body></html>\n");
-                        rc = 0;
-                    }
-                    goto done;
-                }
+        }
+        if (*nextp) {
+            if ((np = addNode(page, JST_SCRIPT, nextp, 0)) == 0) {
+                rc = -1;
+            } else if (parseCall(np, nextp)) {
+                np->type = JST_CALL;
             }
+        }
+    }
+    /*
+        Trailing HTML page text
+     */
+    if (rc == 0 && *last && addNode(page, JST_TEXT, last, slen(last)) == 0) {
+        rc = -1;
+    }
+    if (rc < 0) {
+        freePage(page);
+        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot get memory");
+        return 0;
+    }
+    return page;
+}
 
-        } else {
-            websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Unterminated script in %s: \n", wp->filename);
-            goto done;
+
+static JstNode *addNode(JstPage *page, int type, char *text, ssize len)
+{
+    JstNode     *np;
+
+    if (page->count >= page->max) {
+        if ((np = wrealloc(page->nodes, (page->max + 16) * sizeof(JstNode))) == 0) {
+            return 0;
+        }
+        page->nodes = np;
+        page->max += 16;
+    }
+    np = &page->nodes[page->count++];
+    memset(np, 0, sizeof(JstNode));
+    np->type = type;
+    np->text = text;
+    np->len = len;
+    return np;
+}
+
+
+/*
+    Pre-parse a script that is a single function call with string, integer or variable arguments: fn(arg, ...);
+    Return false to leave other scripts for the interpreter.
+ */
+static bool parseCall(JstNode *np, char *script)
+{
+    char    *argv[JST_MAX_ARGS], *cp;
+    ssize   len;
+    bool    isVar;
+    int     argc, vars, i;
+
+    if ((len = nameLength(script)) == 0) {
+        return 0;
+    }
+    cp = skipWhite(&script[len]);
+    if (*cp != '(') {
+        return 0;
+    }
+    cp = skipWhite(cp + 1);
+    argc = vars = 0;
+    if (*cp != ')') {
+        for (;;) {
+            if (argc >= JST_MAX_ARGS || (cp = parseArg(cp, &argv[argc], &isVar)) == 0) {
+                break;
+            }
+            if (isVar) {
+                vars |= (1 << argc);
+            }
+            argc++;
+            cp = skipWhite(cp);
+            if (*cp != ',') {
+                break;
+            }
+            cp = skipWhite(cp + 1);
         }
     }
     /*
-        Output any trailing HTML page text
+        The interpreter requires a terminating semicolon
      */
-    if (last && *last && rc == 0) {
-        websWriteBlock(wp, last, strlen(last));
+    if (cp && *cp == ')') {
+        cp = skipWhite(cp + 1);
+        if (*cp == ';' && *skipWhite(cp + 1) == '\0') {
+            np->name = walloc(len + 1);
+            memcpy(np->name, script, len);
+            np->name[len] = '\0';
+            if (argc > 0) {
+                np->argv = walloc(argc * sizeof(char*));
+                memcpy(np->argv, argv, argc * sizeof(char*));
+            }
+            np->argc = argc;
+            np->vars = vars;
+            return 1;
+        }
+    }
+    for (i = 0; i < argc; i++) {
+        wfree(argv[i]);
     }
+    return 0;
+}
+
 
 /*
-    Common exit and cleanup
+    Parse a call argument. Strings with octal, hex or unicode escapes are left for the interpreter.
  */
-done:
-    if (websValid(wp)) {
-        websPageClose(wp);
-        if (jid >= 0) {
-            jsCloseEngine(jid);
+static char *parseArg(char *cp, char **value, bool *isVar)
+{
+    char    *dp, quote;
+    ssize   len;
+
+    *isVar = 0;
+    if (*cp == '\"' || *cp == '\'') {
+        quote = *cp++;
+        for (len = 0; cp[len] && cp[len] != quote; len++) {
+            if (cp[len] == '\\' && cp[len + 1]) {
+                len++;
+            }
+        }
+        if (cp[len] != quote) {
+            return 0;
         }
+        *value = dp = walloc(len + 1);
+        for (; *cp != quote; cp++) {
+            if (*cp == '\\') {
+                switch (*++cp) {
+                case 'n': *dp++ = '\n'; break;
+                case 'b': *dp++ = '\b'; break;
+                case 'f': *dp++ = '\f'; break;
+                case 'r': *dp++ = '\r'; break;
+                case 't': *dp++ = '\t'; break;
+                case '\'':
+                case '\"':
+                case '\\':
+                    *dp++ = *cp;
+                    break;
+                default:
+                    wfree(*value);
+                    return 0;
+                }
+            } else {
+                *dp++ = *cp;
+            }
+        }
+        *dp = '\0';
+        return cp + 1;
     }
-    websDone(wp);
-    wfree(buf);
-    return 1;
+    if (isdigit((uchar) *cp)) {
+        for (len = 0; isdigit((uchar) cp[len]); len++) ;
+    } else if ((len = nameLength(cp)) > 0) {
+        *isVar = 1;
+    } else {
+        return 0;
+    }
+    *value = walloc(len + 1);
+    memcpy(*value, cp, len);
+    (*value)[len] = '\0';
+    return cp + len;
+}
+
+
+/*
+    Return the length of the identifier at s. Reserved words and "null" are not accepted.
+ */
+static ssize nameLength(char *s)
+{
+    static char *reserved[] = { "if", "else", "var", "for", "return", "null", 0 };
+    char        **rp;
+    ssize       len;
+
+    if (!isalpha((uchar) *s) && *s != '$' && *s != '_') {
+        return 0;
+    }
+    for (len = 1; isalnum((uchar) s[len]) || s[len] == '$' || s[len] == '_'; len++) ;
+    for (rp = reserved; *rp; rp++) {
+        if (slen(*rp) == len && strncmp(s, *rp, len) == 0) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+
+static void freePage(JstPage *page)
+{
+    JstNode     *np;
+    int         i;
+
+    for (np = page->nodes; np < &page->nodes[page->count]; np++) {
+        if (np->type == JST_CALL) {
+            for (i = 0; i < np->argc; i++) {
+                wfree(np->argv[i]);
+            }
+            wfree(np->argv);
+            wfree(np->name);
+        }
+    }
+    wfree(page->nodes);
+    wfree(page->filename);
+    wfree(page->buf);
+    wfree(page);
 }
 
 
+/*
+    Release a reference to a page once the request or an output segment is done with it
+ */
+static void releasePage(void *arg)
+{
+    JstPage     *page;
+
+    page = arg;
+    if (--page->refs == 0 && page->removed) {
+        freePage(page);
+    }
+}
+
+
+#if ME_GOAHEAD_JST_CACHE
+/*
+    Remove a page from the cache. If requests are still writing its text, it is freed when they complete.
+ */
+static void removePage(JstPage *page)
+{
+    hashDelete(jstCache, page->filename);
+    page->removed = 1;
+    if (page->refs == 0) {
+        freePage(page);
+    }
+}
+#endif
+
+
 static void closeJst()
 {
+#if ME_GOAHEAD_JST_CACHE
+    WebsKey     *key;
+
+    if (jstCache >= 0) {
+        while ((key = hashFirst(jstCache)) != 0) {
+            removePage((JstPage*) key->content.value.symbol);
+        }
+        hashFree(jstCache);
+        jstCache = -1;
+    }
+#endif
     if (websJstFunctions != -1) {
         hashFree(websJstFunctions);
         websJstFunctions = -1;
@@ -172,9 +631,34 @@ static void closeJst()
 }
 
 
+/*
+    Release the rendering state. Called when rendering completes or the request is terminated.
+ */
+PUBLIC void websJstAbort(Webs *wp)
+{
+    JstRender   *rp;
+
+    if ((rp = wp->jst) == 0) {
+        return;
+    }
+    wp->jst = 0;
+    if (wp->writeData == resumePage) {
+        wp->writeData = 0;
+    }
+    if (rp->jid >= 0) {
+        jsCloseEngine(rp->jid);
+    }
+    releasePage(rp->page);
+    wfree(rp);
+}
+
+
 PUBLIC int websJstOpen()
 {
     websJstFunctions = hashCreate(WEBS_HASH_INIT * 2);
+#if ME_GOAHEAD_JST_CACHE
+    jstCache = hashCreate(WEBS_HASH_INIT);
+#endif
     websDefineJst("write", websJstWrite);
     websDefineHandler("jst", 0, jstHandler, closeJst, 0);
     return 0;
@@ -18,17 +18,60 @@
 
 /*********************************** Locals ***********************************/
 
+/*
+    Method bits for fast route matching. Methods without a bit are matched via the route methods hash.
+ */
+#define ROUTE_GET       0x1
+#define ROUTE_HEAD      0x2
+#define ROUTE_POST      0x4
+#define ROUTE_PUT       0x8
+#define ROUTE_DELETE    0x10
+#define ROUTE_OPTIONS   0x20
+#define ROUTE_TRACE     0x40
+#define ROUTE_OTHER     0x80
+#define ROUTE_SAFE      (ROUTE_GET | ROUTE_HEAD | ROUTE_POST)
+
+/*
+    Route prefixes are compiled into a trie. A request path walks the trie and collects the routes whose prefix
+    is a prefix of the path. These candidates are then tested in route table order to preserve first-match semantics.
+ */
+typedef struct RouteEntry {
+    WebsRoute           *route;
+    int                 index;              /* Position in the route table */
+    int                 methods;            /* Bitmask of permitted methods */
+    uint                extensions;         /* Bloom mask of permitted extensions */
+    bool                extRestricted;      /* Extensions are restricted. The set may be empty and match nothing. */
+} RouteEntry;
+
+typedef struct RouteNode {
+    struct RouteNode    **children;         /* Child nodes sorted by key character */
+    RouteEntry          *entries;           /* Routes whose prefix ends at this node in route table order */
+    int                 childCount;
+    int                 entryCount;
+    int                 methods;            /* Union of the entry method masks */
+    uchar               key;                /* Prefix character for this node */
+} RouteNode;
+
 static WebsRoute **routes = 0;
 static WebsHash handlers = -1;
 static int routeCount = 0;
 static int routeMax = 0;
+static RouteNode *routeTrie;            /* Compiled route prefixes */
+static bool routesChanged;              /* Routes must be recompiled */
 
 #define WEBS_MAX_ROUTE 16               /* Maximum passes over route set */
+#define ROUTE_CANDIDATES 32             /* Initial size of the candidate route list */
 
 /********************************** Forwards **********************************/
 
+static RouteNode *addRouteNode(RouteNode *parent, uchar key);
+static void compileRoutes();
 static bool continueHandler(Webs *wp);
 static void freeRoute(WebsRoute *route);
+static void freeRouteNode(RouteNode *node);
+static int findRoutes(Webs *wp, RouteEntry ***candidates, RouteEntry **local);
+static uint getExtensionBit(char *ext);
+static int getMethodBit(char *method);
 static void growRoutes();
 static int lookupRoute(char *uri);
 static bool redirectHandler(Webs *wp);
@@ -42,43 +85,43 @@ PUBLIC void websRouteRequest(Webs *wp)
 {
     WebsRoute   *route;
     WebsHandler *handler;
-    ssize       plen, len;
-    bool        safeMethod;
-    int         i;
+    RouteEntry  *local[ROUTE_CANDIDATES], **candidates, *entry;
+    uint        extBit;
+    int         i, count, methodBit, done;
 
     assert(wp);
     assert(wp->path);
     assert(wp->method);
     assert(wp->protocol);
 
-    safeMethod = smatch(wp->method, "POST") || smatch(wp->method, "GET") || smatch(wp->method, "HEAD");
-    plen = slen(wp->path);
+    if (routesChanged) {
+        compileRoutes();
+    }
+    count = findRoutes(wp, &candidates, local);
+    methodBit = getMethodBit(wp->method);
+    extBit = wp->ext ? getExtensionBit(&wp->ext[1]) : 0;
 
     /*
         Resume routine from last matched route. This permits the legacy service() callbacks to return false
         and continue routing.
      */
+    i = 0;
     if (wp->route && !(wp->flags & WEBS_REROUTE)) {
-        for (i = 0; i < routeCount; i++) {
-            if (wp->route == routes[i]) {
+        for (i = 0; i < count; i++) {
+            if (wp->route == candidates[i]->route) {
                 i++;
                 break;
             }
         }
-        if (i >= routeCount) {
+        if (i >= count) {
             i = 0;
         }
-    } else {
-        i = 0;
     }
     wp->route = 0;
 
-    for (; i < routeCount; i++) {
-        route = routes[i];
-        assert(route->prefix && route->prefixLen > 0);
-
-        if (plen < route->prefixLen) continue;
-        len = min(route->prefixLen, plen);
+    for (done = 0; !done && i < count; i++) {
+        entry = candidates[i];
+        route = entry->route;
         trace(5, "Examine route %s", route->prefix);
         /*
             Match route
@@ -87,45 +130,54 @@ PUBLIC void websRouteRequest(Webs *wp)
             trace(5, "Route %s does not match protocol %s", route->prefix, wp->protocol);
             continue;
         }
-        if (route->methods >= 0) {
-            if (!hashLookup(route->methods, wp->method)) {
-                trace(5, "Route %s does not match method %s", route->prefix, wp->method);
-                continue;
-            }
-        } else if (!safeMethod) {
+        if (!(entry->methods & methodBit) || (methodBit == ROUTE_OTHER && !hashLookup(route->methods, wp->method))) {
+            trace(5, "Route %s does not match method %s", route->prefix, wp->method);
             continue;
         }
-        if (route->extensions >= 0 && (wp->ext == 0 || !hashLookup(route->extensions, &wp->ext[1]))) {
+        if (entry->extRestricted && (wp->ext == 0 || !(entry->extensions & extBit) ||
+                !hashLookup(route->extensions, &wp->ext[1]))) {
             trace(5, "Route %s doesn match extension %s", route->prefix, wp->ext ? wp->ext : "");
             continue;
         }
-        if (strncmp(wp->path, route->prefix, len) == 0) {
-            wp->route = route;
+        wp->route = route;
 #if ME_GOAHEAD_AUTH
-            if (route->authType && !websAuthenticate(wp)) {
-                return;
-            }
-            if (route->abilities >= 0 && !websCan(wp, route->abilities)) {
-                return;
-            }
+        if ((route->authType && !websAuthenticate(wp)) || (route->abilities >= 0 && !websCan(wp, route->abilities))) {
+            done = 1;
+            break;
+        }
 #endif
-            if ((handler = route->handler) == 0) {
-                continue;
-            }
-            if (!handler->match || (*handler->match)(wp)) {
-                /* Handler matches */
-                return;
+        if ((handler = route->handler) == 0) {
+            continue;
+        }
+        if (!handler->match || (*handler->match)(wp)) {
+            /* Handler matches */
+            done = 1;
+            break;
+        }
+        wp->route = 0;
+        if (wp->flags & WEBS_REROUTE) {
+            wp->flags &= ~WEBS_REROUTE;
+            if (++wp->routeCount >= WEBS_MAX_ROUTE) {
+                break;
             }
-            wp->route = 0;
-            if (wp->flags & WEBS_REROUTE) {
-                wp->flags &= ~WEBS_REROUTE;
-                if (++wp->routeCount >= WEBS_MAX_ROUTE) {
-                    break;
-                }
-                i = 0;
+            /*
+                The handler may have modified the request path, so find the candidate routes again
+             */
+            if (candidates != local) {
+                wfree(candidates);
             }
+            count = findRoutes(wp, &candidates, local);
+            extBit = wp->ext ? getExtensionBit(&wp->ext[1]) : 0;
+            i = -1;
         }
     }
+    if (candidates != local) {
+        wfree(candidates);
+    }
+    if (done) {
+        /* Matched, or authentication has already responded */
+        return;
+    }
     if (wp->routeCount >= WEBS_MAX_ROUTE) {
         error("Route loop for %s", wp->url);
     }
@@ -134,6 +186,207 @@ PUBLIC void websRouteRequest(Webs *wp)
 }
 
 
+static int getMethodBit(char *method)
+{
+    switch (method[0]) {
+    case 'G':
+        if (smatch(method, "GET")) return ROUTE_GET;
+        break;
+    case 'H':
+        if (smatch(method, "HEAD")) return ROUTE_HEAD;
+        break;
+    case 'P':
+        if (smatch(method, "POST")) return ROUTE_POST;
+        if (smatch(method, "PUT")) return ROUTE_PUT;
+        break;
+    case 'D':
+        if (smatch(method, "DELETE")) return ROUTE_DELETE;
+        break;
+    case 'O':
+        if (smatch(method, "OPTIONS")) return ROUTE_OPTIONS;
+        break;
+    case 'T':
+        if (smatch(method, "TRACE")) return ROUTE_TRACE;
+        break;
+    }
+    return ROUTE_OTHER;
+}
+
+
+/*
+    Map an extension to one bit of a 32 bit bloom mask
+ */
+static uint getExtensionBit(char *ext)
+{
+    uint    hash;
+
+    for (hash = 0; *ext; ext++) {
+        hash = hash * 31 + (uchar) *ext;
+    }
+    return 1U << (hash & 31);
+}
+
+
+/*
+    Find the routes whose prefix is a prefix of the request path. These are returned in route table order.
+    The list is stored in the caller supplied local array unless it is too small. The caller must free *candidates 
+    if it is not the local array.
+ */
+static int findRoutes(Webs *wp, RouteEntry ***candidates, RouteEntry **local)
+{
+    RouteNode   *node, *child;
+    RouteEntry  **list, *entry;
+    char        *cp;
+    int         count, max, i, j, lo, hi, mid, methodBit;
+
+    list = local;
+    max = ROUTE_CANDIDATES;
+    count = 0;
+    methodBit = getMethodBit(wp->method);
+
+    for (node = routeTrie, cp = wp->path; node && *cp; cp++) {
+        /* Binary search for the child node */
+        child = 0;
+        for (lo = 0, hi = node->childCount - 1; lo <= hi; ) {
+            mid = (lo + hi) / 2;
+            if (node->children[mid]->key == (uchar) *cp) {
+                child = node->children[mid];
+                break;
+            } else if (node->children[mid]->key < (uchar) *cp) {
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if ((node = child) == 0 || !(node->methods & methodBit)) {
+            continue;
+        }
+        for (i = 0; i < node->entryCount; i++) {
+            entry = &node->entries[i];
+            if (count >= max) {
+                RouteEntry  **bigger;
+                if ((bigger = walloc(sizeof(RouteEntry*) * max * 2)) == 0) {
+                    break;
+                }
+                memcpy(bigger, list, sizeof(RouteEntry*) * count);
+                if (list != local) {
+                    wfree(list);
+                }
+                list = bigger;
+                max *= 2;
+            }
+            /* Insertion sort by route table order. Lists are short. */
+            for (j = count; j > 0 && list[j - 1]->index > entry->index; j--) {
+                list[j] = list[j - 1];
+            }
+            list[j] = entry;
+            count++;
+        }
+    }
+    *candidates = list;
+    return count;
+}
+
+
+static RouteNode *addRouteNode(RouteNode *parent, uchar key)
+{
+    RouteNode   *node;
+    int         i;
+
+    for (i = 0; i < parent->childCount; i++) {
+        if (parent->children[i]->key == key) {
+            return parent->children[i];
+        } else if (parent->children[i]->key > key) {
+            break;
+        }
+    }
+    if ((node = walloc(sizeof(RouteNode))) == 0) {
+        return 0;
+    }
+    memset(node, 0, sizeof(RouteNode));
+    node->key = key;
+    if ((parent->children = wrealloc(parent->children, sizeof(RouteNode*) * (parent->childCount + 1))) == 0) {
+        wfree(node);
+        parent->childCount = 0;
+        return 0;
+    }
+    memmove(&parent->children[i + 1], &parent->children[i], sizeof(RouteNode*) * (parent->childCount - i));
+    parent->children[i] = node;
+    parent->childCount++;
+    return node;
+}
+
+
+static void freeRouteNode(RouteNode *node)
+{
+    int     i;
+
+    if (node) {
+        for (i = 0; i < node->childCount; i++) {
+            freeRouteNode(node->children[i]);
+        }
+        wfree(node->children);
+        wfree(node->entries);
+        wfree(node);
+    }
+}
+
+
+/*
+    Compile the route table into the route trie. This is done when routes are loaded or modified.
+ */
+static void compileRoutes()
+{
+    WebsRoute   *route;
+    RouteNode   *node;
+    RouteEntry  *entry;
+    WebsKey     *key;
+    char        *cp;
+    int         i;
+
+    freeRouteNode(routeTrie);
+    routesChanged = 0;
+    if ((routeTrie = walloc(sizeof(RouteNode))) == 0) {
+        return;
+    }
+    memset(routeTrie, 0, sizeof(RouteNode));
+
+    for (i = 0; i < routeCount; i++) {
+        route = routes[i];
+        for (node = routeTrie, cp = route->prefix; node && *cp; cp++) {
+            node = addRouteNode(node, (uchar) *cp);
+        }
+        if (!node) {
+            error("Cannot compile route %s", route->prefix);
+            continue;
+        }
+        if ((node->entries = wrealloc(node->entries, sizeof(RouteEntry) * (node->entryCount + 1))) == 0) {
+            node->entryCount = 0;
+            continue;
+        }
+        entry = &node->entries[node->entryCount++];
+        entry->route = route;
+        entry->index = i;
+        entry->methods = 0;
+        entry->extensions = 0;
+        entry->extRestricted = route->extensions >= 0;
+        if (route->methods >= 0) {
+            for (key = hashFirst(route->methods); key; key = hashNext(route->methods, key)) {
+                entry->methods |= getMethodBit(key->name.value.string);
+            }
+        } else {
+            entry->methods = ROUTE_SAFE;
+        }
+        if (route->extensions >= 0) {
+            for (key = hashFirst(route->extensions); key; key = hashNext(route->extensions, key)) {
+                entry->extensions |= getExtensionBit(key->name.value.string);
+            }
+        }
+        node->methods |= entry->methods;
+    }
+}
+
+
 PUBLIC bool websRunRequest(Webs *wp)
 {
     WebsRoute   *route;
@@ -306,10 +559,11 @@ WebsRoute *websAddRoute(char *uri, char *handler, int pos)
         pos = routeCount;
     } 
     if (pos < routeCount) {
-        memmove(&routes[pos + 1], &routes[pos], sizeof(WebsRoute*) * routeCount - pos);
+        memmove(&routes[pos + 1], &routes[pos], sizeof(WebsRoute*) * (routeCount - pos));
     }
     routes[pos] = route;
     routeCount++;
+    routesChanged = 1;
     return route;
 }
 
@@ -327,6 +581,7 @@ PUBLIC int websSetRouteMatch(WebsRoute *route, char *dir, char *protocol, WebsHa
     route->extensions = extensions;
     route->methods = methods;
     route->redirects = redirects;
+    routesChanged = 1;
     return 0;
 }
 
@@ -394,10 +649,11 @@ PUBLIC int websRemoveRoute(char *uri)
         return -1;
     }
     freeRoute(routes[i]);
-    for (; i < routeCount; i++) {
+    for (; i < routeCount - 1; i++) {
         routes[i] = routes[i+1];
     }
     routeCount--;
+    routesChanged = 1;
     return 0;
 }
 
@@ -433,7 +689,10 @@ PUBLIC void websCloseRoute()
         wfree(routes);
         routes = 0;
     }
+    freeRouteNode(routeTrie);
+    routeTrie = 0;
     routeCount = routeMax = 0;
+    routesChanged = 0;
 }
 
 
@@ -598,6 +857,7 @@ PUBLIC int websLoad(char *path)
 #if ME_GOAHEAD_AUTH
     websComputeAllUserAbilities();
 #endif
+    compileRoutes();
     return rc;
 }
 
@@ -15,8 +15,9 @@
 typedef struct Callback {
     void        (*routine)(void *arg, int id);
     void        *arg;
-    WebsTime    at;
+    WebsTicks   at;                     /* Due time in msec ticks */
     int         id;
+    int         index;                  /* Index in the event heap. Set to -1 if not scheduled */
 } Callback;
 
 /*********************************** Defines **********************************/
@@ -151,12 +152,24 @@ typedef struct Format {
 
 #define RINGQ_LEN(bp) ((bp->servp > bp->endp) ? (bp->buflen + (bp->endp - bp->servp)) : (bp->endp - bp->servp))
 
+/*
+    Hash tables store keys in insertion order in a dense array. An open addressing index with linear probing maps
+    hash codes to key positions. Deleted keys are left in place (invalid) until the table is next resized so that
+    iteration may continue past a deleted key.
+ */
 typedef struct HashTable {              /* Symbol table descriptor */
-    WebsKey     **hash_table;           /* Allocated at run time */
-    int         inuse;                  /* Is this entry in use */
-    int         size;                   /* Size of the table below */
+    WebsKey     *keys;                  /* Keys in insertion order */
+    int         *index;                 /* Open addressing index of key positions */
+    int         size;                   /* Size of the index. Always a power of two */
+    int         used;                   /* Number of key positions used (including deleted keys) */
+    int         count;                  /* Number of valid keys */
+    int         max;                    /* Allocated size of keys */
 } HashTable;
 
+#define HASH_EMPTY      -1              /* Index slot has never been used */
+#define HASH_DELETED    -2              /* Index slot refers to a deleted key */
+#define HASH_MIN_INDEX  8               /* Minimum index size */
+
 #ifndef LOG_ERR
     #define LOG_ERR 0
 #endif
@@ -170,20 +183,27 @@ PUBLIC int       logLevel;          /* Log verbosity level */
 
 static Callback  **callbacks;
 static int       callbackMax;
+static Callback  **eventHeap;       /* Scheduled events ordered by due time */
+static int       eventCount;        /* Number of scheduled events */
+static int       eventHeapMax;      /* Size of eventHeap */
+static WebsTicks ticks;             /* Cached monotonic time in msec */
 
 static HashTable **sym;             /* List of symbol tables */
 static int       symMax;            /* One past the max symbol table */
 static char      *logPath;          /* Log file name */
 static int       logFd;             /* Log file handle */
+static int       logOpened;         /* Log file has been opened */
 
 char *embedthisGoAheadCopyright = EMBEDTHIS_GOAHEAD_COPYRIGHT;
 
 /********************************** Forwards **********************************/
 
-static int calcPrime(int size);
+static void heapRemove(Callback *s);
+static void heapSchedule(Callback *s);
 static int getBinBlockSize(int size);
-static int hashIndex(HashTable *tp, char *name);
-static WebsKey *hash(HashTable *tp, char *name);
+static uint hashCode(char *name);
+static int hashFind(HashTable *tp, char *name, uint code, int *slot);
+static int hashResize(HashTable *tp, int count);
 static void defaultLogHandler(int level, char *buf);
 static WebsLogHandler logHandler = defaultLogHandler;
 
@@ -202,6 +222,7 @@ PUBLIC int websRuntimeOpen()
 {
     symMax = 0;
     sym = 0;
+    websUpdateTicks();
     return 0;
 }
 
@@ -212,22 +233,140 @@ PUBLIC void websRuntimeClose()
 
 
 /*
-    This function is called when a scheduled process time has come.
+    Read the monotonic system clock in milliseconds
  */
-static void callEvent(int id)
+static WebsTicks getTicks()
 {
-    Callback    *cp;
+#if WINDOWS
+    return (WebsTicks) GetTickCount64();
+#elif ME_WIN_LIKE
+    return (WebsTicks) GetTickCount();
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
 
-    assert(0 <= id && id < callbackMax);
-    cp = callbacks[id];
-    assert(cp);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((WebsTicks) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#else
+    struct timeval  tv;
 
-    (cp->routine)(cp->arg, cp->id);
+    gettimeofday(&tv, NULL);
+    return ((WebsTicks) tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+#endif
 }
 
 
 /*
-    Schedule an event in delay milliseconds time. We will use 1 second granularity for webServer.
+    Return the cached monotonic time. This is updated by the event loop each time it wakes.
+ */
+PUBLIC WebsTicks websGetTicks()
+{
+    return ticks;
+}
+
+
+PUBLIC WebsTicks websUpdateTicks()
+{
+    ticks = getTicks();
+    return ticks;
+}
+
+
+/*
+    The event heap is a binary min-heap of scheduled events ordered by due time. Each event records its heap index so 
+    it can be rescheduled or removed without searching.
+ */
+static void heapSet(int index, Callback *s)
+{
+    eventHeap[index] = s;
+    s->index = index;
+}
+
+
+static void heapUp(int index)
+{
+    Callback    *s;
+    int         parent;
+
+    s = eventHeap[index];
+    while (index > 0) {
+        parent = (index - 1) / 2;
+        if (eventHeap[parent]->at <= s->at) {
+            break;
+        }
+        heapSet(index, eventHeap[parent]);
+        index = parent;
+    }
+    heapSet(index, s);
+}
+
+
+static void heapDown(int index)
+{
+    Callback    *s;
+    int         child;
+
+    s = eventHeap[index];
+    while ((child = index * 2 + 1) < eventCount) {
+        if (child + 1 < eventCount && eventHeap[child + 1]->at < eventHeap[child]->at) {
+            child++;
+        }
+        if (s->at <= eventHeap[child]->at) {
+            break;
+        }
+        heapSet(index, eventHeap[child]);
+        index = child;
+    }
+    heapSet(index, s);
+}
+
+
+/*
+    Add an event to the heap or reposition it if already scheduled
+ */
+static void heapSchedule(Callback *s)
+{
+    Callback    **newHeap;
+    int         newMax;
+
+    if (s->index >= 0) {
+        heapUp(s->index);
+        heapDown(s->index);
+        return;
+    }
+    if (eventCount >= eventHeapMax) {
+        newMax = max(eventHeapMax * 2, 16);
+        if ((newHeap = wrealloc(eventHeap, newMax * sizeof(Callback*))) == NULL) {
+            return;
+        }
+        eventHeap = newHeap;
+        eventHeapMax = newMax;
+    }
+    heapSet(eventCount++, s);
+    heapUp(s->index);
+}
+
+
+static void heapRemove(Callback *s)
+{
+    Callback    *last;
+    int         index;
+
+    if ((index = s->index) < 0) {
+        return;
+    }
+    s->index = -1;
+    if (--eventCount > index) {
+        /* Move the last event into the hole and restore the heap order */
+        last = eventHeap[eventCount];
+        heapSet(index, last);
+        heapUp(index);
+        heapDown(last->index);
+    }
+}
+
+
+/*
+    Schedule an event in delay milliseconds time
  */
 PUBLIC int websStartEvent(int delay, WebsEventProc proc, void *arg)
 {
@@ -241,11 +380,9 @@ PUBLIC int websStartEvent(int delay, WebsEventProc proc, void *arg)
     s->routine = proc;
     s->arg = arg;
     s->id = id;
-
-    /*
-        Round the delay up to seconds.
-     */
-    s->at = ((delay + 500) / 1000) + time(0);
+    s->index = -1;
+    s->at = ticks + delay;
+    heapSchedule(s);
     return id;
 }
 
@@ -257,7 +394,8 @@ PUBLIC void websRestartEvent(int id, int delay)
     if (callbacks == NULL || id == -1 || id >= callbackMax || (s = callbacks[id]) == NULL) {
         return;
     }
-    s->at = ((delay + 500) / 1000) + time(0);
+    s->at = ticks + delay;
+    heapSchedule(s);
 }
 
 
@@ -268,32 +406,31 @@ PUBLIC void websStopEvent(int id)
     if (callbacks == NULL || id == -1 || id >= callbackMax || (s = callbacks[id]) == NULL) {
         return;
     }
+    heapRemove(s);
     wfree(s);
     callbackMax = wfreeHandle(&callbacks, id);
 }
 
 
+/*
+    Run all due events and return the time till the next event. Events are removed from the heap before running and 
+    must be rescheduled via websRestartEvent to run again.
+ */
 WebsTime websRunEvents()
 {
     Callback    *s;
-    WebsTime    delay, now, nextEvent;
-    int         i;
-
-    nextEvent = (MAXINT / 1000);
-    now = time(0);
+    WebsTicks   now;
 
-    for (i = 0; i < callbackMax; i++) {
-        if ((s = callbacks[i]) != NULL) {
-            if ((delay = s->at - now) <= 0) {
-                callEvent(i);
-                delay = MAXINT / 1000;
-                /* Rescan incase event scheduled or modified an event */
-                i = -1;
-            }
-            nextEvent = min(delay, nextEvent);
-        }
+    now = websUpdateTicks();
+    while (eventCount > 0 && eventHeap[0]->at <= now) {
+        s = eventHeap[0];
+        heapRemove(s);
+        (s->routine)(s->arg, s->id);
+    }
+    if (eventCount == 0) {
+        return MAXINT;
     }
-    return nextEvent * 1000;
+    return (WebsTime) min(eventHeap[0]->at - now, MAXINT);
 }
 
 
@@ -1059,6 +1196,10 @@ WebsLogHandler logSetHandler(WebsLogHandler handler)
 
 PUBLIC int logOpen()
 {
+    if (logOpened) {
+        /* Already open. Worker processes inherit the log from the supervisor. */
+        return 0;
+    }
     if (!logPath) {
         /* This defintion comes from main.bit and me.h */
         logSetPath(ME_GOAHEAD_LOGFILE);
@@ -1076,6 +1217,7 @@ PUBLIC int logOpen()
 #endif
     }
     logSetHandler(logHandler);
+    logOpened = 1;
     return 0;
 }
 
@@ -1086,6 +1228,7 @@ PUBLIC void logClose()
         close(logFd);                                                                              
         logFd = -1;                                                                                
     }                                                                                                    
+    logOpened = 0;
 }
 
 
@@ -1789,7 +1932,7 @@ PUBLIC void bufReset(WebsBuf *bp)
 PUBLIC bool bufGrow(WebsBuf *bp, ssize room)
 {
     char    *newbuf;
-    ssize   len;
+    ssize   len, servp, endp;
 
     assert(bp);
 
@@ -1807,6 +1950,22 @@ PUBLIC bool bufGrow(WebsBuf *bp, ssize room)
         bp->increment = getBinBlockSize(2 * bp->increment);
     }
     len = bufLen(bp);
+    if (bp->endp >= bp->servp) {
+        /*
+            The data does not wrap so the buffer can be reallocated. This permits the allocator to grow it in place.
+         */
+        servp = bp->servp - bp->buf;
+        endp = bp->endp - bp->buf;
+        if ((newbuf = wrealloc(bp->buf, bp->buflen + room)) == NULL) {
+            return 0;
+        }
+        bp->buflen += room;
+        bp->buf = newbuf;
+        bp->servp = &newbuf[servp];
+        bp->endp = &newbuf[endp];
+        bp->endbuf = &bp->buf[bp->buflen];
+        return 1;
+    }
     if ((newbuf = walloc(bp->buflen + room)) == NULL) {
         return 0;
     }
@@ -1842,7 +2001,8 @@ static int  getBinBlockSize(int size)
 WebsHash hashCreate(int size)
 {
     WebsHash    sd;
-    HashTable      *tp;
+    HashTable   *tp;
+    int         i;
 
     if (size < 0) {
         size = WEBS_SMALL_HASH;
@@ -1871,12 +2031,14 @@ WebsHash hashCreate(int size)
     sym[sd] = tp;
 
     /*
-        Now create the hash table for fast indexing.
+        Now create the index for fast lookup. The keys are allocated on demand.
      */
-    tp->size = calcPrime(size);
-    tp->hash_table = (WebsKey**) walloc(tp->size * sizeof(WebsKey*));
-    assert(tp->hash_table);
-    memset(tp->hash_table, 0, tp->size * sizeof(WebsKey*));
+    for (tp->size = HASH_MIN_INDEX; tp->size < size; tp->size <<= 1) ;
+    tp->index = (int*) walloc(tp->size * sizeof(int));
+    assert(tp->index);
+    for (i = 0; i < tp->size; i++) {
+        tp->index[i] = HASH_EMPTY;
+    }
     return sd;
 }
 
@@ -1887,9 +2049,7 @@ WebsHash hashCreate(int size)
  */
 PUBLIC void hashFree(WebsHash sd)
 {
-    HashTable      *tp;
-    WebsKey     *sp, *forw;
-    int         i;
+    HashTable   *tp;
 
     if (sd < 0) {
         return;
@@ -1901,41 +2061,61 @@ PUBLIC void hashFree(WebsHash sd)
     /*
         Free all symbols in the hash table, then the hash table itself.
      */
-    for (i = 0; i < tp->size; i++) {
-        for (sp = tp->hash_table[i]; sp; sp = forw) {
-            forw = sp->forw;
+    hashClear(sd);
+    wfree((void*) tp->index);
+    wfree((void*) tp->keys);
+    symMax = wfreeHandle(&sym, sd);
+    wfree((void*) tp);
+}
+
+
+/*
+    Free all symbols in the hash table. The table itself is retained for reuse.
+ */
+PUBLIC void hashClear(WebsHash sd)
+{
+    HashTable   *tp;
+    WebsKey     *sp;
+    int         i;
+
+    if (sd < 0) {
+        return;
+    }
+    assert(0 <= sd && sd < symMax);
+    tp = sym[sd];
+    assert(tp);
+
+    for (i = 0; i < tp->used; i++) {
+        sp = &tp->keys[i];
+        if (sp->name.valid) {
             valueFree(&sp->name);
             valueFree(&sp->content);
-            wfree((void*) sp);
-            sp = forw;
         }
     }
-    wfree((void*) tp->hash_table);
-    symMax = wfreeHandle(&sym, sd);
-    wfree((void*) tp);
+    for (i = 0; i < tp->size; i++) {
+        tp->index[i] = HASH_EMPTY;
+    }
+    tp->used = tp->count = 0;
 }
 
 
 /*
     Return the first symbol in the hashtable if there is one. This call is used as the first step in traversing the
     table. A call to hashFirst should be followed by calls to hashNext to get all the rest of the entries.
+    Symbols are returned in insertion order.
  */
 WebsKey *hashFirst(WebsHash sd)
 {
-    HashTable      *tp;
-    WebsKey     *sp;
+    HashTable   *tp;
     int         i;
 
     assert(0 <= sd && sd < symMax);
     tp = sym[sd];
     assert(tp);
 
-    /*
-        Find the first symbol in the hashtable and return a pointer to it.
-     */
-    for (i = 0; i < tp->size; i++) {
-        if ((sp = tp->hash_table[i]) != 0) {
-            return sp;
+    for (i = 0; i < tp->used; i++) {
+        if (tp->keys[i].name.valid) {
+            return &tp->keys[i];
         }
     }
     return 0;
@@ -1943,12 +2123,11 @@ WebsKey *hashFirst(WebsHash sd)
 
 
 /*
-    Return the next symbol in the hashtable if there is one. See hashFirst.
+    Return the next symbol in the hashtable if there is one. See hashFirst. The last symbol may have been deleted.
  */
 WebsKey *hashNext(WebsHash sd, WebsKey *last)
 {
-    HashTable      *tp;
-    WebsKey     *sp;
+    HashTable   *tp;
     int         i;
 
     assert(0 <= sd && sd < symMax);
@@ -1960,12 +2139,10 @@ WebsKey *hashNext(WebsHash sd, WebsKey *last)
     if (last == 0) {
         return hashFirst(sd);
     }
-    if (last->forw) {
-        return last->forw;
-    }
-    for (i = last->bucket + 1; i < tp->size; i++) {
-        if ((sp = tp->hash_table[i]) != 0) {
-            return sp;
+    assert(tp->keys <= last && last < &tp->keys[tp->used]);
+    for (i = (int) (last - tp->keys) + 1; i < tp->used; i++) {
+        if (tp->keys[i].name.valid) {
+            return &tp->keys[i];
         }
     }
     return NULL;
@@ -1977,9 +2154,8 @@ WebsKey *hashNext(WebsHash sd, WebsKey *last)
  */
 WebsKey *hashLookup(WebsHash sd, char *name)
 {
-    HashTable      *tp;
-    WebsKey     *sp;
-    char        *cp;
+    HashTable   *tp;
+    int         pos;
 
     assert(0 <= sd && sd < symMax);
     if (sd < 0 || (tp = sym[sd]) == NULL) {
@@ -1988,95 +2164,63 @@ WebsKey *hashLookup(WebsHash sd, char *name)
     if (name == NULL || *name == '\0') {
         return NULL;
     }
-    /*
-        Do an initial hash and then follow the link chain to find the right entry
-     */
-    for (sp = hash(tp, name); sp; sp = sp->forw) {
-        cp = sp->name.value.string;
-        if (cp[0] == name[0] && strcmp(cp, name) == 0) {
-            break;
-        }
+    if ((pos = hashFind(tp, name, hashCode(name), 0)) < 0) {
+        return NULL;
     }
-    return sp;
+    return &tp->keys[pos];
 }
 
 
 /*
     Enter a symbol into the table. If already there, update its value.  Always succeeds if memory available. We allocate
     a copy of "name" here so it can be a volatile variable. The value "v" is just a copy of the passed in value, so it
-    MUST be persistent.
+    MUST be persistent. Note: entering a new symbol may resize the table and invalidate prior symbol references.
  */
 WebsKey *hashEnter(WebsHash sd, char *name, WebsValue v, int arg)
 {
-    HashTable      *tp;
-    WebsKey     *sp, *last;
-    char        *cp;
-    int         hindex;
+    HashTable   *tp;
+    WebsKey     *sp;
+    uint        code;
+    int         pos, slot;
 
     assert(name);
     assert(0 <= sd && sd < symMax);
     tp = sym[sd];
     assert(tp);
 
-    /*
-        Calculate the first daisy-chain from the hash table. If non-zero, then we have daisy-chain, so scan it and look
-        for the symbol.  
-     */
-    last = NULL;
-    hindex = hashIndex(tp, name);
-    if ((sp = tp->hash_table[hindex]) != NULL) {
-        for (; sp; sp = sp->forw) {
-            cp = sp->name.value.string;
-            if (cp[0] == name[0] && strcmp(cp, name) == 0) {
-                break;
-            }
-            last = sp;
-        }
-        if (sp) {
-            /*
-                Found, so update the value If the caller stores handles which require freeing, they will be lost here.
-                It is the callers responsibility to free resources before overwriting existing contents. We will here
-                free allocated strings which occur due to value_instring().  We should consider providing the cleanup
-                function on the open rather than the close and then we could call it here and solve the problem.
-             */
-            if (sp->content.valid) {
-                valueFree(&sp->content);
-            }
-            sp->content = v;
-            sp->arg = arg;
-            return sp;
-        }
+    code = hashCode(name);
+    if ((pos = hashFind(tp, name, code, &slot)) >= 0) {
         /*
-            Not found so allocate and append to the daisy-chain
+            Found, so update the value If the caller stores handles which require freeing, they will be lost here.
+            It is the callers responsibility to free resources before overwriting existing contents. We will here
+            free allocated strings which occur due to value_instring().  We should consider providing the cleanup
+            function on the open rather than the close and then we could call it here and solve the problem.
          */
-        sp = (WebsKey*) walloc(sizeof(WebsKey));
-        if (sp == NULL) {
-            return NULL;
+        sp = &tp->keys[pos];
+        if (sp->content.valid) {
+            valueFree(&sp->content);
         }
-        sp->name = valueString(name, VALUE_ALLOCATE);
         sp->content = v;
-        sp->forw = (WebsKey*) NULL;
         sp->arg = arg;
-        sp->bucket = hindex;
-        last->forw = sp;
-
-    } else {
-        /*
-            Daisy chain is empty so we need to start the chain
-         */
-        sp = (WebsKey*) walloc(sizeof(WebsKey));
-        if (sp == NULL) {
+        return sp;
+    }
+    /*
+        Keep the index at most 3/4 full including deleted slots
+     */
+    if (tp->used >= tp->max || (tp->used + 1) * 4 > tp->size * 3) {
+        if (hashResize(tp, tp->count + 1) < 0) {
             return NULL;
         }
-        tp->hash_table[hindex] = sp;
-        tp->hash_table[hashIndex(tp, name)] = sp;
-
-        sp->forw = (WebsKey*) NULL;
-        sp->content = v;
-        sp->arg = arg;
-        sp->name = valueString(name, VALUE_ALLOCATE);
-        sp->bucket = hindex;
-    }
+        hashFind(tp, name, code, &slot);
+    }
+    pos = tp->used++;
+    sp = &tp->keys[pos];
+    sp->name = valueString(name, VALUE_ALLOCATE);
+    sp->content = v;
+    sp->arg = arg;
+    sp->hash = code;
+    tp->index[slot] = pos;
+    tp->count++;
     return sp;
 }
 
@@ -2086,119 +2230,154 @@ WebsKey *hashEnter(WebsHash sd, char *name, WebsValue v, int arg)
  */
 PUBLIC int hashDelete(WebsHash sd, char *name)
 {
-    HashTable      *tp;
-    WebsKey     *sp, *last;
-    char        *cp;
-    int         hindex;
+    HashTable   *tp;
+    WebsKey     *sp;
+    int         pos, slot;
 
     assert(name && *name);
     assert(0 <= sd && sd < symMax);
     tp = sym[sd];
     assert(tp);
 
-    /*
-        Calculate the first daisy-chain from the hash table. If non-zero, then we have daisy-chain, so scan it and look
-        for the symbol.  
-     */
-    last = NULL;
-    hindex = hashIndex(tp, name);
-    if ((sp = tp->hash_table[hindex]) != NULL) {
-        for ( ; sp; sp = sp->forw) {
-            cp = sp->name.value.string;
-            if (cp[0] == name[0] && strcmp(cp, name) == 0) {
-                break;
-            }
-            last = sp;
-        }
-    }
-    if (sp == (WebsKey*) NULL) {              /* Not Found */
+    if ((pos = hashFind(tp, name, hashCode(name), &slot)) < 0) {
         return -1;
     }
     /*
-         Unlink and free the symbol. Last will be set if the element to be deleted is not first in the chain.
+        Free the symbol and leave the key position in place so iterators remain valid
      */
-    if (last) {
-        last->forw = sp->forw;
-    } else {
-        tp->hash_table[hindex] = sp->forw;
-    }
+    sp = &tp->keys[pos];
     valueFree(&sp->name);
     valueFree(&sp->content);
-    wfree((void*) sp);
+    sp->name.valid = 0;
+    tp->index[slot] = HASH_DELETED;
+    tp->count--;
     return 0;
 }
 
 
 /*
-    Hash a symbol and return a pointer to the hash daisy-chain list. All symbols reside on the chain (ie. none stored in
-    the hash table itself) 
+    Find a symbol. Returns the key position or -1 if not found. If slot is supplied, it is set to the index slot of
+    the symbol, or if not found, to the slot where the symbol should be inserted.
  */
-static WebsKey *hash(HashTable *tp, char *name)
+static int hashFind(HashTable *tp, char *name, uint code, int *slot)
 {
-    assert(tp);
+    WebsKey     *sp;
+    int         i, pos, mask, freeSlot;
 
-    return tp->hash_table[hashIndex(tp, name)];
+    mask = tp->size - 1;
+    freeSlot = -1;
+    for (i = code & mask; ; i = (i + 1) & mask) {
+        if ((pos = tp->index[i]) == HASH_EMPTY) {
+            break;
+        }
+        if (pos == HASH_DELETED) {
+            if (freeSlot < 0) {
+                freeSlot = i;
+            }
+            continue;
+        }
+        sp = &tp->keys[pos];
+        if (sp->hash == code && strcmp(sp->name.value.string, name) == 0) {
+            if (slot) {
+                *slot = i;
+            }
+            return pos;
+        }
+    }
+    if (slot) {
+        *slot = (freeSlot >= 0) ? freeSlot : i;
+    }
+    return -1;
 }
 
 
 /*
-    Compute the hash function and return an index into the hash table We use a basic additive function that is then made
-    modulo the size of the table.
+    Resize the table to hold at least "count" symbols. This compacts the keys to remove deleted symbols and rebuilds
+    the index.
  */
-static int hashIndex(HashTable *tp, char *name)
+static int hashResize(HashTable *tp, int count)
 {
-    uint        sum;
-    int         i;
+    WebsKey     *sp, *keys;
+    int         *index, i, j, size, keyMax, mask;
+
+    for (size = HASH_MIN_INDEX; size * 3 < count * 4 * 2; size <<= 1) ;
+    keyMax = size * 3 / 4;
 
-    assert(tp);
     /*
-        Add in each character shifted up progressively by 7 bits. The shift amount is rounded so as to not shift too
-        far. It thus cycles with each new cycle placing character shifted up by one bit.
+        Allocate the index and keys before changing the table so it is intact if an allocation fails
      */
-    i = 0;
-    sum = 0;
-    while (*name) {
-        sum += (((int) *name++) << i);
-        i = (i + 7) % (BITS(int) - BITSPERBYTE);
+    index = tp->index;
+    if (size != tp->size && (index = (int*) walloc(size * sizeof(int))) == NULL) {
+        return -1;
     }
-    return sum % tp->size;
-}
-
-
-/*
-    Check if this number is a prime
- */
-static int isPrime(int n)
-{
-    int     i, max;
-
-    assert(n > 0);
+    keys = tp->keys;
+    if (keyMax > tp->max) {
+        if ((keys = (WebsKey*) wrealloc(tp->keys, keyMax * sizeof(WebsKey))) == NULL) {
+            if (index != tp->index) {
+                wfree(index);
+            }
+            return -1;
+        }
+    } else if (keyMax < tp->max) {
+        /*
+            Copy the valid keys when shrinking
+         */
+        if ((keys = (WebsKey*) walloc(keyMax * sizeof(WebsKey))) == NULL) {
+            if (index != tp->index) {
+                wfree(index);
+            }
+            return -1;
+        }
+        for (i = j = 0; i < tp->used; i++) {
+            if (tp->keys[i].name.valid) {
+                keys[j++] = tp->keys[i];
+            }
+        }
+        wfree(tp->keys);
+        tp->used = j;
+    }
+    if (index != tp->index) {
+        wfree(tp->index);
+        tp->index = index;
+        tp->size = size;
+    }
+    tp->keys = keys;
+    tp->max = keyMax;
 
-    max = n / 2;
-    for (i = 2; i <= max; i++) {
-        if (n % i == 0) {
-            return 0;
+    /*
+        Compact the keys and rebuild the index
+     */
+    for (i = 0; i < tp->size; i++) {
+        tp->index[i] = HASH_EMPTY;
+    }
+    mask = tp->size - 1;
+    for (i = j = 0; i < tp->used; i++) {
+        sp = &tp->keys[i];
+        if (!sp->name.valid) {
+            continue;
         }
+        if (i != j) {
+            tp->keys[j] = *sp;
+        }
+        for (size = tp->keys[j].hash & mask; tp->index[size] != HASH_EMPTY; size = (size + 1) & mask) ;
+        tp->index[size] = j++;
     }
-    return 1;
+    tp->used = j;
+    return 0;
 }
 
 
 /*
-    Calculate the largest prime smaller than size.
+    Compute the hash code for a symbol name. This uses the FNV-1a hash.
  */
-static int calcPrime(int size)
+static uint hashCode(char *name)
 {
-    int count;
+    uint        code;
 
-    assert(size > 0);
-
-    for (count = size; count > 0; count--) {
-        if (isPrime(count)) {
-            return count;
-        }
+    for (code = 2166136261U; *name; name++) {
+        code = (code ^ (uchar) *name) * 16777619U;
     }
-    return 1;
+    return code;
 }
 
 
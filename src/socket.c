@@ -16,11 +16,26 @@ PUBLIC Socket   socketHighestFd = -1;   /* Highest socket fd opened */
 PUBLIC int      socketOpenCount = 0;    /* Number of task using sockets */
 static int      hasIPv6;                /* System supports IPv6 */
 
+#if WEBS_EPOLL
+static int      epollFd = -1;           /* Epoll event notifier */
+static int      *readyList;             /* Sockets with events to service by socketProcess */
+static int      readyCount;
+static int      readyMax;
+static int      *queueList;             /* Sockets to service without waiting for I/O */
+static int      queueCount;
+static int      queueMax;
+#endif
+
 /***************************** Forward Declarations ***************************/
 
 static int ipv6(char *ip);
-static void socketAccept(WebsSocket *sp);
+static int socketAccept(WebsSocket *sp);
 static void socketDoEvent(WebsSocket *sp);
+#if WEBS_EPOLL
+static void epollRemove(WebsSocket *sp);
+static void epollUpdate(WebsSocket *sp);
+static void socketQueue(WebsSocket *sp);
+#endif
 
 /*********************************** Code *************************************/
 
@@ -47,6 +62,12 @@ PUBLIC int socketOpen()
     socketList = NULL;
     socketMax = 0;
     socketHighestFd = -1;
+#if WEBS_EPOLL
+    if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        error("Cannot create epoll, errno %d", errno);
+        return -1;
+    }
+#endif
     if ((fd = socket(AF_INET6, SOCK_STREAM, 0)) != -1) { 
         hasIPv6 = 1;
         closesocket(fd);
@@ -67,6 +88,16 @@ PUBLIC void socketClose()
                 socketCloseConnection(i);
             }
         }
+#if WEBS_EPOLL
+        if (epollFd >= 0) {
+            close(epollFd);
+            epollFd = -1;
+        }
+        wfree(readyList);
+        wfree(queueList);
+        readyList = queueList = NULL;
+        readyCount = readyMax = queueCount = queueMax = 0;
+#endif
         socketOpenCount = 0;
     }
 }
@@ -142,11 +173,12 @@ PUBLIC int socketListen(char *ip, int port, SocketAccept accept, int flags)
     if (setsockopt(sp->sock, SOL_SOCKET, SO_REUSEADDR, (char*) &enable, sizeof(enable)) != 0) {
         error("Cannot set reuseaddr, errno %d", errno);
     }
-#if defined(SO_REUSEPORT) && KEEP && UNUSED
+#if defined(SO_REUSEPORT)
     /*
         This permits multiple servers listening on the same endpoint
      */
-    if (setsockopt(sp->sock, SOL_SOCKET, SO_REUSEPORT, (char*) &enable, sizeof(enable)) != 0) {
+    if ((flags & SOCKET_REUSEPORT) && setsockopt(sp->sock, SOL_SOCKET, SO_REUSEPORT, (char*) &enable, 
+            sizeof(enable)) != 0) {
         error("Cannot set reuseport, errno %d", errno);
     }
 #endif
@@ -181,7 +213,7 @@ PUBLIC int socketListen(char *ip, int port, SocketAccept accept, int flags)
         return -1;
     }
     sp->flags |= SOCKET_LISTENING | SOCKET_NODELAY;
-    sp->handlerMask |= SOCKET_READABLE;
+    socketRegisterInterest(sid, sp->handlerMask | SOCKET_READABLE);
     socketSetBlock(sid, (flags & SOCKET_BLOCK));
     if (sp->flags & SOCKET_NODELAY) {
         socketSetNoDelay(sid, 1);
@@ -290,7 +322,7 @@ PUBLIC void socketCloseConnection(int sid)
 /*
     Accept a connection. Called as a callback on incoming connection.
  */
-static void socketAccept(WebsSocket *sp)
+static int socketAccept(WebsSocket *sp)
 {
     struct sockaddr_storage addrStorage;
     struct sockaddr         *addr;
@@ -308,7 +340,9 @@ static void socketAccept(WebsSocket *sp)
     len = sizeof(addrStorage);
     addr = (struct sockaddr*) &addrStorage;
     if ((newSock = accept(sp->sock, addr, (Socklen*) &len)) == SOCKET_ERROR) {
-        return;
+        /* No more pending connections (or a transient error). Wait for the next edge. */
+        sp->readyEvents &= ~SOCKET_READABLE;
+        return -1;
     }
 #if ME_COMPILER_HAS_FCNTL
     fcntl(newSock, F_SETFD, FD_CLOEXEC);
@@ -318,12 +352,14 @@ static void socketAccept(WebsSocket *sp)
     /*
         Create a socket structure and insert into the socket list
      */
-    nid = socketAlloc(sp->ip, sp->port, sp->accept, sp->flags);
-    if ((nsp = socketList[nid]) == 0) {
-        return;
+    if ((nid = socketAlloc(sp->ip, sp->port, sp->accept, sp->flags)) < 0) {
+        closesocket(newSock);
+        return 0;
     }
+    nsp = socketList[nid];
     assert(nsp);
     nsp->sock = newSock;
+    nsp->secure = sp->secure;
     nsp->flags &= ~SOCKET_LISTENING;
     socketSetBlock(nid, (nsp->flags & SOCKET_BLOCK));
     if (nsp->flags & SOCKET_NODELAY) {
@@ -340,6 +376,7 @@ static void socketAccept(WebsSocket *sp)
             socketFree(nid);
         }
     }
+    return 0;
 }
 
 
@@ -356,6 +393,9 @@ PUBLIC void socketRegisterInterest(int sid, int handlerMask)
     if (sp->flags & SOCKET_BUFFERED_WRITE) {
         sp->handlerMask |= SOCKET_WRITABLE;
     }
+#if WEBS_EPOLL
+    epollUpdate(sp);
+#endif
 }
 
 
@@ -501,6 +541,226 @@ PUBLIC int socketSelect(int sid, WebsTime timeout)
     return nEvents;
 }
 
+#elif WEBS_EPOLL
+
+/*
+    Append a socket ID to a growable list of socket IDs
+ */
+static void addSid(int **list, int *count, int *size, int sid)
+{
+    int     *newList, newSize;
+
+    if (*count >= *size) {
+        newSize = max(*size * 2, 16);
+        if ((newList = wrealloc(*list, newSize * sizeof(int))) == NULL) {
+            return;
+        }
+        *list = newList;
+        *size = newSize;
+    }
+    (*list)[(*count)++] = sid;
+}
+
+
+/*
+    Queue a socket for service on the next socketSelect without waiting for I/O. Used for reserviced sockets and 
+    for edge-triggered sockets that have readiness not yet consumed.
+ */
+static void socketQueue(WebsSocket *sp)
+{
+    if (!(sp->flags & SOCKET_QUEUED)) {
+        sp->flags |= SOCKET_QUEUED;
+        addSid(&queueList, &queueCount, &queueMax, sp->sid);
+    }
+}
+
+
+/*
+    Update the epoll registration for a socket to match its handler mask. Edge-triggered sockets are registered once 
+    for both read and write events and thereafter do not require any system calls to change interest.
+ */
+static void epollUpdate(WebsSocket *sp)
+{
+    struct epoll_event  ev;
+    int                 mask, op;
+
+    mask = sp->handlerMask & (SOCKET_READABLE | SOCKET_WRITABLE);
+    if (sp->flags & SOCKET_EDGE) {
+        if (sp->readyEvents & mask) {
+            /* The socket will not see another edge for readiness it already has */
+            socketQueue(sp);
+        }
+        return;
+    }
+    if (mask == sp->interestEvents) {
+        return;
+    }
+    if (mask == 0) {
+        epollRemove(sp);
+        return;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.data.u32 = (uint) sp->sid;
+    op = sp->interestEvents ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    /*
+        TLS sockets may buffer decrypted data outside the socketRead path and so are always level-triggered
+     */
+    if (ME_GOAHEAD_EPOLL_EDGE && !sp->secure) {
+        sp->flags |= SOCKET_EDGE;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        mask = SOCKET_READABLE | SOCKET_WRITABLE;
+    } else {
+        ev.events = ((mask & SOCKET_READABLE) ? EPOLLIN : 0) | ((mask & SOCKET_WRITABLE) ? EPOLLOUT : 0);
+    }
+#ifdef EPOLLRDHUP
+    ev.events |= EPOLLRDHUP;
+#endif
+    if (epoll_ctl(epollFd, op, sp->sock, &ev) < 0) {
+        error("Cannot update epoll for socket %d, errno %d", sp->sid, errno);
+        sp->flags &= ~SOCKET_EDGE;
+        return;
+    }
+    sp->interestEvents = mask;
+}
+
+
+static void epollRemove(WebsSocket *sp)
+{
+    struct epoll_event  ev;
+
+    if (sp->interestEvents) {
+        memset(&ev, 0, sizeof(ev));
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, sp->sock, &ev);
+        sp->interestEvents = 0;
+        sp->flags &= ~SOCKET_EDGE;
+    }
+}
+
+
+/*
+    Wait for I/O on a single socket. Used by socketWaitForEvent.
+ */
+static int pollSocket(int sid, WebsTime timeout)
+{
+    WebsSocket      *sp;
+    struct pollfd   pfd;
+
+    if ((sp = socketPtr(sid)) == NULL) {
+        return 0;
+    }
+    if (sp->flags & SOCKET_RESERVICE) {
+        sp->currentEvents |= sp->handlerMask & (SOCKET_READABLE | SOCKET_WRITABLE);
+        sp->flags &= ~SOCKET_RESERVICE;
+        return 1;
+    }
+    pfd.fd = sp->sock;
+    pfd.events = ((sp->handlerMask & SOCKET_READABLE) ? POLLIN : 0) | ((sp->handlerMask & SOCKET_WRITABLE) ? POLLOUT : 0);
+    pfd.revents = 0;
+    if (poll(&pfd, 1, (int) min(timeout, MAXINT)) <= 0) {
+        return 0;
+    }
+    if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+        sp->currentEvents |= SOCKET_READABLE;
+    }
+    if (pfd.revents & (POLLOUT | POLLHUP | POLLERR)) {
+        sp->currentEvents |= SOCKET_WRITABLE;
+    }
+    if (pfd.revents & POLLNVAL) {
+        sp->currentEvents |= SOCKET_EXCEPTION;
+    }
+    return 1;
+}
+
+
+/*
+    Wait for I/O events using epoll. Only sockets with events are added to the ready list serviced by socketProcess.
+ */
+PUBLIC int socketSelect(int sid, WebsTime timeout)
+{
+    WebsSocket          *sp;
+    struct epoll_event  events[WEBS_MAX_EVENTS], *ev;
+    int                 i, mask, nevents;
+
+    if (sid >= 0) {
+        return pollSocket(sid, timeout);
+    }
+    if (queueCount > 0) {
+        timeout = 0;
+    }
+    if ((nevents = epoll_wait(epollFd, events, WEBS_MAX_EVENTS, (int) min(timeout, MAXINT))) < 0) {
+        if (errno != EINTR) {
+            error("Epoll wait error, errno %d", errno);
+        }
+        nevents = 0;
+    }
+    readyCount = 0;
+    for (i = 0; i < nevents; i++) {
+        ev = &events[i];
+        sid = (int) ev->data.u32;
+        if (sid >= socketMax || (sp = socketList[sid]) == NULL) {
+            continue;
+        }
+        mask = 0;
+        if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            mask |= SOCKET_READABLE;
+        }
+#ifdef EPOLLRDHUP
+        if (ev->events & EPOLLRDHUP) {
+            mask |= SOCKET_READABLE;
+        }
+#endif
+        if (ev->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+            mask |= SOCKET_WRITABLE;
+        }
+        if (sp->flags & SOCKET_EDGE) {
+            sp->readyEvents |= mask;
+        }
+        if (mask & sp->handlerMask) {
+            sp->currentEvents |= mask & sp->handlerMask;
+            addSid(&readyList, &readyCount, &readyMax, sid);
+        }
+    }
+    for (i = 0; i < queueCount; i++) {
+        sid = queueList[i];
+        if (sid >= socketMax || (sp = socketList[sid]) == NULL || !(sp->flags & SOCKET_QUEUED)) {
+            continue;
+        }
+        sp->flags &= ~SOCKET_QUEUED;
+        mask = sp->readyEvents;
+        if (sp->flags & SOCKET_RESERVICE) {
+            mask |= SOCKET_READABLE | SOCKET_WRITABLE;
+            sp->flags &= ~SOCKET_RESERVICE;
+        }
+        if (mask & sp->handlerMask) {
+            sp->currentEvents |= mask & sp->handlerMask;
+            addSid(&readyList, &readyCount, &readyMax, sid);
+        }
+    }
+    queueCount = 0;
+    return readyCount;
+}
+
+
+PUBLIC void socketProcess()
+{
+    WebsSocket  *sp;
+    int         i, sid;
+
+    for (i = 0; i < readyCount; i++) {
+        sid = readyList[i];
+        if (sid < socketMax && (sp = socketList[sid]) != NULL && (sp->currentEvents & sp->handlerMask)) {
+            socketDoEvent(sp);
+            /*
+                Edge-triggered sockets that did not drain their I/O must be serviced again without waiting
+             */
+            if (socketList && sid < socketMax && socketList[sid] == sp && (sp->readyEvents & sp->handlerMask)) {
+                socketQueue(sp);
+            }
+        }
+    }
+    readyCount = 0;
+}
+
 #else /* !ME_WIN_LIKE */
 
 
@@ -623,6 +883,7 @@ PUBLIC int socketSelect(int sid, WebsTime timeout)
 #endif /* WINDOWS || CE */
 
 
+#if !WEBS_EPOLL
 PUBLIC void socketProcess()
 {
     WebsSocket    *sp;
@@ -636,6 +897,7 @@ PUBLIC void socketProcess()
         }
     }
 }
+#endif
 
 
 static void socketDoEvent(WebsSocket *sp)
@@ -647,7 +909,10 @@ static void socketDoEvent(WebsSocket *sp)
     sid = sp->sid;
     if (sp->currentEvents & SOCKET_READABLE) {
         if (sp->flags & SOCKET_LISTENING) { 
-            socketAccept(sp);
+            /*
+                Edge-triggered listeners must accept all pending connections
+             */
+            while (socketAccept(sp) == 0 && (sp->flags & SOCKET_EDGE)) {}
             sp->currentEvents = 0;
             return;
         } 
@@ -785,11 +1050,18 @@ PUBLIC ssize socketWrite(int sid, void *buf, ssize bufsize)
     len = bufsize;
     sofar = 0;
     while (len > 0) {
-        if ((written = send(sp->sock, (char*) buf + sofar, (int) len, 0)) < 0) {
+#if ME_UNIX_LIKE
+        if (sp->flags & SOCKET_PIPE) {
+            written = write(sp->sock, (char*) buf + sofar, (size_t) len);
+        } else
+#endif
+        written = send(sp->sock, (char*) buf + sofar, (int) len, 0);
+        if (written < 0) {
             errCode = socketGetError();
             if (errCode == EINTR) {
                 continue;
             } else if (errCode == EWOULDBLOCK || errCode == EAGAIN) {
+                sp->readyEvents &= ~SOCKET_WRITABLE;
                 return sofar;
             }
             return -errCode;
@@ -801,6 +1073,80 @@ PUBLIC ssize socketWrite(int sid, void *buf, ssize bufsize)
 }
 
 
+#if ME_UNIX_LIKE
+/*
+    Write a vector of buffers to a socket. Returns the number of bytes written which may be less than the total
+    length if the socket is non-blocking. Returns -1 on errors.
+ */
+PUBLIC ssize socketWritev(int sid, struct iovec *iov, int count)
+{
+    WebsSocket  *sp;
+    ssize       written;
+    int         errCode;
+
+    if (iov == 0 || (sp = socketPtr(sid)) == NULL) {
+        return -1;
+    }
+    if (sp->flags & SOCKET_EOF) {
+        return -1;
+    }
+    while ((written = writev(sp->sock, iov, count)) < 0) {
+        errCode = socketGetError();
+        if (errCode == EINTR) {
+            continue;
+        } else if (errCode == EWOULDBLOCK || errCode == EAGAIN) {
+            sp->readyEvents &= ~SOCKET_WRITABLE;
+            return 0;
+        }
+        return -errCode;
+    }
+    return written;
+}
+#endif
+
+
+#if WEBS_SENDFILE
+/*
+    Write file data to a socket via sendfile. The data is not copied via user memory. Returns the number of bytes 
+    written which may be less than len. Returns -1 on errors or if the file ends prematurely.
+ */
+PUBLIC ssize socketSendFile(int sid, int fd, Offset pos, ssize len)
+{
+    WebsSocket  *sp;
+    off_t       off;
+    ssize       written, sofar;
+    int         errCode;
+
+    if ((sp = socketPtr(sid)) == NULL) {
+        return -1;
+    }
+    if (sp->flags & SOCKET_EOF) {
+        return -1;
+    }
+    sofar = 0;
+    while (len > 0) {
+        off = (off_t) (pos + sofar);
+        if ((written = sendfile(sp->sock, fd, &off, (size_t) min(len, MAXINT))) < 0) {
+            errCode = socketGetError();
+            if (errCode == EINTR) {
+                continue;
+            } else if (errCode == EWOULDBLOCK || errCode == EAGAIN) {
+                sp->readyEvents &= ~SOCKET_WRITABLE;
+                return sofar;
+            }
+            return -errCode;
+        } else if (written == 0) {
+            /* File was truncated */
+            return -1;
+        }
+        len -= written;
+        sofar += written;
+    }
+    return sofar;
+}
+#endif
+
+
 /*
     Read from a socket. Return the number of bytes read if successful. This may be less than the requested "bufsize" and
     may be zero. This routine may block if the socket is in blocking mode.
@@ -821,9 +1167,16 @@ PUBLIC ssize socketRead(int sid, void *buf, ssize bufsize)
     if (sp->flags & SOCKET_EOF) {
         return -1;
     }
-    if ((bytes = recv(sp->sock, buf, (int) bufsize, 0)) < 0) {
+#if ME_UNIX_LIKE
+    if (sp->flags & SOCKET_PIPE) {
+        bytes = read(sp->sock, buf, (size_t) bufsize);
+    } else
+#endif
+    bytes = recv(sp->sock, buf, (int) bufsize, 0);
+    if (bytes < 0) {
         errCode = socketGetError();
         if (errCode == EAGAIN || errCode == EWOULDBLOCK) {
+            sp->readyEvents &= ~SOCKET_READABLE;
             bytes = 0;
         } else {
             /* Conn reset or Some other error */
@@ -861,6 +1214,9 @@ PUBLIC void socketReservice(int sid)
         return;
     }
     sp->flags |= SOCKET_RESERVICE;
+#if WEBS_EPOLL
+    socketQueue(sp);
+#endif
 }
 
 
@@ -918,6 +1274,28 @@ PUBLIC int socketAlloc(char *ip, int port, SocketAccept accept, int flags)
 }
 
 
+#if ME_UNIX_LIKE
+/*
+    Attach a pipe or other non-socket file descriptor to a socket object so it may be serviced by the event loop
+ */
+PUBLIC int socketAttach(int fd)
+{
+    WebsSocket  *sp;
+    int         sid;
+
+    if ((sid = socketAlloc(NULL, 0, NULL, 0)) < 0) {
+        return -1;
+    }
+    sp = socketList[sid];
+    sp->sock = fd;
+    sp->flags |= SOCKET_PIPE;
+    socketSetBlock(sid, 0);
+    socketHighestFd = max(socketHighestFd, fd);
+    return sid;
+}
+#endif
+
+
 /*
     Free a socket structure
  */
@@ -937,7 +1315,12 @@ PUBLIC void socketFree(int sid)
         other end causing problems.
      */
     socketRegisterInterest(sid, 0);
-    if (sp->sock >= 0) {
+#if WEBS_EPOLL
+    epollRemove(sp);
+#endif
+    if (sp->flags & SOCKET_PIPE) {
+        close(sp->sock);
+    } else if (sp->sock >= 0) {
         socketSetBlock(sid, 0);
         while (recv(sp->sock, buf, sizeof(buf), 0) > 0) {}
         if (shutdown(sp->sock, SHUT_RDWR) >= 0) {
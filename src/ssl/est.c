@@ -15,16 +15,24 @@
 
 typedef struct EstConfig {
     rsa_context     rsa;                /* RSA context */
+#if ME_EST_ECP
+    ecp_keypair     eckey;              /* EC P-256 key if the key file is not an RSA key */
+    int             ecdsa;              /* Certificate and key are ECDSA */
+#endif
     x509_cert       cert;               /* Certificate (own) */
     x509_cert       ca;                 /* Certificate authority bundle to verify peer */
     int             *ciphers;           /* Set of acceptable ciphers */
+    ssl_session     *cache;             /* Session cache indexed by session ID */
+    int             cacheSize;          /* Number of cache slots */
+    ssl_tickets     tickets;            /* Session ticket keys. keys[0] is the current key */
+    ctr_drbg_context drbg;              /* Random generator shared by all connections */
+    WebsSslStats    stats;              /* Resumption statistics */
 } EstConfig;
 
 /*
     Per socket state
  */
 typedef struct EstSocket {
-    havege_state    hs;                 /* Random HAVEGE state */
     ssl_context     ctx;                /* SSL state */
     ssl_session     session;            /* SSL sessions */
 } EstSocket;
@@ -50,13 +58,29 @@ static char *dhKey =
 
 static int estHandshake(Webs *wp);
 static void estTrace(void *fp, int level, char *str);
+static int getSession(ssl_context *ctx);
+static void rotateTicketKeys();
+static int setSession(ssl_context *ctx);
+static ssl_session *sessionSlot(uchar *id);
 
 /************************************** Code **********************************/
 
 PUBLIC int sslOpen()
 {
+    char    custom[80];
+
     trace(7, "Initializing EST SSL"); 
 
+    /*
+        Seed the random generator from the system entropy source. Workers call sslOpen after forking so each
+        process has its own generator state.
+     */
+    fmt(custom, sizeof(custom), "goahead %d %d", getpid(), (int) time(0));
+    if (ctr_drbg_init(&estConfig.drbg, NULL, NULL, (uchar*) custom, (int) slen(custom)) != 0) {
+        error("EST: Cannot seed the random generator");
+        return -1;
+    }
+
     /*
         Set the server certificate and key files
      */
@@ -65,8 +89,18 @@ PUBLIC int sslOpen()
             Load a decrypted PEM format private key. The last arg is the private key.
          */
         if (x509parse_keyfile(&estConfig.rsa, ME_GOAHEAD_KEY, 0) < 0) {
-            error("EST: Unable to read key file %s", ME_GOAHEAD_KEY); 
-            return -1;
+#if ME_EST_ECP
+            /*
+                Not an RSA key. Try an EC P-256 key for the ECDHE_ECDSA ciphers.
+             */
+            if (x509parse_eckeyfile(&estConfig.eckey, ME_GOAHEAD_KEY) == 0) {
+                estConfig.ecdsa = 1;
+            } else
+#endif
+            {
+                error("EST: Unable to read key file %s", ME_GOAHEAD_KEY); 
+                return -1;
+            }
         }
     }
     if (*ME_GOAHEAD_CERTIFICATE) {
@@ -77,6 +111,12 @@ PUBLIC int sslOpen()
             error("EST: Unable to read certificate %s", ME_GOAHEAD_CERTIFICATE); 
             return -1;
         }
+#if ME_EST_ECP
+        if (*ME_GOAHEAD_KEY && estConfig.ecdsa != (estConfig.cert.ec.group != ECP_GROUP_NONE)) {
+            error("EST: Certificate %s does not match the key type of %s", ME_GOAHEAD_CERTIFICATE, ME_GOAHEAD_KEY);
+            return -1;
+        }
+#endif
     }
     if (*ME_GOAHEAD_CA) {
         if (x509parse_crtfile(&estConfig.ca, ME_GOAHEAD_CA) != 0) {
@@ -85,12 +125,50 @@ PUBLIC int sslOpen()
         }
     }
     estConfig.ciphers = ssl_create_ciphers(ME_GOAHEAD_CIPHERS);
+
+    if (ME_GOAHEAD_LIMIT_SSL_CACHE > 0) {
+        estConfig.cacheSize = ME_GOAHEAD_LIMIT_SSL_CACHE;
+        if ((estConfig.cache = walloc(estConfig.cacheSize * sizeof(ssl_session))) == 0) {
+            return -1;
+        }
+        memset(estConfig.cache, 0, estConfig.cacheSize * sizeof(ssl_session));
+    }
+    if (ME_GOAHEAD_SSL_TICKETS) {
+        rotateTicketKeys();
+    }
     return 0;
 }
 
 
 PUBLIC void sslClose()
 {
+    if (estConfig.cache) {
+        memset(estConfig.cache, 0, estConfig.cacheSize * sizeof(ssl_session));
+        wfree(estConfig.cache);
+        estConfig.cache = 0;
+    }
+    memset(&estConfig.tickets, 0, sizeof(ssl_tickets));
+    memset(&estConfig.drbg, 0, sizeof(ctr_drbg_context));
+#if ME_EST_ECP
+    ecp_free(&estConfig.eckey);
+#endif
+}
+
+
+PUBLIC void sslStats(WebsSslStats *stats)
+{
+    ssl_session     *sp;
+    time_t          now;
+
+    assert(stats);
+    *stats = estConfig.stats;
+    stats->cached = 0;
+    now = time(0);
+    for (sp = estConfig.cache; sp && sp < &estConfig.cache[estConfig.cacheSize]; sp++) {
+        if (sp->length && (now - sp->start) <= ME_GOAHEAD_LIMIT_SSL_LIFESPAN) {
+            stats->cached++;
+        }
+    }
 }
 
 
@@ -107,20 +185,32 @@ PUBLIC int sslUpgrade(Webs *wp)
     wp->ssl = est;
 
     ssl_free(&est->ctx);
-    havege_init(&est->hs);
     ssl_init(&est->ctx);
 	ssl_set_endpoint(&est->ctx, 1);
 	ssl_set_authmode(&est->ctx, ME_GOAHEAD_VERIFY_PEER ? SSL_VERIFY_OPTIONAL : SSL_VERIFY_NO_CHECK);
-    ssl_set_rng(&est->ctx, havege_rand, &est->hs);
+    ssl_set_rng(&est->ctx, ctr_drbg_rand, &estConfig.drbg);
 	ssl_set_dbg(&est->ctx, estTrace, NULL);
     sp = socketPtr(wp->sid);
 	ssl_set_bio(&est->ctx, net_recv, &sp->sock, net_send, &sp->sock);
     ssl_set_ciphers(&est->ctx, estConfig.ciphers);
-	ssl_set_session(&est->ctx, 1, 0, &est->session);
-	memset(&est->session, 0, sizeof(ssl_session));
+	ssl_set_session(&est->ctx, 1, ME_GOAHEAD_LIMIT_SSL_LIFESPAN, &est->session);
+    if (estConfig.cache) {
+        ssl_set_scb(&est->ctx, getSession, setSession);
+    } else {
+        ssl_set_scb(&est->ctx, NULL, NULL);
+    }
+    if (ME_GOAHEAD_SSL_TICKETS) {
+        rotateTicketKeys();
+        ssl_set_tickets(&est->ctx, &estConfig.tickets);
+    }
 
 	ssl_set_ca_chain(&est->ctx, *ME_GOAHEAD_CA ? &estConfig.ca : NULL, NULL);
     if (*ME_GOAHEAD_CERTIFICATE && *ME_GOAHEAD_KEY) {
+#if ME_EST_ECP
+        if (estConfig.ecdsa) {
+            ssl_set_own_ec_cert(&est->ctx, &estConfig.cert, &estConfig.eckey);
+        } else
+#endif
         ssl_set_own_cert(&est->ctx, &estConfig.cert, &estConfig.rsa);
     }
 	ssl_set_dh_param(&est->ctx, dhKey, dhg);
@@ -172,6 +262,18 @@ static int estHandshake(Webs *wp)
     }
     sp->flags &= ~SOCKET_HANDSHAKING;
 
+    if (rc == 0) {
+        if (est->ctx.ticket_resume) {
+            estConfig.stats.ticketHits++;
+        } else if (est->ctx.ticket_offered) {
+            estConfig.stats.ticketMisses++;
+        }
+        if (est->ctx.new_ticket == 0 && est->ctx.ticket_ext && !est->ctx.resume) {
+            estConfig.stats.ticketsIssued++;
+        }
+        trace(5, "EST: handshake %s", est->ctx.resume ? "resumed" : "complete");
+    }
+
     /*
         Analyze the handshake result
      */
@@ -325,6 +427,94 @@ PUBLIC ssize sslWrite(Webs *wp, void *buf, ssize len)
 }
 
 
+/*
+    Session cache slots are indexed by the leading bytes of the session ID. Server session IDs are random.
+    A new session replaces the slot's previous session.
+ */
+static ssl_session *sessionSlot(uchar *id)
+{
+    uint    hash;
+
+    hash = ((uint) id[0] << 24) | ((uint) id[1] << 16) | ((uint) id[2] << 8) | id[3];
+    return &estConfig.cache[hash % estConfig.cacheSize];
+}
+
+
+/*
+    Session get callback for the handshake. Return 0 if the session was found and the master secret restored.
+ */
+static int getSession(ssl_context *ctx)
+{
+    ssl_session     *sp;
+
+    sp = sessionSlot(ctx->session->id);
+    if (sp->length == 0 || sp->length != ctx->session->length || sp->cipher != ctx->session->cipher ||
+            memcmp(sp->id, ctx->session->id, sp->length) != 0) {
+        estConfig.stats.misses++;
+        return 1;
+    }
+    if ((time(0) - sp->start) > ctx->timeout) {
+        memset(sp, 0, sizeof(ssl_session));
+        estConfig.stats.misses++;
+        return 1;
+    }
+    memcpy(ctx->session->master, sp->master, sizeof(sp->master));
+    estConfig.stats.hits++;
+    return 0;
+}
+
+
+/*
+    Session set callback. Called once the master secret is derived for a new session.
+    Sessions that will receive a ticket are not cached.
+ */
+static int setSession(ssl_context *ctx)
+{
+    ssl_session     *sp;
+
+    if (ctx->new_ticket) {
+        return 0;
+    }
+    sp = sessionSlot(ctx->session->id);
+    if (sp->length && (time(0) - sp->start) <= ctx->timeout) {
+        estConfig.stats.evictions++;
+    }
+    memcpy(sp, ctx->session, sizeof(ssl_session));
+    sp->next = 0;
+    return 0;
+}
+
+
+/*
+    Create a new ticket encryption key when the current key is older than the rotation period.
+    The previous key is retained so outstanding tickets remain valid for one more period.
+ */
+static void rotateTicketKeys()
+{
+    ssl_ticket_key  *key;
+    time_t          now;
+    int             i;
+
+    now = time(0);
+    key = &estConfig.tickets.keys[0];
+    if (key->created && (now - key->created) < ME_GOAHEAD_SSL_TICKET_ROTATE) {
+        return;
+    }
+    for (i = SSL_TICKET_KEYS - 1; i > 0; i--) {
+        estConfig.tickets.keys[i] = estConfig.tickets.keys[i - 1];
+    }
+    if (ctr_drbg_random(&estConfig.drbg, key->name, sizeof(key->name)) != 0 ||
+            ctr_drbg_random(&estConfig.drbg, key->aes, sizeof(key->aes)) != 0 ||
+            ctr_drbg_random(&estConfig.drbg, key->mac, sizeof(key->mac)) != 0) {
+        error("EST: Cannot create session ticket key");
+        memset(key, 0, sizeof(ssl_ticket_key));
+        return;
+    }
+    key->created = now;
+    trace(5, "EST: rotated session ticket keys");
+}
+
+
 static void estTrace(void *fp, int level, char *str)
 {
     level += 3;
@@ -19,12 +19,23 @@
 #define UPLOAD_CONTENT_DATA      4   /* Content encoded data */
 #define UPLOAD_CONTENT_END       5   /* End of multipart message */
 
+/*
+    File data is written in multiples of this size so writes stay aligned to file system blocks
+ */
+#define UPLOAD_ALIGN             4096
+
+/*
+    Maximum boundary delimiter length: "\r\n--" plus a boundary of up to 70 characters (RFC 2046)
+ */
+#define UPLOAD_MAX_DELIMITER     74
+
 static char *uploadDir;
+static WebsUploadProc uploadProc;   /* Callback to receive file data instead of writing temp files */
 
 /*********************************** Forwards *********************************/
 
 static void defineUploadVars(Webs *wp);
-static char *getBoundary(Webs *wp, char *buf, ssize bufLen);
+static ssize findBoundary(Webs *wp, char *buf, ssize len);
 static int initUpload(Webs *wp);
 static int processContentBoundary(Webs *wp, char *line);
 static int processContentData(Webs *wp);
@@ -45,21 +56,35 @@ static bool uploadHandler(Webs *wp)
 }
 
 
+/*
+    The boundary is stored as the delimiter "\r\n--boundary" that terminates part data. A Boyer-Moore-Horspool skip
+    table is built so part data can be searched for the delimiter without examining every byte.
+ */
 static int initUpload(Webs *wp)
 {
     char    *boundary;
+    ssize   i, last;
     
     if (wp->uploadState == 0) {
         wp->uploadState = UPLOAD_BOUNDARY;
         if ((boundary = strstr(wp->contentType, "boundary=")) != 0) {
             boundary += 9;
-            wp->boundary = sfmt("--%s", boundary);
+            wp->boundary = sfmt("\r\n--%s", boundary);
             wp->boundaryLen = strlen(wp->boundary);
         }
-        if (wp->boundaryLen == 0 || *wp->boundary == '\0') {
+        if (wp->boundaryLen <= 4 || wp->boundaryLen > UPLOAD_MAX_DELIMITER) {
             websError(wp, HTTP_CODE_BAD_REQUEST, "Bad boundary");
             return -1;
         }
+        if ((wp->boundarySkip = walloc(256)) == 0) {
+            websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot get memory");
+            return -1;
+        }
+        last = wp->boundaryLen - 1;
+        memset(wp->boundarySkip, (int) wp->boundaryLen, 256);
+        for (i = 0; i < last; i++) {
+            wp->boundarySkip[(uchar) wp->boundary[i]] = (uchar) (last - i);
+        }
         websSetVar(wp, "UPLOAD_DIR", uploadDir);
         wp->files = hashCreate(11);
     }
@@ -93,6 +118,12 @@ PUBLIC void websFreeUpload(Webs *wp)
     }
     hashFree(wp->files);
     if (wp->currentFile) {
+        if (wp->clientFilename && uploadProc) {
+            /*
+                Tell the upload callback the file is incomplete
+             */
+            (uploadProc)(wp, wp->currentFile, 0, -1);
+        }
         freeUploadFile(wp->currentFile);
         wp->currentFile = 0;
     }
@@ -100,6 +131,8 @@ PUBLIC void websFreeUpload(Webs *wp)
         close(wp->upfd);
         wp->upfd = -1;
     }
+    wfree(wp->clientFilename);
+    wp->clientFilename = 0;
 }
 
 
@@ -107,12 +140,14 @@ PUBLIC int websProcessUploadData(Webs *wp)
 {
     char    *line, *nextTok;
     ssize   len, nbytes;
-    int     done, rc;
+    int     done;
     
     for (done = 0, line = 0; !done; ) {
+        nbytes = 0;
         if  (wp->uploadState == UPLOAD_BOUNDARY || wp->uploadState == UPLOAD_CONTENT_HEADER) {
             /*
-                Parse the next input line
+                Parse the next input line. The line is consumed once it is processed, as consuming all the input
+                resets the buffer and would truncate the line.
              */
             line = wp->input.servp;
             if ((nextTok = memchr(line, '\n', bufLen(&wp->input))) == 0) {
@@ -121,10 +156,9 @@ PUBLIC int websProcessUploadData(Webs *wp)
             }
             *nextTok++ = '\0';
             nbytes = nextTok - line;
-            websConsumeInput(wp, nbytes);
             strim(line, "\r", WEBS_TRIM_END);
             len = strlen(line);
-            if (line[len - 1] == '\r') {
+            if (len > 0 && line[len - 1] == '\r') {
                 line[len - 1] = '\0';
             }
         }
@@ -148,11 +182,8 @@ PUBLIC int websProcessUploadData(Webs *wp)
             break;
 
         case UPLOAD_CONTENT_DATA:
-            if ((rc = processContentData(wp)) < 0) {
-                done++;
-            }
-            if (bufLen(&wp->input) < wp->boundaryLen) {
-                /*  Incomplete boundary - return to get more data */
+            if (processContentData(wp) <= 0) {
+                /*  Error or incomplete boundary - return to get more data */
                 done++;
             }
             break;
@@ -161,6 +192,9 @@ PUBLIC int websProcessUploadData(Webs *wp)
             done++;
             break;
         }
+        if (nbytes > 0) {
+            websConsumeInput(wp, nbytes);
+        }
     }
     if (!websValid(wp)) {
         return -1;
@@ -172,14 +206,17 @@ PUBLIC int websProcessUploadData(Webs *wp)
 
 static int processContentBoundary(Webs *wp, char *line)
 {
+    ssize   len;
+
     /*
-        Expecting a multipart boundary string
+        Expecting a multipart boundary string. This is the delimiter without the leading "\r\n".
      */
-    if (strncmp(wp->boundary, line, wp->boundaryLen) != 0) {
+    len = wp->boundaryLen - 2;
+    if (strncmp(&wp->boundary[2], line, len) != 0) {
         websError(wp, HTTP_CODE_BAD_REQUEST, "Bad upload state. Incomplete boundary");
         return -1;
     }
-    if (line[wp->boundaryLen] && strcmp(&line[wp->boundaryLen], "--") == 0) {
+    if (line[len] && strcmp(&line[len], "--") == 0) {
         wp->uploadState = UPLOAD_CONTENT_END;
     } else {
         wp->uploadState = UPLOAD_CONTENT_HEADER;
@@ -217,7 +254,8 @@ static int processUploadHeader(Webs *wp, char *line)
             ---boundary
          */
         key = rest;
-        wp->uploadVar = wp->clientFilename = 0;
+        wfree(wp->uploadVar);
+        wp->uploadVar = 0;
         while (key && stok(key, ";\r\n", &nextPair)) {
 
             key = strim(key, " ", WEBS_TRIM_BOTH);
@@ -228,6 +266,7 @@ static int processUploadHeader(Webs *wp, char *line)
                 /* Nothing to do */
 
             } else if (scaselesscmp(key, "name") == 0) {
+                wfree(wp->uploadVar);
                 wp->uploadVar = sclone(value);
 
             } else if (scaselesscmp(key, "filename") == 0) {
@@ -235,7 +274,9 @@ static int processUploadHeader(Webs *wp, char *line)
                     websError(wp, HTTP_CODE_BAD_REQUEST, "Bad upload state. Missing name field");
                     return -1;
                 }
-                value = websNormalizeUriPath(value);
+                /*
+                    The client filename must be a plain name without path separators
+                 */
                 if (*value == '.' || !websValidUriChars(value) || strpbrk(value, "\\/:*?<>|~\"'%`^\n\r\t\f")) {
                     websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Bad upload client filename");
                     return -1;
@@ -243,27 +284,33 @@ static int processUploadHeader(Webs *wp, char *line)
                 wfree(wp->clientFilename);
                 wp->clientFilename = sclone(value);
 
-                /*  
-                    Create the file to hold the uploaded data
-                 */
-                if ((wp->uploadTmp = websTempFile(uploadDir, "tmp")) == 0) {
-                    websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, 
-                        "Cannot create upload temp file %s. Check upload temp dir %s", wp->uploadTmp, uploadDir);
-                    return -1;
-                }
-                trace(5, "File upload of: %s stored as %s", wp->clientFilename, wp->uploadTmp);
-
-                if ((wp->upfd = open(wp->uploadTmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600)) < 0) {
-                    websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot open upload temp file %s", wp->uploadTmp);
-                    return -1;
-                }
                 /*  
                     Create the files[id]
                  */
                 file = wp->currentFile = walloc(sizeof(WebsUpload));
                 memset(file, 0, sizeof(WebsUpload));
                 file->clientFilename = sclone(wp->clientFilename);
-                file->filename = sclone(wp->uploadTmp);
+                if (uploadProc) {
+                    trace(5, "File upload of: %s passed to the upload callback", wp->clientFilename);
+
+                } else {
+                    /*  
+                        Create the file to hold the uploaded data
+                     */
+                    if ((wp->uploadTmp = websTempFile(uploadDir, "tmp")) == 0) {
+                        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, 
+                            "Cannot create upload temp file %s. Check upload temp dir %s", wp->uploadTmp, uploadDir);
+                        return -1;
+                    }
+                    trace(5, "File upload of: %s stored as %s", wp->clientFilename, wp->uploadTmp);
+
+                    if ((wp->upfd = open(wp->uploadTmp, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0600)) < 0) {
+                        websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot open upload temp file %s", 
+                            wp->uploadTmp);
+                        return -1;
+                    }
+                    file->filename = sclone(wp->uploadTmp);
+                }
             }
             key = nextPair;
         }
@@ -298,6 +345,9 @@ static void defineUploadVars(Webs *wp)
 }
 
 
+/*
+    Pass file data to the upload callback or write it to the temp file
+ */
 static int writeToFile(Webs *wp, char *data, ssize len)
 {
     WebsUpload      *file;
@@ -310,10 +360,17 @@ static int writeToFile(Webs *wp, char *data, ssize len)
         return -1;
     }
     if (len > 0) {
-        /*  
-            File upload. Write the file data.
-         */
-        if ((rc = write(wp->upfd, data, (int) len)) != len) {
+        if (uploadProc) {
+            if ((uploadProc)(wp, file, data, len) < 0) {
+                if (websValid(wp) && wp->state < WEBS_COMPLETE) {
+                    websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Upload callback failed");
+                }
+                return -1;
+            }
+        } else if ((rc = write(wp->upfd, data, (int) len)) != len) {
+            /*  
+                File upload. Write the file data.
+             */
             websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Cannot write to upload temp file %s, rc %d", wp->uploadTmp, rc);
             return -1;
         }
@@ -324,114 +381,134 @@ static int writeToFile(Webs *wp, char *data, ssize len)
 }
 
 
+/*
+    Process part data. File data is streamed out as it arrives in writes of at least ME_GOAHEAD_LIMIT_UPLOAD_BUFFER 
+    bytes. Data that may hold the start of a delimiter split across reads is retained until more data arrives. 
+    Form variables are accumulated until the delimiter is seen and are limited to ME_GOAHEAD_LIMIT_POST. Returns 1
+    when the part is complete, 0 if more data is required and -1 on errors.
+ */
 static int processContentData(Webs *wp)
 {
-    WebsUpload  *file;
+    WebsUpload      *file;
     WebsBuf         *content;
     ssize           size, nbytes;
-    char            *data, *bp;
+    char            *data;
 
     content = &wp->input;
     file = wp->currentFile;
-
+    data = content->servp;
     size = bufLen(content);
-    if (size < wp->boundaryLen) {
-        /*  Incomplete boundary. Return and get more data */
-        return 0;
-    }
-    if ((bp = getBoundary(wp, content->servp, size)) == 0) {
-        trace(7, "uploadFilter: Got boundary filename %x", wp->clientFilename);
+
+    if ((nbytes = findBoundary(wp, data, size)) < 0) {
         if (wp->clientFilename) {
-            /*  
-                No signature found yet. probably more data to come. Must handle split boundaries.
-             */
-            data = content->servp;
-            nbytes = ((int) (content->endp - data)) - (wp->boundaryLen - 1);
-            if (nbytes > 0 && writeToFile(wp, content->servp, nbytes) < 0) {
-                return -1;
+            nbytes = size - (wp->boundaryLen - 1);
+            if (nbytes >= ME_GOAHEAD_LIMIT_UPLOAD_BUFFER) {
+                nbytes &= ~(UPLOAD_ALIGN - 1);
+                if (writeToFile(wp, data, nbytes) < 0) {
+                    return -1;
+                }
+                websConsumeInput(wp, nbytes);
+                wp->uploadScan -= nbytes;
             }
-            websConsumeInput(wp, nbytes);
-            /* Get more data */
-            return 0;
+        } else if (size - (wp->boundaryLen - 1) > ME_GOAHEAD_LIMIT_POST) {
+            websError(wp, HTTP_CODE_REQUEST_TOO_LARGE, "Uploaded form field exceeds maximum %d", 
+                (int) ME_GOAHEAD_LIMIT_POST);
+            return -1;
         }
+        /* Get more data */
+        return 0;
     }
-    data = content->servp;
-    nbytes = (bp) ? (bp - data) : bufLen(content);
-
-    if (nbytes > 0) {
-        websConsumeInput(wp, nbytes);
+    if (wp->clientFilename) {
         /*  
-            This is the CRLF before the boundary
+            Write the last bit of file data and add to the list of files and define environment variables
          */
-        if (nbytes >= 2 && data[nbytes - 2] == '\r' && data[nbytes - 1] == '\n') {
-            nbytes -= 2;
+        if (writeToFile(wp, data, nbytes) < 0) {
+            return -1;
         }
-        if (wp->clientFilename) {
-            /*  
-                Write the last bit of file data and add to the list of files and define environment variables
-             */
-            if (writeToFile(wp, data, nbytes) < 0) {
-                return -1;
+        if (uploadProc && (uploadProc)(wp, file, 0, 0) < 0) {
+            if (websValid(wp) && wp->state < WEBS_COMPLETE) {
+                websError(wp, HTTP_CODE_INTERNAL_SERVER_ERROR, "Upload callback failed");
             }
-            hashEnter(wp->files, wp->uploadVar, valueSymbol(file), 0);
-            defineUploadVars(wp);
-
-        } else {
-            /*  
-                Normal string form data variables
-             */
-            data[nbytes] = '\0'; 
-            trace(5, "uploadFilter: form[%s] = %s", wp->uploadVar, data);
-            websDecodeUrl(wp->uploadVar, wp->uploadVar, -1);
-            websDecodeUrl(data, data, -1);
-            websSetVar(wp, wp->uploadVar, data);
+            return -1;
         }
-    }
-    if (wp->clientFilename) {
+        hashEnter(wp->files, wp->uploadVar, valueSymbol(file), 0);
+        defineUploadVars(wp);
         /*  
             Now have all the data (we've seen the boundary)
          */
-        close(wp->upfd);
-        wp->upfd = -1;
+        if (wp->upfd >= 0) {
+            close(wp->upfd);
+            wp->upfd = -1;
+        }
+        wfree(wp->clientFilename);
         wp->clientFilename = 0;
         wfree(wp->uploadTmp);
         wp->uploadTmp = 0;
+
+    } else {
+        /*  
+            Normal string form data variables. The delimiter follows the data so it can be terminated in place.
+         */
+        data[nbytes] = '\0'; 
+        trace(5, "uploadFilter: form[%s] = %s", wp->uploadVar, data);
+        websDecodeUrl(wp->uploadVar, wp->uploadVar, -1);
+        websDecodeUrl(data, data, -1);
+        websSetVar(wp, wp->uploadVar, data);
     }
+    /*
+        Consume the data and the "\r\n" that starts the delimiter. The boundary line is parsed next.
+     */
+    websConsumeInput(wp, nbytes + 2);
+    wp->uploadScan = 0;
     wp->uploadState = UPLOAD_BOUNDARY;
-    return 0;
+    return 1;
 }
 
 
 /*  
-    Find the boundary signature in memory. Returns pointer to the first match.
+    Find the boundary delimiter in memory using the Boyer-Moore-Horspool algorithm. The last byte of the current 
+    window selects how far the window can be advanced. The search resumes where the previous search of the part data
+    ended, less the delimiter length minus one so a delimiter split across reads is found. Returns the offset of the
+    first match or -1.
  */ 
-static char *getBoundary(Webs *wp, char *buf, ssize bufLen)
+static ssize findBoundary(Webs *wp, char *buf, ssize len)
 {
-    char    *cp, *endp;
-    char    first;
+    uchar   *skip, *pattern, *cp, *endp;
+    ssize   last;
+    uchar   c;
 
     assert(buf);
 
-    first = *wp->boundary;
-    cp = buf;
-    if (bufLen < wp->boundaryLen) {
-        return 0;
+    pattern = (uchar*) wp->boundary;
+    skip = wp->boundarySkip;
+    last = wp->boundaryLen - 1;
+    if (len < wp->boundaryLen) {
+        return -1;
     }
-    endp = cp + (bufLen - wp->boundaryLen) + 1;
-    while (cp < endp) {
-        cp = (char *) memchr(cp, first, endp - cp);
-        if (!cp) {
-            return 0;
+    endp = (uchar*) &buf[len - last];
+    for (cp = (uchar*) &buf[wp->uploadScan]; cp < endp; cp += skip[c]) {
+        c = cp[last];
+        if (c == pattern[last] && memcmp(cp, pattern, last) == 0) {
+            return (ssize) (cp - (uchar*) buf);
         }
-        if (memcmp(cp, wp->boundary, wp->boundaryLen) == 0) {
-            return cp;
-        }
-        cp++;
     }
-    return 0;
+    wp->uploadScan = len - last;
+    return -1;
 }
 
 
+/*
+    Define a callback to receive uploaded file data instead of writing it to temp files
+ */
+PUBLIC WebsUploadProc websSetUploadProc(WebsUploadProc proc)
+{
+    WebsUploadProc  prior;
+
+    prior = uploadProc;
+    uploadProc = proc;
+    return prior;
+}
+
 
 WebsUpload *websLookupUpload(Webs *wp, char *key)
 {
@@ -0,0 +1,58 @@
+/*
+    fastcgi.tst - FastCGI handler tests
+ */
+
+const HTTP = App.config.uris.http || "127.0.0.1:4100"
+let http: Http = new Http
+
+if (App.config.bit_cgi && Path(test.top).join("test/fcgi-bin/fcgitest").exists) {
+
+    function pid(): String {
+        return http.response.replace(/.*PID=([0-9]+).*/s, "$1")
+    }
+
+    //  Request and response round trip through a worker
+    http.get(HTTP + "/fcgi-bin/fcgitest?hello")
+    assert(http.status == 200)
+    assert(http.header("Content-Type") == "text/plain")
+    assert(http.response.contains("fcgitest: Output"))
+    assert(http.response.contains("QUERY=hello"))
+    http.close()
+
+    //  Keep-alive requests reuse the worker connection
+    for (i in 10) {
+        http.get(HTTP + "/fcgi-bin/fcgitest?request" + i)
+        assert(http.status == 200)
+        assert(http.response.contains("QUERY=request" + i))
+    }
+    http.close()
+
+    //  The request body is passed to the program
+    let body = ""
+    for (i in 200) {
+        body += "Line " + i + " \r\n--boundary\t" + i + "\n"
+    }
+    http.post(HTTP + "/fcgi-bin/fcgitest?echo", body)
+    assert(http.status == 200)
+    assert(http.header("X-Length") == body.length.toString())
+    assert(http.response == body)
+    http.close()
+
+    //  Exit both workers. Later requests wait until the workers are restarted.
+    let exited = []
+    for (i in 2) {
+        http.get(HTTP + "/fcgi-bin/fcgitest?exit")
+        assert(http.status == 200)
+        exited.push(pid())
+        http.close()
+    }
+    assert(exited[0] != exited[1])
+    http.get(HTTP + "/fcgi-bin/fcgitest?restarted")
+    assert(http.status == 200)
+    assert(http.response.contains("QUERY=restarted"))
+    assert(!exited.contains(pid()))
+    http.close()
+
+} else {
+    test.skip("FastCGI not enabled")
+}
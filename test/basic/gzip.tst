@@ -0,0 +1,115 @@
+/*
+    gzip.tst - Content encoding tests for pre-compressed documents and dynamic compression
+ */
+
+const HTTP = App.config.uris.http || "127.0.0.1:4100"
+let http: Http = new Http
+
+/*
+    Pre-compressed sibling. The document is written first so the sibling is not older.
+ */
+let doc = Path("../web/tmp/gzip-" + hashcode(self) + ".txt")
+let gz = Path(doc + ".gz")
+doc.write("Hello World\n")
+Path("../web/compress/compressed.txt.gz").copy(gz)
+let uri = HTTP + "/tmp/" + doc.basename
+
+try {
+    //  A client that accepts gzip gets the sibling
+    http.setHeader("Accept-Encoding", "gzip, deflate")
+    http.get(uri)
+    assert(http.status == 200)
+    assert(http.header("Content-Encoding") == "gzip")
+    assert(http.header("Vary") == "Accept-Encoding")
+    assert(http.header("Content-Length") == gz.size.toString())
+    http.close()
+
+    //  Other clients get the document. The response still varies by Accept-Encoding.
+    http.reset()
+    http.get(uri)
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    assert(http.header("Vary") == "Accept-Encoding")
+    assert(http.response == "Hello World\n")
+    http.close()
+
+    //  A zero quality value refuses gzip
+    http.reset()
+    http.setHeader("Accept-Encoding", "gzip;q=0, identity")
+    http.get(uri)
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    assert(http.header("Vary") == "Accept-Encoding")
+    assert(http.response == "Hello World\n")
+    http.close()
+
+    //  Codings that merely contain "gzip" are not gzip
+    http.reset()
+    http.setHeader("Accept-Encoding", "x-gzip2")
+    http.get(uri)
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    http.close()
+}
+finally {
+    doc.remove()
+    gz.remove()
+}
+
+//  A sibling without the document is not served
+http.reset()
+http.setHeader("Accept-Encoding", "gzip")
+http.get(HTTP + "/compress/compressed.txt")
+assert(http.status == 404)
+http.close()
+
+//  Documents without a sibling do not vary
+http.reset()
+http.setHeader("Accept-Encoding", "gzip")
+http.get(HTTP + "/index.html")
+assert(http.status == 200)
+assert(!http.header("Content-Encoding"))
+assert(!http.header("Vary"))
+http.close()
+
+/*
+    Dynamic compression
+ */
+if (App.config.bit_zlib) {
+    //  Large dynamic responses are compressed for clients that accept gzip
+    http.reset()
+    http.setHeader("Accept-Encoding", "gzip")
+    http.get(HTTP + "/big.asp")
+    assert(http.status == 200)
+    assert(http.header("Content-Encoding") == "gzip")
+    assert(http.header("Vary") == "Accept-Encoding")
+    http.close()
+
+    //  Identity responses that could have been compressed still vary by Accept-Encoding
+    http.reset()
+    http.get(HTTP + "/big.asp")
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    assert(http.header("Vary") == "Accept-Encoding")
+    assert(http.response.contains("Line: 799"))
+    http.close()
+
+    http.reset()
+    http.setHeader("Accept-Encoding", "gzip;q=0")
+    http.get(HTTP + "/big.asp")
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    assert(http.header("Vary") == "Accept-Encoding")
+    http.close()
+
+    //  Small responses are not worth compressing
+    http.reset()
+    http.setHeader("Accept-Encoding", "gzip")
+    http.get(HTTP + "/test.asp")
+    assert(http.status == 200)
+    assert(!http.header("Content-Encoding"))
+    assert(http.header("Vary") == "Accept-Encoding")
+    http.close()
+} else {
+    test.skip("Dynamic compression not enabled")
+}
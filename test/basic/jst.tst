@@ -0,0 +1,47 @@
+/*
+    jst.tst - Javascript template tests
+ */
+
+const HTTP = App.config.uris.http || "127.0.0.1:4100"
+let http: Http = new Http
+
+let page = Path("../web/tmp/jst-" + hashcode(self) + ".asp")
+let uri = HTTP + "/tmp/" + page.basename
+
+try {
+    //  Pre-parsed calls with literal and variable arguments
+    page.write('<html><body><% write("Name:", name, ":", 42); %></body></html>\n')
+    http.get(uri + "?name=Ralph")
+    assert(http.status == 200)
+    assert(http.response.startsWith("<html><body>"))
+    assert(http.response.contains("Ralph"))
+    assert(http.response.contains("42"))
+    assert(http.response.endsWith("</body></html>\n"))
+    assert(!http.response.contains("write"))
+    http.close()
+
+    //  The cached page uses the variables of each request
+    http.get(uri + "?name=Jane")
+    assert(http.status == 200)
+    assert(http.response.contains("Jane"))
+    assert(!http.response.contains("Ralph"))
+    http.close()
+
+    //  A rewritten page is recompiled
+    page.write('<html><body>Rewritten <% write("Page"); %></body></html>\n')
+    http.get(uri + "?name=Ralph")
+    assert(http.status == 200)
+    assert(http.response == "<html><body>Rewritten Page</body></html>\n")
+    http.close()
+
+    //  Undefined variables are reported by the interpreter
+    page.write('<html><body><% write(missing); %></body></html>\n')
+    http.get(uri)
+    assert(http.status == 200)
+    assert(http.response.contains("Javascript Error"))
+    assert(http.response.contains("Undefined variable missing"))
+    http.close()
+}
+finally {
+    page.remove()
+}
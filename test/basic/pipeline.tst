@@ -0,0 +1,92 @@
+/*
+    pipeline.tst - Pipelined keep-alive requests and output backpressure
+ */
+
+const HTTP: Uri = App.config.uris.http || "127.0.0.1:4100"
+const TESTFILE = "pipeline-" + hashcode(self) + ".tdat"
+
+let s
+let response = new ByteArray
+
+//  Read responses until the server closes the connection
+function readAll(s: Socket): String {
+    response.reset()
+    for (count = 0; (n = s.read(response, -1)) != null; count += n) { }
+    return response.toString()
+}
+
+//  Pipelined requests written together are all answered in order. The last request closes the connection.
+s = new Socket
+s.connect(HTTP.address)
+s.write("GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+        "GET /lines.txt HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+        "GET /missing.html HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+        "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n")
+let text = readAll(s)
+s.close()
+assert(text.split("HTTP/1.1 200 OK").length == 4)
+assert(text.contains("HTTP/1.1 404 Not Found"))
+assert(text.indexOf("Hello /index") < text.indexOf("LINE 3"))
+assert(text.indexOf("LINE 3") < text.indexOf("404 Not Found"))
+assert(text.lastIndexOf("Hello /index") > text.indexOf("404 Not Found"))
+
+//  Pipelined requests that arrive in separate writes
+s = new Socket
+s.connect(HTTP.address)
+s.write("GET /lines.txt HTTP/1.1\r\nHost: localhost\r\n\r\nGET /index")
+App.sleep(200)
+s.write(".html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n")
+text = readAll(s)
+s.close()
+assert(text.split("HTTP/1.1 200 OK").length == 3)
+assert(text.indexOf("LINE 3") < text.indexOf("Hello /index"))
+
+//  Create a document larger than the socket buffers
+let buf = new ByteArray
+for (i in 64) {
+    for (j in 63) {
+        buf.writeByte("A".charCodeAt(0) + (j % 26))
+    }
+    buf.writeByte("\n".charCodeAt(0))
+}
+let f = File(Path("../web").join(TESTFILE)).open({mode: "w"})
+for (i in 1024) {
+    f.write(buf)
+}
+f.close()
+let size = Path("../web").join(TESTFILE).size
+
+try {
+    //  A client that does not read its responses. The server must queue output and complete both requests
+    //  once the client catches up.
+    s = new Socket
+    s.connect(HTTP.address)
+    s.write("GET /" + TESTFILE + " HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+            "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n")
+    App.sleep(1000)
+    text = readAll(s)
+    s.close()
+    assert(text.contains("Content-Length: " + size))
+    assert(text.length > size)
+    assert(text.split("HTTP/1.1 200 OK").length == 3)
+    assert(text.contains("Hello /index"))
+
+    //  Slow reader of dynamic output
+    s = new Socket
+    s.connect(HTTP.address)
+    s.write("GET /big.asp HTTP/1.0\r\n\r\n")
+    App.sleep(500)
+    text = readAll(s)
+    s.close()
+    assert(text.contains("200 OK"))
+    assert(text.contains("Line: 799"))
+
+    //  The server is still responsive
+    let http: Http = new Http
+    http.get(HTTP + "/index.html")
+    assert(http.status == 200)
+    http.close()
+}
+finally {
+    Path("../web").join(TESTFILE).remove()
+}
@@ -0,0 +1,106 @@
+/*
+    range.tst - Entity tag, conditional and byte range tests
+ */
+
+const HTTP = App.config.uris.http || "127.0.0.1:4100"
+let http: Http = new Http
+
+//  numbers.txt is 50 digits followed by "END\n"
+const SIZE = 54
+
+//  Documents have a strong entity tag
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 200)
+let etag = http.header("ETag")
+let lastModified = http.header("Last-Modified")
+assert(etag && etag.startsWith('"') && etag.endsWith('"'))
+assert(http.header("Accept-Ranges") == "bytes")
+http.close()
+
+//  If-None-Match with the current tag
+http.reset()
+http.setHeader("If-None-Match", etag)
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 304)
+assert(http.response == "")
+http.close()
+
+//  If-None-Match with a different tag
+http.reset()
+http.setHeader("If-None-Match", '"other", W/"stale"')
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 200)
+assert(http.response.length == SIZE)
+http.close()
+
+//  Single range
+http.reset()
+http.setHeader("Range", "bytes=0-4")
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 206)
+assert(http.header("Content-Range") == "bytes 0-4/" + SIZE)
+assert(http.response == "01234")
+http.close()
+
+//  Suffix range
+http.reset()
+http.setHeader("Range", "bytes=-4")
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 206)
+assert(http.header("Content-Range") == "bytes 50-53/" + SIZE)
+assert(http.response == "END\n")
+http.close()
+
+//  Multiple ranges
+http.reset()
+http.setHeader("Range", "bytes=0-4,45-52")
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 206)
+assert(http.header("Content-Type").contains("multipart/byteranges; boundary="))
+assert(http.response.contains("Content-Range: bytes 0-4/" + SIZE))
+assert(http.response.contains("Content-Range: bytes 45-52/" + SIZE))
+assert(http.response.contains("01234"))
+assert(http.response.contains("56789END"))
+http.close()
+
+//  Range beyond the end of the document
+http.reset()
+http.setHeader("Range", "bytes=100-200")
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 416)
+assert(http.header("Content-Range") == "bytes */" + SIZE)
+http.close()
+
+//  If-Range with the current tag applies the range
+http.reset()
+http.setHeader("Range", "bytes=0-4")
+http.setHeader("If-Range", etag)
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 206)
+assert(http.response == "01234")
+http.close()
+
+//  If-Range with the current modification date applies the range
+http.reset()
+http.setHeader("Range", "bytes=0-4")
+http.setHeader("If-Range", lastModified)
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 206)
+http.close()
+
+//  If-Range with a stale tag returns the entire document
+http.reset()
+http.setHeader("Range", "bytes=0-4")
+http.setHeader("If-Range", '"stale"')
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 200)
+assert(http.response.length == SIZE)
+http.close()
+
+//  Weak tags never match If-Range
+http.reset()
+http.setHeader("Range", "bytes=0-4")
+http.setHeader("If-Range", "W/" + etag)
+http.get(HTTP + "/numbers.txt")
+assert(http.status == 200)
+http.close()
@@ -17,6 +17,11 @@ http.followRedirects = true
 http.get(HTTP + "/dir")
 assert(http.status == 200)
 
+//  A redirect route with an empty extension set must not match
+http.followRedirects = false
+http.get(HTTP + "/sub/a.html")
+assert(http.status == 200)
+
 /*
 http.followRedirects = true
 http.get(HTTP + "/dir/")
@@ -0,0 +1,258 @@
+/*
+    fcgitest.c - Test FastCGI program
+
+    Copyright (c) All Rights Reserved. See details at the end of the file.
+
+    The program is run by the fastcgi handler as a persistent worker. It accepts connections on the listening socket
+    passed as its stdin and serves one request at a time on each connection.
+
+    The request query selects the response:
+        echo                Output the request body
+        exit                Output the response and then exit the worker
+        default             Output the worker pid and query
+ */
+
+/********************************** Includes **********************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*********************************** Locals ***********************************/
+
+#define FCGI_VERSION            1
+#define FCGI_BEGIN_REQUEST      1
+#define FCGI_ABORT_REQUEST      2
+#define FCGI_END_REQUEST        3
+#define FCGI_PARAMS             4
+#define FCGI_STDIN              5
+#define FCGI_STDOUT             6
+#define FCGI_GET_VALUES         9
+#define FCGI_GET_VALUES_RESULT  10
+
+#define FCGI_HEADER_LEN         8
+#define FCGI_MAX_CONTENT        65535
+#define FCGI_MAX_WRITE          8192
+
+typedef struct Request {
+    int     id;                 /* FastCGI request ID */
+    char    query[256];         /* QUERY_STRING parameter */
+    char    *body;              /* Request body from FCGI_STDIN */
+    size_t  bodyLen;            /* Length of the request body */
+} Request;
+
+static int readBlock(int fd, void *buf, size_t len);
+static void resetRequest(Request *req);
+static void respond(int fd, Request *req);
+static void parseParams(Request *req, unsigned char *data, size_t len);
+static void writeOutput(int fd, int id, char *data, size_t len);
+static void writeRecord(int fd, int type, int id, char *data, size_t len);
+
+/************************************* Code ***********************************/
+
+int main(int argc, char **argv)
+{
+    Request         req;
+    unsigned char   header[FCGI_HEADER_LEN];
+    static unsigned char data[FCGI_MAX_CONTENT + 256];
+    char            values[32];
+    size_t          len, pad;
+    int             fd, type, id;
+
+    memset(&req, 0, sizeof(req));
+    for (;;) {
+        if ((fd = accept(0, 0, 0)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        while (readBlock(fd, header, FCGI_HEADER_LEN) == 0) {
+            type = header[1];
+            id = header[2] << 8 | header[3];
+            len = header[4] << 8 | header[5];
+            pad = header[6];
+            if (readBlock(fd, data, len + pad) < 0) {
+                break;
+            }
+            switch (type) {
+            case FCGI_GET_VALUES:
+                /*
+                    Requests are not multiplexed on a connection
+                 */
+                values[0] = 15;
+                values[1] = 1;
+                memcpy(&values[2], "FCGI_MPXS_CONNS", 15);
+                values[17] = '0';
+                writeRecord(fd, FCGI_GET_VALUES_RESULT, 0, values, 18);
+                break;
+
+            case FCGI_BEGIN_REQUEST:
+                resetRequest(&req);
+                req.id = id;
+                break;
+
+            case FCGI_PARAMS:
+                parseParams(&req, data, len);
+                break;
+
+            case FCGI_STDIN:
+                if (len == 0) {
+                    respond(fd, &req);
+                } else {
+                    if ((req.body = realloc(req.body, req.bodyLen + len)) == 0) {
+                        return 1;
+                    }
+                    memcpy(&req.body[req.bodyLen], data, len);
+                    req.bodyLen += len;
+                }
+                break;
+
+            case FCGI_ABORT_REQUEST:
+                memset(data, 0, 8);
+                writeRecord(fd, FCGI_END_REQUEST, id, (char*) data, 8);
+                resetRequest(&req);
+                break;
+            }
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+
+static void respond(int fd, Request *req)
+{
+    char    buf[512], end[8];
+    int     exitWorker;
+
+    exitWorker = 0;
+    if (strcmp(req->query, "echo") == 0) {
+        snprintf(buf, sizeof(buf), "Content-Type: application/octet-stream\r\nX-Length: %d\r\n\r\n",
+            (int) req->bodyLen);
+        writeOutput(fd, req->id, buf, strlen(buf));
+        writeOutput(fd, req->id, req->body, req->bodyLen);
+    } else {
+        exitWorker = strcmp(req->query, "exit") == 0;
+        snprintf(buf, sizeof(buf), "Status: 200\r\nContent-Type: text/plain\r\n\r\nfcgitest: Output\nPID=%d\nQUERY=%s\n",
+            (int) getpid(), req->query);
+        writeOutput(fd, req->id, buf, strlen(buf));
+    }
+    writeRecord(fd, FCGI_STDOUT, req->id, 0, 0);
+    memset(end, 0, sizeof(end));
+    writeRecord(fd, FCGI_END_REQUEST, req->id, end, sizeof(end));
+    resetRequest(req);
+    if (exitWorker) {
+        exit(0);
+    }
+}
+
+
+/*
+    Extract QUERY_STRING from name-value pairs
+ */
+static void parseParams(Request *req, unsigned char *data, size_t len)
+{
+    unsigned char   *cp, *end;
+    size_t          nameLen, valueLen, count;
+
+    for (cp = data, end = &data[len]; cp < end; cp += nameLen + valueLen) {
+        if (*cp & 0x80) {
+            nameLen = (cp[0] & 0x7F) << 24 | cp[1] << 16 | cp[2] << 8 | cp[3];
+            cp += 4;
+        } else {
+            nameLen = *cp++;
+        }
+        if (*cp & 0x80) {
+            valueLen = (cp[0] & 0x7F) << 24 | cp[1] << 16 | cp[2] << 8 | cp[3];
+            cp += 4;
+        } else {
+            valueLen = *cp++;
+        }
+        if (nameLen == 12 && memcmp(cp, "QUERY_STRING", 12) == 0) {
+            count = valueLen < sizeof(req->query) ? valueLen : sizeof(req->query) - 1;
+            memcpy(req->query, &cp[nameLen], count);
+            req->query[count] = '\0';
+        }
+    }
+}
+
+
+static void writeOutput(int fd, int id, char *data, size_t len)
+{
+    size_t  count;
+
+    while (len > 0) {
+        count = len > FCGI_MAX_WRITE ? FCGI_MAX_WRITE : len;
+        writeRecord(fd, FCGI_STDOUT, id, data, count);
+        data += count;
+        len -= count;
+    }
+}
+
+
+static void writeRecord(int fd, int type, int id, char *data, size_t len)
+{
+    unsigned char   header[FCGI_HEADER_LEN];
+    ssize_t         rc;
+
+    header[0] = FCGI_VERSION;
+    header[1] = type;
+    header[2] = (id >> 8) & 0xFF;
+    header[3] = id & 0xFF;
+    header[4] = (len >> 8) & 0xFF;
+    header[5] = len & 0xFF;
+    header[6] = 0;
+    header[7] = 0;
+    rc = write(fd, header, FCGI_HEADER_LEN);
+    if (len > 0) {
+        rc = write(fd, data, len);
+    }
+    (void) rc;
+}
+
+
+static int readBlock(int fd, void *buf, size_t len)
+{
+    ssize_t     nbytes;
+    size_t      count;
+
+    for (count = 0; count < len; count += nbytes) {
+        if ((nbytes = read(fd, (char*) buf + count, len - count)) <= 0) {
+            if (nbytes < 0 && errno == EINTR) {
+                nbytes = 0;
+                continue;
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static void resetRequest(Request *req)
+{
+    free(req->body);
+    memset(req, 0, sizeof(Request));
+}
+
+/*
+    @copy   default
+
+    Copyright (c) Embedthis Software LLC, 2003-2014. All Rights Reserved.
+
+    This software is distributed under commercial and open source licenses.
+    You may use the Embedthis Open Source license or you may acquire a
+    commercial license from Embedthis Software. You agree to be fully bound
+    by the terms of either license. Consult the LICENSE.md distributed with
+    this software for full details and other copyrights.
+
+    Local variables:
+    tab-width: 4
+    c-basic-offset: 4
+    End:
+    vim: sw=4 ts=4 expandtab
+*/
@@ -143,6 +143,9 @@ MAIN(goahead, int argc, char **argv, char **envp)
 
     websDefineHandler("test", testHandler, 0, 0, 0);
     websAddRoute("/test", "test", 0);
+#if WEBS_FASTCGI
+    websAddRoute("/fcgi-bin", "fastcgi", 0);
+#endif
 #if ME_GOAHEAD_LEGACY
     websUrlHandlerDefine("/legacy/", 0, 0, legacyTest, 0);
 #endif
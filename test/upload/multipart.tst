@@ -0,0 +1,113 @@
+/*
+    multipart.tst - Multipart upload parsing tests
+ */
+
+require ejs.unix
+
+const HTTP: Uri = App.config.uris.http || "127.0.0.1:4100"
+const TESTFILE = "multipart-" + hashcode(self) + ".tdat"
+const BOUNDARY = "GoAheadTestBoundary0123456789"
+
+let http: Http = new Http
+
+//  Send a raw request in pieces and return the response
+function send(pieces: Array, delay: Number): String {
+    let s = new Socket
+    let response = new ByteArray
+    s.connect(HTTP.address)
+    for each (piece in pieces) {
+        s.write(piece)
+        App.sleep(delay)
+    }
+    for (count = 0; (n = s.read(response, -1)) != null; count += n) { }
+    s.close()
+    return response.toString()
+}
+
+function multipart(body: String, uri: String): String {
+    return "POST " + uri + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n" +
+        "Content-Type: multipart/form-data; boundary=" + BOUNDARY + "\r\n" +
+        "Content-Length: " + body.length + "\r\n\r\n"
+}
+
+if (App.config.bit_upload) {
+
+    /*
+        Upload a file with content that resembles the delimiter. The uploaded file must match byte for byte.
+        The file is larger than the upload write buffer so it is written in several pieces.
+     */
+    let data = new ByteArray
+    for (i in 4096) {
+        data.write("Line " + i + "\r\n--" + BOUNDARY.slice(0, i % BOUNDARY.length) + "\r\n-\r\n")
+    }
+    let f = File(TESTFILE).open({mode: "w"})
+    for (i in 8) {
+        f.write(data)
+    }
+    f.close()
+    try {
+        let size = Path(TESTFILE).size
+        http.upload(HTTP + "/action/uploadTest", { myfile: TESTFILE }, { name: "John Smith" })
+        assert(http.status == 200)
+        assert(http.response.contains("SIZE=" + size))
+        assert(http.response.contains("name=John Smith"))
+        http.close()
+        let uploaded = Path("../web/tmp").join(TESTFILE)
+        assert(uploaded.size == size)
+        assert(uploaded.readString() == Path(TESTFILE).readString())
+        uploaded.remove()
+    }
+    finally {
+        Path(TESTFILE).remove()
+    }
+
+    /*
+        Boundary delimiters split across reads
+     */
+    let body = "--" + BOUNDARY + "\r\n" +
+        'Content-Disposition: form-data; name="name"\r\n\r\n' +
+        "John Smith\r\n" +
+        "--" + BOUNDARY + "\r\n" +
+        'Content-Disposition: form-data; name="file"; filename="split.tdat"\r\n' +
+        "Content-Type: text/plain\r\n\r\n" +
+        "0123456789012345678901234567890123456789\r\n" +
+        "--" + BOUNDARY + "--\r\n"
+    let pieces = [ multipart(body, "/action/uploadTest") ]
+    for (i = 0; i < body.length; i += 7) {
+        pieces.push(body.slice(i, i + 7))
+    }
+    let response = send(pieces, 10)
+    assert(response.contains("200 OK"))
+    assert(response.contains("SIZE=40"))
+    assert(response.contains("name=John Smith"))
+    Path("../web/tmp/split.tdat").remove()
+
+    //  The final delimiter arrives alone
+    let end = body.indexOf("\r\n--" + BOUNDARY + "--")
+    response = send([ multipart(body, "/action/uploadTest") + body.slice(0, end), body.slice(end) ], 200)
+    assert(response.contains("200 OK"))
+    assert(response.contains("SIZE=40"))
+    Path("../web/tmp/split.tdat").remove()
+
+    /*
+        Form fields are limited to the POST limit
+     */
+    let field = ""
+    for (i in 1024) {
+        field += "abcdefghijklmnopqrstuvwxyz0123456789"
+    }
+    body = "--" + BOUNDARY + "\r\n" +
+        'Content-Disposition: form-data; name="big"\r\n\r\n' + field + "\r\n" +
+        "--" + BOUNDARY + "--\r\n"
+    response = send([ multipart(body, "/action/uploadTest") + body ], 0)
+    assert(response.contains("413 Request too large"))
+
+    /*
+        Multipart bodies for CGI programs are buffered and so are limited to the POST limit
+     */
+    response = send([ multipart(body, "/cgi-bin/cgitest") + body ], 0)
+    assert(response.contains("413 Request too large"))
+
+} else {
+    test.skip("Upload support not enabled")
+}